@@ -0,0 +1,126 @@
+#ifndef COUNTLY_BENCH_HPP_
+#define COUNTLY_BENCH_HPP_
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bench {
+/**
+ * Count of allocations made through the global 'operator new' since the start, counted by the hooks in main.cpp.
+ */
+extern std::atomic<unsigned long long> allocation_count;
+
+struct Result {
+  std::string name;
+  unsigned long long iterations = 0;
+  double ns_per_op = 0;
+  double allocations_per_op = 0;
+};
+
+/**
+ * Timer of a benchmark run. A benchmark does its setup, then times 'iterations' operations between 'start' and 'stop', and may
+ * leave work out of the measurement with 'pause' and 'resume'.
+ */
+class State {
+private:
+  std::chrono::steady_clock::time_point _started;
+  std::chrono::nanoseconds _elapsed{0};
+  unsigned long long _allocations_at_start = 0;
+  unsigned long long _allocations = 0;
+
+public:
+  const unsigned long long iterations;
+
+  explicit State(unsigned long long iterations) : iterations(iterations) {}
+
+  void start() {
+    _allocations_at_start = allocation_count.load(std::memory_order_relaxed);
+    _started = std::chrono::steady_clock::now();
+  }
+
+  void stop() {
+    _elapsed += std::chrono::steady_clock::now() - _started;
+    _allocations += allocation_count.load(std::memory_order_relaxed) - _allocations_at_start;
+  }
+
+  void pause() { stop(); }
+
+  void resume() { start(); }
+
+  std::chrono::nanoseconds elapsed() const { return _elapsed; }
+
+  unsigned long long allocations() const { return _allocations; }
+};
+
+using Benchmark = std::function<void(State &)>;
+
+/**
+ * Runs the registered benchmarks, each with a growing number of iterations until a run takes at least the min time.
+ */
+class Runner {
+private:
+  struct Entry {
+    std::string name;
+    Benchmark benchmark;
+  };
+
+  std::vector<Entry> _benchmarks;
+  std::vector<Result> _results;
+
+public:
+  std::string filter;
+  std::chrono::milliseconds min_time{200};
+  // most iterations of a run, for operations whose setup grows with the iterations such as filling a database
+  unsigned long long max_iterations = 1000000000ULL;
+
+  void add(const std::string &name, Benchmark benchmark) { _benchmarks.push_back({name, benchmark}); }
+
+  /**
+   * Add a benchmark that times a single operation without setup.
+   */
+  template <typename Operation> void addSimple(const std::string &name, Operation operation) {
+    add(name, [operation](State &state) {
+      state.start();
+      for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+        operation();
+      }
+      state.stop();
+    });
+  }
+
+  /**
+   * Run the benchmarks whose names contain the filter and print a line for each.
+   */
+  void run();
+
+  /**
+   * @return the results as a JSON document, for comparing runs in CI
+   */
+  std::string toJSON() const;
+};
+
+/**
+ * Keep the compiler from dropping a computation whose result is not used.
+ */
+template <typename T> void doNotOptimize(const T &value) {
+#ifdef _MSC_VER
+  static const volatile void *sink;
+  sink = &value;
+  _ReadWriteBarrier();
+#else
+  asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+void registerEventBenchmarks(Runner &runner);
+void registerRequestBenchmarks(Runner &runner);
+void registerStorageBenchmarks(Runner &runner);
+void registerViewsBenchmarks(Runner &runner);
+} // namespace bench
+#endif
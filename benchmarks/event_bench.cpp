@@ -0,0 +1,67 @@
+#include "bench.hpp"
+#include "countly.hpp"
+#include "countly/event.hpp"
+
+#include <string>
+
+namespace bench {
+/**
+ * Adds events to an SDK that sends nothing, with logging off or with every message given to a logger that drops it, to show
+ * what logging costs on the hot path.
+ */
+static void addEvents(State &state, bool logging) {
+  cly::Countly countly;
+  countly.setHTTPClient([](bool use_post, const std::string &path, const std::string &data) {
+    cly::HTTPResponse response;
+    response.success = true;
+    return response;
+  });
+  if (logging) {
+    countly.setLogger([](cly::LogLevel level, const std::string &message) { doNotOptimize(message); });
+  }
+  countly.setDeviceID("countly-bench-device");
+#ifdef COUNTLY_USE_SQLITE
+  countly.SetPath("countly-bench.db");
+#endif
+  countly.start("countly-bench-app-key", "https://bench.count.ly", 443, false);
+
+  state.start();
+  for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+    cly::Event event("click", 1);
+    countly.addEvent(event);
+  }
+  state.stop();
+  countly.stop();
+}
+
+void registerEventBenchmarks(Runner &runner) {
+  runner.addSimple("event/construct", []() {
+    cly::Event event("click", 1, 2.5);
+    doNotOptimize(event);
+  });
+
+  runner.addSimple("event/construct_segmented", []() {
+    cly::Event event("purchase", 1, 9.99);
+    event.addSegmentation("product", "subscription");
+    event.addSegmentation("quantity", 3);
+    event.addSegmentation("trial", false);
+    doNotOptimize(event);
+  });
+
+  runner.add("event/serialize", [](State &state) {
+    cly::Event event("purchase", 1, 9.99);
+    event.addSegmentation("product", "subscription");
+    event.addSegmentation("quantity", 3);
+    state.start();
+    for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+      std::string serialized = event.serialize();
+      doNotOptimize(serialized);
+    }
+    state.stop();
+  });
+
+  runner.add("countly/addEvent_logging_off", [](State &state) { addEvents(state, false); });
+
+  runner.add("countly/addEvent_logging_on", [](State &state) { addEvents(state, true); });
+}
+} // namespace bench
@@ -0,0 +1,411 @@
+#include "countly.hpp"
+#include "nlohmann/json.hpp"
+
+#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
+#include "mock_server.hpp"
+#define COUNTLY_LOAD_MOCK_SERVER
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Load test of the public SDK calls from many producer threads, while the update thread sends the requests to a stub HTTP client.
+namespace load {
+using Clock = std::chrono::steady_clock;
+
+// Name of the segmentation key that carries the time an event was recorded, read back by the stub client.
+static const char SENT_KEY[] = "load_sent_ns";
+
+enum Operation { ADD_EVENT = 0, RECORD_EVENT = 1, OPEN_VIEW = 2, ADD_BREADCRUMB = 3, OPERATION_COUNT = 4 };
+static const char *const OPERATION_NAMES[OPERATION_COUNT] = {"addEvent", "RecordEvent", "openView", "addBreadcrumb"};
+
+/**
+ * Log-linear histogram of latencies in nanoseconds: 64 sub-buckets for every power of two, which keeps percentiles within
+ * about 1.6% without storing every sample.
+ */
+class LatencyHistogram {
+private:
+  static const int SUB_BUCKET_BITS = 6;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  std::vector<unsigned long long> _counts = std::vector<unsigned long long>(64 * SUB_BUCKETS, 0);
+  unsigned long long _total = 0;
+
+  static size_t bucketOf(unsigned long long value) {
+    if (value < SUB_BUCKETS) {
+      return static_cast<size_t>(value);
+    }
+
+    int exponent = 0;
+    while ((value >> exponent) >= 2 * SUB_BUCKETS) {
+      exponent++;
+    }
+    // values from 2^(exponent + bits) on share buckets 'exponent + 1' sub-buckets wide
+    return static_cast<size_t>((exponent + 1) * SUB_BUCKETS + ((value >> exponent) - SUB_BUCKETS));
+  }
+
+  static unsigned long long valueOf(size_t bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+      return bucket;
+    }
+
+    const int exponent = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+    return (static_cast<unsigned long long>(bucket % SUB_BUCKETS) + SUB_BUCKETS) << exponent;
+  }
+
+public:
+  void record(unsigned long long nanoseconds) {
+    _counts[std::min(bucketOf(nanoseconds), _counts.size() - 1)]++;
+    _total++;
+  }
+
+  void merge(const LatencyHistogram &other) {
+    for (size_t index = 0; index < _counts.size(); index++) {
+      _counts[index] += other._counts[index];
+    }
+    _total += other._total;
+  }
+
+  unsigned long long count() const { return _total; }
+
+  /**
+   * @return the smallest latency in nanoseconds that the given share of the samples does not exceed, 0 without samples
+   */
+  unsigned long long percentile(double share) const {
+    const unsigned long long wanted = static_cast<unsigned long long>(share * static_cast<double>(_total) + 0.5);
+    unsigned long long seen = 0;
+    for (size_t index = 0; index < _counts.size(); index++) {
+      seen += _counts[index];
+      if (seen >= wanted && seen > 0) {
+        return valueOf(index);
+      }
+    }
+    return 0;
+  }
+};
+
+struct Options {
+  std::vector<int> threads = {1, 2, 4, 8, 16, 32, 64};
+  std::chrono::milliseconds duration{5000};
+  // relative weights of the operations, in the order of 'Operation'
+  int mix[OPERATION_COUNT] = {60, 20, 10, 10};
+  std::chrono::microseconds sink_latency{0};
+  // send through the built-in HTTP transport to a local mock server instead of the stub HTTP client
+  bool mock_server = false;
+  size_t update_interval = 100;
+  std::string json_path;
+};
+
+/**
+ * Stub HTTP client: accepts every request after the configured delay and records how long ago the events in it were recorded.
+ * With the mock server it only records the events of the requests the server received.
+ */
+class Sink {
+private:
+  std::mutex _mutex;
+  LatencyHistogram _ack_latency;
+
+public:
+  std::chrono::microseconds latency{0};
+  std::atomic<unsigned long long> requests{0};
+
+  cly::HTTPResponse receive(const std::string &data) {
+    if (latency.count() > 0) {
+      std::this_thread::sleep_for(latency);
+    }
+
+    const unsigned long long now = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t position = data.find(SENT_KEY); position != std::string::npos; position = data.find(SENT_KEY, position + 1)) {
+      // the events are URL-encoded JSON, the digits follow the encoded closing quote, the colon and for string values an opening quote
+      size_t digits = position + sizeof(SENT_KEY) - 1;
+      while (data.compare(digits, 3, "%22") == 0 || data.compare(digits, 3, "%3A") == 0) {
+        digits += 3;
+      }
+
+      const unsigned long long sent = digits < data.size() ? std::strtoull(data.c_str() + digits, nullptr, 10) : 0;
+      if (sent > 0 && sent <= now) {
+        _ack_latency.record(now - sent);
+      }
+    }
+
+    requests++;
+    cly::HTTPResponse response{true, nlohmann::json::object()};
+    response.status_code = 200;
+    return response;
+  }
+
+  /**
+   * Record the events of a request received by the mock server, given as the decoded 'events' parameter.
+   */
+  void receiveEvents(const std::string &events) {
+    const nlohmann::json parsed = nlohmann::json::parse(events, nullptr, false);
+    const unsigned long long now = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (parsed.is_array()) {
+      for (const nlohmann::json &event : parsed) {
+        auto segmentation = event.find("segmentation");
+        if (segmentation == event.end() || !segmentation->is_object() || !segmentation->contains(SENT_KEY)) {
+          continue;
+        }
+
+        const nlohmann::json &value = (*segmentation)[SENT_KEY];
+        const unsigned long long sent = value.is_number() ? value.get<unsigned long long>() : value.is_string() ? std::strtoull(value.get<std::string>().c_str(), nullptr, 10) : 0;
+        if (sent > 0 && sent <= now) {
+          _ack_latency.record(now - sent);
+        }
+      }
+    }
+  }
+
+  LatencyHistogram takeAckLatency() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    LatencyHistogram result = _ack_latency;
+    _ack_latency = LatencyHistogram();
+    return result;
+  }
+};
+
+static Sink sink;
+
+static cly::HTTPResponse sinkHTTPClient(bool use_post, const std::string &path, const std::string &data) { return sink.receive(data); }
+
+static unsigned long long nowNanoseconds() { return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count()); }
+
+struct ProducerResult {
+  LatencyHistogram latency[OPERATION_COUNT];
+};
+
+static void produce(cly::Countly &countly, const Options &options, int index, const std::atomic<bool> &running, ProducerResult &result) {
+  std::vector<Operation> weighted;
+  for (int operation = 0; operation < OPERATION_COUNT; operation++) {
+    weighted.insert(weighted.end(), static_cast<size_t>(std::max(options.mix[operation], 0)), static_cast<Operation>(operation));
+  }
+  if (weighted.empty()) {
+    return;
+  }
+
+  std::minstd_rand random(static_cast<unsigned int>(index + 1));
+  std::uniform_int_distribution<size_t> pick(0, weighted.size() - 1);
+  const std::string view_name = "screen-" + std::to_string(index);
+  while (running.load(std::memory_order_relaxed)) {
+    const Operation operation = weighted[pick(random)];
+    const Clock::time_point start = Clock::now();
+    switch (operation) {
+    case ADD_EVENT: {
+      cly::Event event("load", 1, 1.5);
+      event.addSegmentation(SENT_KEY, static_cast<long long>(nowNanoseconds()));
+      countly.addEvent(event);
+      break;
+    }
+    case RECORD_EVENT:
+      countly.RecordEvent("load_record", {{SENT_KEY, std::to_string(nowNanoseconds())}}, 1);
+      break;
+    case OPEN_VIEW: {
+      const std::string view_id = countly.views().openView(view_name);
+      countly.views().closeViewWithID(view_id);
+      break;
+    }
+    case ADD_BREADCRUMB:
+      countly.crash().addBreadcrumb("load breadcrumb");
+      break;
+    default:
+      break;
+    }
+    result.latency[operation].record(static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+  }
+}
+
+static nlohmann::json describe(const std::string &name, const LatencyHistogram &latency, double seconds) {
+  return {{"name", name},
+          {"calls", latency.count()},
+          {"calls_per_second", static_cast<double>(latency.count()) / seconds},
+          {"p50_ns", latency.percentile(0.5)},
+          {"p99_ns", latency.percentile(0.99)},
+          {"p999_ns", latency.percentile(0.999)}};
+}
+
+static void printRow(const nlohmann::json &row) {
+  std::printf("  %-16s %12llu %14.0f/s %12.1f %12.1f %12.1f us\n", row["name"].get<std::string>().c_str(), row["calls"].get<unsigned long long>(), row["calls_per_second"].get<double>(), row["p50_ns"].get<unsigned long long>() / 1000.0,
+              row["p99_ns"].get<unsigned long long>() / 1000.0, row["p999_ns"].get<unsigned long long>() / 1000.0);
+}
+
+/**
+ * Wait until what the producers recorded has been sent, so the next run starts with empty queues.
+ */
+static void drain(cly::Countly &countly) {
+  const Clock::time_point deadline = Clock::now() + std::chrono::seconds(60);
+  while (Clock::now() < deadline && (countly.checkEQSize() > 0 || countly.checkRQSize() > 0)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+static nlohmann::json runLevel(cly::Countly &countly, const Options &options, int threads) {
+  sink.takeAckLatency();
+  std::vector<ProducerResult> results(static_cast<size_t>(threads));
+  std::atomic<bool> running{true};
+  std::vector<std::thread> producers;
+  const Clock::time_point start = Clock::now();
+  for (int index = 0; index < threads; index++) {
+    producers.emplace_back(produce, std::ref(countly), std::cref(options), index, std::cref(running), std::ref(results[static_cast<size_t>(index)]));
+  }
+
+  std::this_thread::sleep_for(options.duration);
+  running = false;
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  drain(countly);
+  const LatencyHistogram ack_latency = sink.takeAckLatency();
+
+  LatencyHistogram all;
+  nlohmann::json operations = nlohmann::json::array();
+  std::printf("threads: %d\n", threads);
+  std::printf("  %-16s %12s %16s %12s %12s %12s\n", "call", "count", "throughput", "p50", "p99", "p99.9");
+  for (int operation = 0; operation < OPERATION_COUNT; operation++) {
+    LatencyHistogram latency;
+    for (const ProducerResult &result : results) {
+      latency.merge(result.latency[operation]);
+    }
+    all.merge(latency);
+    if (latency.count() > 0) {
+      operations.push_back(describe(OPERATION_NAMES[operation], latency, seconds));
+      printRow(operations.back());
+    }
+  }
+  nlohmann::json total = describe("all", all, seconds);
+  printRow(total);
+  nlohmann::json ack = describe("event-to-ack", ack_latency, seconds);
+  printRow(ack);
+  std::fflush(stdout);
+
+  return {{"threads", threads}, {"seconds", seconds}, {"operations", operations}, {"all", total}, {"event_to_ack", ack}};
+}
+
+static std::vector<int> parseList(const std::string &value) {
+  std::vector<int> result;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    result.push_back(std::atoi(item.c_str()));
+  }
+  return result;
+}
+
+static void printUsage() {
+  std::cout << "Usage: countly-load [--threads 1,2,4] [--duration <ms>] [--mix <addEvent,RecordEvent,openView,addBreadcrumb>]" << std::endl;
+  std::cout << "                    [--sink-latency <us>] [--update-interval <ms>] [--mock-server] [--json <file>]" << std::endl;
+  std::cout << "  --threads          producer thread counts to run one after another, 1 to 64 by powers of two by default" << std::endl;
+  std::cout << "  --duration         time each thread count runs, 5000 ms by default" << std::endl;
+  std::cout << "  --mix              relative weights of the calls, 60,20,10,10 by default" << std::endl;
+  std::cout << "  --sink-latency     time the stub HTTP client takes to answer a request, 0 by default" << std::endl;
+  std::cout << "  --update-interval  interval of the SDK update thread, 100 ms by default" << std::endl;
+#ifdef COUNTLY_LOAD_MOCK_SERVER
+  std::cout << "  --mock-server      send with the built-in HTTP transport to a local mock server, which answers after the sink latency" << std::endl;
+#endif
+  std::cout << "  --json             also write the results to the file as JSON, '-' for the standard output" << std::endl;
+}
+} // namespace load
+
+int main(int argc, char **argv) {
+  load::Options options;
+  for (int index = 1; index < argc; index++) {
+    const std::string argument = argv[index];
+#ifdef COUNTLY_LOAD_MOCK_SERVER
+    if (argument == "--mock-server") {
+      options.mock_server = true;
+      continue;
+    }
+#endif
+    if (index + 1 >= argc) {
+      load::printUsage();
+      return argument == "--help" ? 0 : 1;
+    }
+
+    const std::string value = argv[++index];
+    if (argument == "--threads") {
+      options.threads = load::parseList(value);
+    } else if (argument == "--duration") {
+      options.duration = std::chrono::milliseconds(std::atol(value.c_str()));
+    } else if (argument == "--mix") {
+      const std::vector<int> mix = load::parseList(value);
+      for (size_t operation = 0; operation < load::OPERATION_COUNT; operation++) {
+        options.mix[operation] = operation < mix.size() ? mix[operation] : 0;
+      }
+    } else if (argument == "--sink-latency") {
+      options.sink_latency = std::chrono::microseconds(std::atol(value.c_str()));
+    } else if (argument == "--update-interval") {
+      options.update_interval = static_cast<size_t>(std::atol(value.c_str()));
+    } else if (argument == "--json") {
+      options.json_path = value;
+    } else {
+      load::printUsage();
+      return 1;
+    }
+  }
+
+  cly::Countly &countly = cly::Countly::getInstance();
+  countly.setDeviceID("countly-load-device");
+#ifdef COUNTLY_USE_SQLITE
+  countly.SetPath("countly-load.db");
+#endif
+  countly.setUpdateInterval(options.update_interval);
+
+#ifdef COUNTLY_LOAD_MOCK_SERVER
+  std::unique_ptr<test_utils::MockServer> server;
+  if (options.mock_server) {
+    test_utils::MockServerSettings settings;
+    settings.latency = options.sink_latency;
+    settings.keep_requests = false;
+    settings.on_request = [](const test_utils::MockRequest &request) {
+      load::sink.requests++;
+      auto events = request.params.find("events");
+      if (events != request.params.end()) {
+        load::sink.receiveEvents(events->second);
+      }
+    };
+    server.reset(new test_utils::MockServer(settings));
+    countly.start("countly-load-app-key", server->host(), server->port, true);
+  }
+#endif
+  if (!options.mock_server) {
+    load::sink.latency = options.sink_latency;
+    countly.setHTTPClient(load::sinkHTTPClient);
+    countly.start("countly-load-app-key", "https://load.count.ly", 443, true);
+  }
+
+  nlohmann::json levels = nlohmann::json::array();
+  for (int threads : options.threads) {
+    levels.push_back(load::runLevel(countly, options, std::max(threads, 1)));
+  }
+  countly.stop();
+
+  nlohmann::json document = {{"requests", load::sink.requests.load()}, {"levels", levels}};
+#ifdef COUNTLY_LOAD_MOCK_SERVER
+  if (server) {
+    const test_utils::MockServerStats stats = server->stats();
+    std::printf("mock server: %llu requests over %llu connections, %llu bytes received\n", stats.requests, stats.connections, stats.bytes_received);
+    document["mock_server"] = {{"requests", stats.requests}, {"connections", stats.connections}, {"bytes_received", stats.bytes_received}};
+  }
+#endif
+  if (options.json_path == "-") {
+    std::cout << document.dump(2) << std::endl;
+  } else if (!options.json_path.empty()) {
+    std::ofstream file(options.json_path);
+    file << document.dump(2) << std::endl;
+  }
+  return 0;
+}
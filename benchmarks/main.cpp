@@ -0,0 +1,112 @@
+#include "bench.hpp"
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+namespace bench {
+std::atomic<unsigned long long> allocation_count{0};
+
+void Runner::run() {
+  for (const Entry &entry : _benchmarks) {
+    if (!filter.empty() && entry.name.find(filter) == std::string::npos) {
+      continue;
+    }
+
+    unsigned long long iterations = 1;
+    while (true) {
+      State state(iterations);
+      entry.benchmark(state);
+      if (state.elapsed() >= min_time || iterations >= max_iterations) {
+        Result result;
+        result.name = entry.name;
+        result.iterations = iterations;
+        result.ns_per_op = static_cast<double>(state.elapsed().count()) / static_cast<double>(iterations);
+        result.allocations_per_op = static_cast<double>(state.allocations()) / static_cast<double>(iterations);
+        _results.push_back(result);
+        std::printf("%-48s %12llu %14.1f ns/op %10.2f allocs/op\n", result.name.c_str(), result.iterations, result.ns_per_op, result.allocations_per_op);
+        std::fflush(stdout);
+        break;
+      }
+
+      // aim a bit past the min time from the rate of this run, growing at least twofold and at most a hundredfold
+      const double elapsed = static_cast<double>(std::max(state.elapsed().count(), static_cast<std::chrono::nanoseconds::rep>(1)));
+      const double wanted = static_cast<double>(std::chrono::nanoseconds(min_time).count()) * 1.2 / elapsed * static_cast<double>(iterations);
+      iterations = std::min(max_iterations, static_cast<unsigned long long>(std::min(std::max(wanted, iterations * 2.0), iterations * 100.0)));
+    }
+  }
+}
+
+std::string Runner::toJSON() const {
+  nlohmann::json benchmarks = nlohmann::json::array();
+  for (const Result &result : _results) {
+    benchmarks.push_back({{"name", result.name}, {"iterations", result.iterations}, {"ns_per_op", result.ns_per_op}, {"allocations_per_op", result.allocations_per_op}});
+  }
+
+  nlohmann::json document = {{"benchmarks", benchmarks}};
+  return document.dump(2);
+}
+} // namespace bench
+
+// Every allocation of the process is counted, those made inside the SDK library included.
+void *operator new(std::size_t size) {
+  bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void *memory = std::malloc(size > 0 ? size : 1);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete[](void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t size) noexcept { std::free(memory); }
+
+void operator delete[](void *memory, std::size_t size) noexcept { std::free(memory); }
+
+static void printUsage() {
+  std::cout << "Usage: countly-bench [--filter <text>] [--min-time <milliseconds>] [--json <file>]" << std::endl;
+  std::cout << "  --filter    run only the benchmarks whose names contain the text" << std::endl;
+  std::cout << "  --min-time  least time a measured run takes, 200 ms by default" << std::endl;
+  std::cout << "  --json      also write the results to the file as JSON, '-' for the standard output" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  bench::Runner runner;
+  std::string json_path;
+  for (int index = 1; index < argc; index++) {
+    const std::string argument = argv[index];
+    if (argument == "--filter" && index + 1 < argc) {
+      runner.filter = argv[++index];
+    } else if (argument == "--min-time" && index + 1 < argc) {
+      runner.min_time = std::chrono::milliseconds(std::atol(argv[++index]));
+    } else if (argument == "--json" && index + 1 < argc) {
+      json_path = argv[++index];
+    } else {
+      printUsage();
+      return argument == "--help" ? 0 : 1;
+    }
+  }
+
+  bench::registerEventBenchmarks(runner);
+  bench::registerRequestBenchmarks(runner);
+  bench::registerStorageBenchmarks(runner);
+  bench::registerViewsBenchmarks(runner);
+  runner.run();
+
+  if (json_path == "-") {
+    std::cout << runner.toJSON() << std::endl;
+  } else if (!json_path.empty()) {
+    std::ofstream file(json_path);
+    file << runner.toJSON() << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "bench.hpp"
+#include "countly/request_builder.hpp"
+#include "countly/request_module.hpp"
+#include "countly/storage_module_memory.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace bench {
+// Events of a typical request, the bulk of what is encoded and hashed on the way to the server.
+static const std::string EVENTS = "[{\"key\":\"click\",\"count\":1,\"sum\":2.5,\"timestamp\":1700000000000,\"segmentation\":{\"button\":\"buy now\",\"screen\":\"checkout\"}},"
+                                  "{\"key\":\"view\",\"count\":1,\"timestamp\":1700000000100,\"segmentation\":{\"name\":\"home\",\"visit\":1}}]";
+
+void registerRequestBenchmarks(Runner &runner) {
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<cly::CountlyConfiguration>("a32cb06789a6e99958d628378ee66bf8583a454f", "https://bench.count.ly");
+  configuration->deviceId = "11732aa3-19a6-4272-9057-e3411f1938be";
+  std::shared_ptr<cly::RequestBuilder> requestBuilder = std::make_shared<cly::RequestBuilder>(configuration, logger);
+  const std::map<std::string, std::string> data = {{"app_key", configuration->appKey}, {"device_id", configuration->deviceId}, {"timestamp", "1700000000000"}, {"events", EVENTS}};
+
+  runner.addSimple("request_builder/encodeURL", []() {
+    std::string encoded = cly::RequestBuilder::encodeURL(EVENTS);
+    doNotOptimize(encoded);
+  });
+
+  runner.addSimple("request_builder/serializeData", [data]() {
+    std::string serialized = cly::RequestBuilder::serializeData(data);
+    doNotOptimize(serialized);
+  });
+
+  runner.addSimple("request_builder/buildRequest", [requestBuilder]() {
+    std::string request = requestBuilder->buildRequest({{"events", EVENTS}});
+    doNotOptimize(request);
+  });
+
+#ifdef COUNTLY_USE_CUSTOM_SHA256
+  // a stand-in that does as little as possible, the benchmark then shows the cost around the hash
+  configuration->sha256_function = [](const std::string &data) { return std::string(64, '0'); };
+#endif
+  std::shared_ptr<cly::StorageModuleMemory> storageModule = std::make_shared<cly::StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<cly::RequestModule> requestModule = std::make_shared<cly::RequestModule>(configuration, logger, requestBuilder, storageModule);
+  const std::string request = cly::RequestBuilder::serializeData(data);
+  runner.addSimple("request_module/calculateChecksum", [requestModule, request]() {
+    std::string checksum = requestModule->calculateChecksum("salt", cly::BufferView(request));
+    doNotOptimize(checksum);
+  });
+}
+} // namespace bench
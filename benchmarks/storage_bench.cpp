@@ -0,0 +1,155 @@
+#include "bench.hpp"
+#include "countly/request_builder.hpp"
+#include "countly/storage_module_memory.hpp"
+#ifdef COUNTLY_USE_SQLITE
+#include "countly/storage_module_db.hpp"
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace bench {
+// Requests a benchmark of a removing operation inserts at a time before it removes them again.
+const unsigned long long REFILL_CHUNK = 1000;
+// Requests in the queue while reading operations are measured.
+const int QUEUED_REQUESTS = 100;
+
+#ifdef COUNTLY_USE_SQLITE
+static const char BENCH_DATABASE_NAME[] = "countly-bench.db";
+#endif
+
+using StorageFactory = std::function<std::shared_ptr<cly::StorageModuleBase>()>;
+
+static void fill(cly::StorageModuleBase &storage, const std::string &request, unsigned long long count) {
+  for (unsigned long long index = 0; index < count; index++) {
+    storage.RQInsertAtEnd(request);
+  }
+}
+
+/**
+ * Add a benchmark of an operation that removes a request, the queue is refilled out of the measurement.
+ */
+template <typename Operation> static void addRemoving(Runner &runner, const std::string &name, StorageFactory create, const std::string &request, Operation operation) {
+  runner.add(name, [create, request, operation](State &state) {
+    std::shared_ptr<cly::StorageModuleBase> storage = create();
+    unsigned long long done = 0;
+    state.start();
+    while (done < state.iterations) {
+      const unsigned long long chunk = std::min(REFILL_CHUNK, state.iterations - done);
+      state.pause();
+      fill(*storage, request, chunk);
+      state.resume();
+      for (unsigned long long index = 0; index < chunk; index++) {
+        operation(*storage);
+      }
+      done += chunk;
+    }
+    state.stop();
+  });
+}
+
+/**
+ * Add a benchmark of an operation that leaves the queue of 'QUEUED_REQUESTS' requests as it is.
+ */
+template <typename Operation> static void addReading(Runner &runner, const std::string &name, StorageFactory create, const std::string &request, Operation operation) {
+  runner.add(name, [create, request, operation](State &state) {
+    std::shared_ptr<cly::StorageModuleBase> storage = create();
+    fill(*storage, request, QUEUED_REQUESTS);
+    state.start();
+    for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+      operation(*storage);
+    }
+    state.stop();
+  });
+}
+
+static void registerStorage(Runner &runner, const std::string &prefix, StorageFactory create, const std::string &request) {
+  runner.add(prefix + "/init", [create](State &state) {
+    state.start();
+    for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+      std::shared_ptr<cly::StorageModuleBase> storage = create();
+      doNotOptimize(storage);
+    }
+    state.stop();
+  });
+
+  runner.add(prefix + "/RQInsertAtEnd", [create, request](State &state) {
+    std::shared_ptr<cly::StorageModuleBase> storage = create();
+    unsigned long long done = 0;
+    state.start();
+    while (done < state.iterations) {
+      const unsigned long long chunk = std::min(REFILL_CHUNK, state.iterations - done);
+      fill(*storage, request, chunk);
+      state.pause();
+      storage->RQClearAll();
+      state.resume();
+      done += chunk;
+    }
+    state.stop();
+  });
+
+  addReading(runner, prefix + "/RQCount", create, request, [](cly::StorageModuleBase &storage) { doNotOptimize(storage.RQCount()); });
+  addReading(runner, prefix + "/RQCount(class)", create, request, [](cly::StorageModuleBase &storage) { doNotOptimize(storage.RQCount(cly::RequestClass::EVENTS)); });
+  addReading(runner, prefix + "/RQBytes", create, request, [](cly::StorageModuleBase &storage) { doNotOptimize(storage.RQBytes()); });
+  addReading(runner, prefix + "/RQPeekFront", create, request, [](cly::StorageModuleBase &storage) { doNotOptimize(storage.RQPeekFront()); });
+  addReading(runner, prefix + "/RQPeekFront(class)", create, request, [](cly::StorageModuleBase &storage) { doNotOptimize(storage.RQPeekFront(cly::RequestClass::EVENTS)); });
+  addReading(runner, prefix + "/RQForEach", create, request, [](cly::StorageModuleBase &storage) {
+    size_t bytes = 0;
+    storage.RQForEach([&bytes](long long id, const cly::BufferView &view) {
+      bytes += view.size();
+      return true;
+    });
+    doNotOptimize(bytes);
+  });
+  addReading(runner, prefix + "/RQPeekAll", create, request, [](cly::StorageModuleBase &storage) { doNotOptimize(storage.RQPeekAll()); });
+
+  addRemoving(runner, prefix + "/RQRemoveFront", create, request, [](cly::StorageModuleBase &storage) { storage.RQRemoveFront(); });
+  addRemoving(runner, prefix + "/RQRemoveFront(entry)", create, request, [](cly::StorageModuleBase &storage) { storage.RQRemoveFront(storage.RQPeekFront()); });
+  addRemoving(runner, prefix + "/RQRemoveFront(class)", create, request, [](cly::StorageModuleBase &storage) { storage.RQRemoveFront(cly::RequestClass::EVENTS); });
+
+  runner.add(prefix + "/RQClearAll", [create, request](State &state) {
+    std::shared_ptr<cly::StorageModuleBase> storage = create();
+    state.start();
+    for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+      state.pause();
+      fill(*storage, request, QUEUED_REQUESTS);
+      state.resume();
+      storage->RQClearAll();
+    }
+    state.stop();
+  });
+}
+
+void registerStorageBenchmarks(Runner &runner) {
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<cly::CountlyConfiguration>("a32cb06789a6e99958d628378ee66bf8583a454f", "https://bench.count.ly");
+  configuration->deviceId = "11732aa3-19a6-4272-9057-e3411f1938be";
+  configuration->requestQueueThreshold = static_cast<unsigned int>(REFILL_CHUNK) * 2;
+  const std::string request = cly::RequestBuilder(configuration, logger).buildRequest({{"events", "[{\"key\":\"click\",\"count\":1,\"timestamp\":1700000000000,\"segmentation\":{\"button\":\"buy now\"}}]"}});
+
+  registerStorage(
+      runner, "storage/memory",
+      [configuration, logger]() {
+        std::shared_ptr<cly::StorageModuleBase> storage = std::make_shared<cly::StorageModuleMemory>(configuration, logger);
+        storage->init();
+        return storage;
+      },
+      request);
+
+#ifdef COUNTLY_USE_SQLITE
+  configuration->databasePath = BENCH_DATABASE_NAME;
+  registerStorage(
+      runner, "storage/sqlite",
+      [configuration, logger]() {
+        std::shared_ptr<cly::StorageModuleBase> storage = std::make_shared<cly::StorageModuleDB>(configuration, logger);
+        storage->init();
+        storage->RQClearAll();
+        return storage;
+      },
+      request);
+#endif
+}
+} // namespace bench
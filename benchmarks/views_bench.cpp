@@ -0,0 +1,75 @@
+#include "bench.hpp"
+#include "countly/views_module.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bench {
+/**
+ * Takes the view events and drops them, the benchmarks then show the cost of the views module alone.
+ */
+class NullDelegates : public cly::CountlyDelegates {
+public:
+  void RecordEvent(const std::string &key, int count) override {}
+
+  void RecordEvent(const std::string &key, int count, double sum) override {}
+
+  void RecordEvent(const std::string &key, const std::map<std::string, std::string> &segmentation, int count) override {}
+
+  void RecordEvent(const std::string &key, const std::map<std::string, std::string> &segmentation, int count, double sum) override {}
+
+  void RecordEvent(const std::string &key, const std::map<std::string, std::string> &segmentation, int count, double sum, double duration) override { doNotOptimize(segmentation); }
+};
+
+void registerViewsBenchmarks(Runner &runner) {
+  std::shared_ptr<NullDelegates> delegates = std::make_shared<NullDelegates>();
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+
+  runner.add("views/open_close_id", [delegates, logger](State &state) {
+    cly::ViewsModule views(delegates.get(), logger);
+    state.start();
+    for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+      const std::string viewId = views.openView("checkout");
+      views.closeViewWithID(viewId);
+    }
+    state.stop();
+  });
+
+  runner.add("views/open_close_name", [delegates, logger](State &state) {
+    cly::ViewsModule views(delegates.get(), logger);
+    state.start();
+    for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+      views.openView("checkout");
+      views.closeViewWithName("checkout");
+    }
+    state.stop();
+  });
+
+  // closing by name with many other views open, which used to scan all of them
+  runner.add("views/open_close_name_1000_open", [delegates, logger](State &state) {
+    cly::ViewsModule views(delegates.get(), logger);
+    for (int view = 0; view < 1000; view++) {
+      views.openView("background " + std::to_string(view));
+    }
+    state.start();
+    for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+      views.openView("checkout");
+      views.closeViewWithName("checkout");
+    }
+    state.stop();
+  });
+
+  runner.add("views/open_close_segmented", [delegates, logger](State &state) {
+    cly::ViewsModule views(delegates.get(), logger);
+    const std::map<std::string, std::string> segmentation = {{"screen", "cart"}, {"items", "3"}};
+    state.start();
+    for (unsigned long long iteration = 0; iteration < state.iterations; iteration++) {
+      const std::string viewId = views.openView("checkout", segmentation);
+      views.closeViewWithID(viewId);
+    }
+    state.stop();
+  });
+}
+} // namespace bench
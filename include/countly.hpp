@@ -22,7 +22,10 @@
 #endif
 #include "countly/event.hpp"
 #include "countly/logger_module.hpp"
+#include "countly/persistent_writer.hpp"
+#include "countly/remote_config_cache.hpp"
 #include "countly/storage_module_base.hpp"
+#include "countly/task_executor.hpp"
 #include "countly/views_module.hpp"
 #include <countly/crash_module.hpp>
 #include <countly/request_builder.hpp>
@@ -48,18 +51,88 @@ public:
 
   void setMaxRequestQueueSize(unsigned int requestQueueSize);
 
+  /**
+   * Set limit for the size in bytes of the requests that can be stored locally.
+   * The oldest requests are dropped to make room for a new one.
+   * @param requestQueueBytes: max size of request queue in bytes, 0 for no limit
+   */
+  void setMaxRequestQueueBytes(size_t requestQueueBytes);
+
+  /**
+   * Set the memory kept for breadcrumbs. It is allocated in 'start' and shared equally by the breadcrumbs, 256 bytes each by
+   * default; longer breadcrumbs are cut. Should be called before 'start'.
+   * @param breadcrumbBytes: max size of all breadcrumbs in bytes
+   */
+  void setMaxBreadcrumbBytes(size_t breadcrumbBytes);
+
   void setMaxRQProcessingBatchSize(unsigned int requestQueueProcessingSize);
 
+  /**
+   * Size every cycle of processing the request queue to a time budget instead of a fixed count. The average latency of the recent
+   * requests decides how many requests fit in the budget, so more are sent on a fast connection and a slow one does not hold the
+   * sender for long.
+   * @param timeBudget: time in milliseconds a cycle should take, 0 to go back to the fixed batch size
+   * @param minBatchSize: fewest requests sent in a cycle
+   * @param maxBatchSize: most requests sent in a cycle
+   */
+  void setAdaptiveRQProcessing(unsigned int timeBudget, unsigned int minBatchSize, unsigned int maxBatchSize);
+
+  /**
+   * Set how the request queue backs off after failed requests. Every failure waits a random delay between the base delay and three
+   * times the previous delay, up to the max delay. After the given number of failures in a row the server is considered down and
+   * is only probed with a single request once per delay.
+   * @param baseDelay: shortest delay in milliseconds
+   * @param maxDelay: longest delay in milliseconds
+   * @param circuitBreakerThreshold: failures in a row that open the circuit, 0 to keep it closed
+   */
+  void setRetryPolicy(unsigned int baseDelay, unsigned int maxDelay, unsigned int circuitBreakerThreshold);
+
+  /**
+   * Cap the rate the request queue is uploaded at, so draining a backlog does not take up the whole uplink. Applies to the built-in
+   * HTTP client and to a custom HTTP client function alike.
+   * @param bytesPerSecond: most bytes of requests uploaded a second on average, 0 for no limit
+   * @param burstBytes: most bytes uploaded at once after being idle, 0 for a second's worth of bytes
+   */
+  void setUploadBandwidthLimit(size_t bytesPerSecond, size_t burstBytes = 0);
+
+  /**
+   * Hold back uploads of the request queue until 'resumeUploads' is called. Requests are still queued meanwhile.
+   */
+  void pauseUploads();
+
+  void resumeUploads();
+
   void setSalt(const std::string &value);
 
   void setLogger(void (*fun)(LogLevel level, const std::string &message));
 
+  /**
+   * Skip log messages below the given level. Skipped messages are not built at all, which keeps logging cheap on hot paths.
+   * @param level: least important level that is passed to the logger, DEBUG by default
+   */
+  void setMinLogLevel(LogLevel level);
+
+  /**
+   * Pass log messages to the logger from a background thread, so a slow logger does not hold up the SDK. Messages wait in a
+   * bounded ring, those that do not fit are dropped. When the SDK stops, the waiting messages are printed, the background thread
+   * ends and later messages are printed synchronously. Set the logger first, it can not be changed afterwards.
+   * @param capacity: most messages waiting to be printed
+   */
+  void enableAsyncLogging(size_t capacity);
+
   void setSha256(cly::SHA256Function fun);
 
   void enableManualSessionControl();
 
   void setHTTPClient(HTTPClientFunction fun);
 
+  /**
+   * Send requests with a transport of your own, e.g. an asynchronous HTTP stack. It takes the place of the HTTP client function and
+   * of the built-in HTTP client. Only allowed before the SDK is started.
+   * @param transport: transport to hand the requests to
+   */
+  void setTransport(std::shared_ptr<Transport> transport);
+
   void setMetrics(const std::string &os, const std::string &os_version, const std::string &device, const std::string &resolution, const std::string &carrier, const std::string &app_version);
 
   void setUserDetails(const std::map<std::string, std::string> &value);
@@ -112,6 +185,38 @@ public:
    */
   int checkRQSize();
 
+  /*
+   * Returns the size in bytes of the serialized events in the event queue.
+   */
+  size_t checkEQBytes();
+
+  /*
+   * Returns the size in bytes of the requests in the request queue.
+   */
+  long long checkRQBytes();
+
+  /*
+   * Returns the state of the circuit breaker in front of the server, 'CircuitState::OPEN' while it is considered down.
+   */
+  CircuitState getCircuitState();
+
+  /*
+   * Returns the count of log messages dropped because the ring of the asynchronous logger was full.
+   */
+  unsigned long long checkDroppedLogCount();
+
+  /*
+   * Returns the counters and latency histograms of the SDK together with the sizes of the queues. Does not query the database.
+   */
+  MetricsSnapshot getMetricsSnapshot();
+
+  /**
+   * Export the SDK metrics to your own monitoring. The callback is called from the update loop, no more often than the interval.
+   * @param callback: called with a snapshot of the metrics
+   * @param intervalMilliseconds: least time between two calls
+   */
+  void setMetricsCallback(MetricsCallback callback, unsigned int intervalMilliseconds);
+
   /**
    * Checks and returns the size of the event queue in persistent storage.
    */
@@ -171,6 +276,12 @@ public:
    */
   void setEventsToRQThreshold(int value);
 
+  /*
+   * Sets the size in bytes of the stored events after which all events will be sent to the RQ.
+   * It applies together with the event count threshold, 0 disables it.
+   */
+  void setEventsToRQByteThreshold(size_t value);
+
   void flushEvents(std::chrono::seconds timeout = std::chrono::seconds(30));
 
   bool beginSession();
@@ -181,13 +292,52 @@ public:
 
   void enableRemoteConfig();
 
-  void updateRemoteConfig();
+  /**
+   * Keep the last fetched remote config in the given file. It is read in 'start', so the remote config can be read before the
+   * first fetch completes, and later fetches of the whole remote config only download it if it changed.
+   * Should be called before 'start'.
+   * @param path: path of the cache file
+   */
+  void setRemoteConfigCachePath(const std::string &path);
+
+  /**
+   * Fetch the whole remote config in the background. Fetches are run one at a time on a thread of the SDK, a fetch requested
+   * while the same one is queued or running is not sent again. Pending fetches are dropped in 'stop'.
+   * @return future of whether the fetch succeeded, an unchanged remote config included; false if it failed or was dropped
+   */
+  std::shared_future<bool> updateRemoteConfig();
 
+  /**
+   * @return a copy of the value, null if the key is not in the remote config
+   */
   nlohmann::json getRemoteConfigValue(const std::string &key);
 
-  void updateRemoteConfigFor(std::string *keys, size_t key_count);
+  /**
+   * Typed reads of the remote config, for reading feature flags often, e.g. every frame. Every thread keeps the snapshot it
+   * read last and loads the new one only after a fetch published it, so reads take no lock and allocate nothing in between,
+   * but for strings too long to be stored inline.
+   * @return the value of the key, or the default value if the key is missing or its value has another type
+   */
+  bool getRemoteConfigBool(const std::string &key, bool default_value) const;
+
+  long long getRemoteConfigInt(const std::string &key, long long default_value) const;
+
+  double getRemoteConfigDouble(const std::string &key, double default_value) const;
 
-  void updateRemoteConfigExcept(std::string *keys, size_t key_count);
+  std::string getRemoteConfigString(const std::string &key, const std::string &default_value) const;
+
+  /**
+   * @return the remote config as it is now, an object that is never changed; later fetches publish new snapshots
+   */
+  std::shared_ptr<const nlohmann::json> getRemoteConfigSnapshot() const;
+
+  /**
+   * Fetch the given keys of the remote config, or all but them, and merge them into it. Run like 'updateRemoteConfig'.
+   * @return future of whether the fetch succeeded
+   */
+  std::shared_future<bool> updateRemoteConfigFor(std::string *keys, size_t key_count);
+
+  std::shared_future<bool> updateRemoteConfigExcept(std::string *keys, size_t key_count);
 
   static std::chrono::system_clock::time_point getTimestamp();
 
@@ -195,6 +345,46 @@ public:
 
 #ifdef COUNTLY_USE_SQLITE
   void setDatabasePath(const std::string &path);
+
+  /**
+   * Keep new requests in memory and write them to the database only when they exceed the given amount of bytes or when the SDK stops.
+   * Should be called before 'start'.
+   * @param watermarkBytes: amount of request bytes to keep in memory, zero writes every request to the database
+   */
+  void enableRequestQueueMemoryTier(size_t watermarkBytes);
+
+  /**
+   * Write requests and events to the database from a background thread, committing up to 'maxBatchSize' records in one transaction.
+   * A record waits at most 'maxLatencyMilliseconds' before it is committed. Should be called before 'start'.
+   * @param maxBatchSize: maximum number of records in one transaction, zero writes every record on the caller's thread
+   * @param maxLatencyMilliseconds: maximum time a record waits before it is committed
+   */
+  void enablePersistentWriteBatching(unsigned int maxBatchSize, unsigned int maxLatencyMilliseconds = 5);
+
+  /**
+   * Block until every request and event given to the background writer so far has been committed to the database.
+   */
+  void flushPersistentWrites();
+
+  /**
+   * Set how the database file gives back the space of sent requests and events. Should be called before 'start'.
+   * @param pagesPerStep: free pages reclaimed each time the request queue is drained, zero keeps the free pages for later inserts
+   * @param startupThresholdBytes: free space that makes 'start' reclaim every free page, zero disables compaction at start
+   */
+  void setDatabaseVacuum(unsigned int pagesPerStep, size_t startupThresholdBytes = 0);
+#else
+  /**
+   * Save the event and request queues to the given file when the SDK stops and restore them in 'start'.
+   * Should be called before 'start'.
+   * @param path: path of the snapshot file
+   */
+  void setQueueSnapshotPath(const std::string &path);
+
+  /**
+   * Save the event and request queues to the snapshot file now, replacing the previous snapshot.
+   * @return true if the snapshot was written
+   */
+  bool saveQueueSnapshot();
 #endif
 
   void SetPath(const std::string &path) {
@@ -305,16 +495,22 @@ private:
   void _deleteThread();
   void _sendIndependantLocationRequest();
   void log(LogLevel level, const std::string &message);
+  void log(LogLevel level, const char *message);
 #ifdef COUNTLY_USE_SQLITE
   bool createEventTableSchema();
+#else
+  void restoreQueueSnapshot();
 #endif
 
   /**
    * Helper methods to fetch remote config from the server.
    */
 #pragma region Remote_Config_Helper_Methods
-  void _fetchRemoteConfig(const std::map<std::string, std::string> &data);
-  void _updateRemoteConfigWithSpecificValues(const std::map<std::string, std::string> &data);
+  bool _fetchRemoteConfig(const std::map<std::string, std::string> &data);
+  bool _updateRemoteConfigWithSpecificValues(const std::map<std::string, std::string> &data);
+  std::shared_future<bool> _submitRemoteConfigFetch(const std::map<std::string, std::string> &data, bool merge);
+  void _publishRemoteConfig(std::shared_ptr<const nlohmann::json> snapshot);
+  const std::shared_ptr<const nlohmann::json> &_cachedRemoteConfig() const;
 #pragma endregion Remote_Config_Helper_Methods
 
   void _changeDeviceIdWithMerge(const std::string &value);
@@ -352,14 +548,24 @@ private:
   size_t wait_milliseconds = COUNTLY_KEEPALIVE_INTERVAL;
 
   size_t max_events = COUNTLY_MAX_EVENTS_DEFAULT;
+  // size of the serialized events in the event queue, kept up to date on every change
+  size_t event_queue_bytes = 0;
 #ifndef COUNTLY_USE_SQLITE
   std::deque<std::string> event_queue;
 #else
   std::string database_path;
+  std::shared_ptr<cly::PersistentWriter> persistentWriter;
 #endif
 
   bool remote_config_enabled = false;
-  nlohmann::json remote_config;
+  // replaced whole on every fetch through '_publishRemoteConfig' and read with 'std::atomic_load', which may take a lock from a
+  // global pool; typed reads reuse the snapshot their thread loaded last until a new one is published
+  std::shared_ptr<const nlohmann::json> remote_config = std::make_shared<const nlohmann::json>(nlohmann::json::object());
+  // entity tag of the last whole remote config, sent with the next fetch so that an unchanged remote config is not downloaded
+  std::string remote_config_etag;
+  std::unique_ptr<cly::RemoteConfigCache> remote_config_cache;
+  // runs the remote config fetches, so that they do not outlive the SDK
+  std::unique_ptr<cly::TaskExecutor> remote_config_executor;
 };
 } // namespace cly
 #endif
@@ -0,0 +1,60 @@
+#ifndef BANDWIDTH_LIMITER_HPP_
+#define BANDWIDTH_LIMITER_HPP_
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace cly {
+/**
+ * Token bucket that caps the rate requests are uploaded at.
+ * The bucket fills with 'bytesPerSecond' tokens a second up to 'burstBytes', and a request takes as many tokens as it has bytes.
+ * A request bigger than the bucket waits for a full bucket and leaves it in debt, so the average rate still holds.
+ * Safe to use from several threads.
+ */
+class BandwidthLimiter {
+public:
+  using Clock = std::chrono::steady_clock;
+
+private:
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  size_t _bytes_per_second = 0;
+  size_t _burst_bytes = 0;
+  double _tokens = 0;
+  Clock::time_point _last_refill;
+  bool _paused = false;
+  bool _closed = false;
+
+  void refill(Clock::time_point now);
+
+public:
+  /**
+   * Set the upload rate. Waiting uploads are woken up to follow the new rate.
+   * @param bytesPerSecond: most bytes uploaded a second on average, 0 for no limit
+   * @param burstBytes: most bytes uploaded at once after being idle, 0 for a second's worth of bytes
+   */
+  void setRate(size_t bytesPerSecond, size_t burstBytes);
+
+  /**
+   * Take the tokens for an upload of the given size, waiting until there are enough.
+   * @return false if uploads are paused or the limiter was closed, in which case the upload should not happen
+   */
+  bool acquire(size_t bytes);
+
+  /**
+   * Stop uploads until 'resume' is called. Uploads that are waiting for tokens give up.
+   */
+  void pause();
+
+  void resume();
+
+  bool isPaused();
+
+  /**
+   * Make every waiting and later upload give up, used when the sender shuts down.
+   */
+  void close();
+};
+} // namespace cly
+#endif
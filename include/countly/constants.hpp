@@ -11,17 +11,71 @@
 #include <random>
 #include <sstream>
 #include <string>
+#include <utility>
 
 #define COUNTLY_SDK_NAME "cpp-native-unknown"
 #define COUNTLY_SDK_VERSION "23.2.2"
 #define COUNTLY_POST_THRESHOLD 2000
 #define COUNTLY_KEEPALIVE_INTERVAL 3000
 #define COUNTLY_MAX_EVENTS_DEFAULT 200
+// status of the answer to a conditional request whose cached response is still current
+#define COUNTLY_HTTP_NOT_MODIFIED 304
 
 namespace cly {
+/**
+ * Non-owning view over a contiguous block of characters.
+ * The memory it points to must stay alive for as long as the view is used.
+ */
+class BufferView {
+private:
+  const char *_data = nullptr;
+  size_t _size = 0;
+
+public:
+  BufferView() {}
+  BufferView(const char *data, size_t size) : _data(data), _size(size) {}
+  BufferView(const std::string &data) : _data(data.data()), _size(data.size()) {}
+
+  const char *data() const { return _data; }
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  /**
+   * @return an owning copy of the viewed characters
+   */
+  std::string toString() const { return _size == 0 ? std::string() : std::string(_data, _size); }
+};
+
 struct HTTPResponse {
   bool success;
+  // parsed response; HTTP client functions may set it, the built-in HTTP client keeps the raw 'body' instead
   nlohmann::json data;
+  // HTTP status code, 0 if the server could not be reached
+  int status_code = 0;
+  // seconds from the 'Retry-After' header of the response, 0 if it had none
+  unsigned int retry_after = 0;
+  // raw body of the response, only parsed by 'parseBody' so that requests which need just the status do not pay for it
+  std::string body;
+  // 'ETag' header of the response, empty if it had none
+  std::string etag;
+
+  /**
+   * Parse the raw body into 'data', unless 'data' is set already or there is no body.
+   * @return false if the body is not valid JSON
+   */
+  bool parseBody() {
+    if (!data.is_null() || body.empty()) {
+      return true;
+    }
+
+    nlohmann::json parseResult = nlohmann::json::parse(body, nullptr, false);
+    if (parseResult.is_discarded()) {
+      return false;
+    }
+
+    data = std::move(parseResult);
+    return true;
+  }
 };
 
 using HTTPClientFunction = std::function<HTTPResponse(bool, const std::string &, const std::string &)>;
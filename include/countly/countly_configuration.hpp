@@ -1,6 +1,9 @@
 #ifndef COUNTLY_CONFIGURATION_HPP_
 #define COUNTLY_CONFIGURATION_HPP_
 #include "countly/constants.hpp"
+#include "countly/metrics_registry.hpp"
+#include "countly/transport.hpp"
+#include <memory>
 #include <string>
 
 namespace cly {
@@ -32,8 +35,20 @@ struct CountlyConfiguration {
    */
 #ifdef COUNTLY_USE_SQLITE
   std::string databasePath;
+#else
+  /**
+   * Path of the file the queues are saved to on stop and restored from on start.
+   * Empty keeps the queues only in memory.
+   */
+  std::string queueSnapshotPath;
 #endif
 
+  /**
+   * Path of the file the last fetched remote config is kept in, read on start so that the remote config is available at once.
+   * Empty keeps the remote config only in memory.
+   */
+  std::string remoteConfigCachePath;
+
   /**
    * Sets the interval for the automatic update calls
    */
@@ -44,21 +59,112 @@ struct CountlyConfiguration {
    */
   int eventQueueThreshold = 100;
 
+  /**
+   * Set the size in bytes the stored events may reach before they are packed into a request.
+   * Zero leaves only the event count threshold in effect.
+   */
+  size_t eventQueueMaxBytes = 0;
+
   /**
    * Set limit for the number of requests that can be stored locally.
    */
   unsigned int requestQueueThreshold = 1000;
 
+  /**
+   * Set limit for the size in bytes of the requests that can be stored locally.
+   * The oldest requests are dropped to make room for a new one. Zero leaves only the request count limit in effect.
+   */
+  size_t requestQueueMaxBytes = 0;
+
+  /**
+   * Set the amount of request bytes that are kept in memory before requests are written to the database.
+   * Zero keeps every request in the database.
+   */
+  size_t requestQueueMemoryWatermark = 0;
+
+  /**
+   * Set the maximum number of records the background writer commits to the database in one transaction.
+   * Zero writes every request and event to the database on the caller's thread.
+   */
+  unsigned int persistentWriteBatchSize = 0;
+
+  /**
+   * Set the maximum time in milliseconds a record waits in the background writer before it is committed.
+   */
+  unsigned int persistentWriteMaxLatency = 5;
+
+  /**
+   * Set the number of free database pages reclaimed each time the request queue is drained.
+   * Zero leaves the free pages in the database file for later inserts.
+   */
+  unsigned int incrementalVacuumPages = 128;
+
+  /**
+   * Set the amount of free space in bytes the database file needs to have to be compacted when the SDK starts.
+   * Zero disables compaction at start.
+   */
+  size_t startupVacuumThreshold = 0;
+
   /**
    * Set limit for the number of requests that can be processed at a time.
    */
   unsigned int maxProcessingBatchSize = 100;
 
+  /**
+   * Set the time in milliseconds a cycle of processing the request queue should take. Each cycle then sends as many requests as fit
+   * in it at the average latency of the recent requests, between 'minProcessingBatchSize' and 'maxProcessingBatchSize'.
+   * Zero always sends up to 'maxProcessingBatchSize' requests.
+   */
+  unsigned int processingTimeBudget = 0;
+
+  /**
+   * Set the fewest requests a cycle sends when the batch size follows 'processingTimeBudget'.
+   */
+  unsigned int minProcessingBatchSize = 1;
+
+  /**
+   * Set the shortest time in milliseconds the request queue waits before it is sent again after a failed request.
+   * Failures in a row wait longer, with random jitter, up to 'retryMaxDelay'.
+   */
+  unsigned int retryBaseDelay = 3000;
+
+  /**
+   * Set the longest time in milliseconds the request queue waits before it is sent again after a failed request.
+   */
+  unsigned int retryMaxDelay = 5 * 60 * 1000;
+
+  /**
+   * Set the number of failed requests in a row after which the server is considered down and only probed once per delay.
+   * Zero keeps the circuit closed.
+   */
+  unsigned int circuitBreakerThreshold = 5;
+
+  /**
+   * Set the most bytes of requests uploaded a second on average when processing the request queue. Zero does not limit the rate.
+   */
+  size_t uploadBandwidthLimit = 0;
+
+  /**
+   * Set the most bytes of requests uploaded at once after the sender was idle. Zero allows a second's worth of bytes.
+   */
+  size_t uploadBurstSize = 0;
+
+  /**
+   * Set to hold back uploads of the request queue until they are resumed.
+   */
+  bool uploadsPaused = false;
+
   /**
    * Set the maximum amount of breadcrumbs.
    */
   unsigned int breadcrumbsThreshold = 100;
 
+  /**
+   * Set the most bytes the breadcrumbs take. Every one of the 'breadcrumbsThreshold' breadcrumbs gets an equal share, longer
+   * breadcrumbs are cut to it.
+   */
+  size_t breadcrumbsMaxBytes = 25600;
+
   /**
    * Set to send all requests made to the Countly server using HTTP POST.
    */
@@ -72,8 +178,25 @@ struct CountlyConfiguration {
 
   HTTPClientFunction http_client_function = nullptr;
 
+  /**
+   * Transport requests are sent with, in place of the 'http_client_function' and the built-in HTTP client.
+   */
+  std::shared_ptr<Transport> transport;
+
   nlohmann::json metrics;
 
+  /**
+   * Counters and histograms of what the SDK does, read with 'getMetricsSnapshot'.
+   */
+  std::shared_ptr<MetricsRegistry> metricsRegistry = std::make_shared<MetricsRegistry>();
+
+  /**
+   * Called from the update loop with a snapshot of the SDK metrics every 'metricsCallbackInterval' milliseconds.
+   */
+  MetricsCallback metricsCallback = nullptr;
+
+  unsigned int metricsCallbackInterval = 0;
+
   CountlyConfiguration(const std::string appKey, std::string serverUrl) {
     this->appKey = appKey;
     this->serverUrl = serverUrl;
@@ -17,6 +17,8 @@ public:
   CrashModule(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<RequestModule> requestModule, std::shared_ptr<std::mutex> mutex);
   /**
    * Adds string value to a list which is later sent over as logs whenever a cash is reported by system.
+   * Every breadcrumb keeps an equal share of the memory set with 'Countly::setMaxBreadcrumbBytes', 256 bytes by default;
+   * longer ones are cut to it, with a warning logged the first time.
    *
    * @param value: a bread crumb for the crash report
    */
@@ -0,0 +1,61 @@
+#ifndef HTTP_TRANSPORT_HPP_
+#define HTTP_TRANSPORT_HPP_
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#include "countly/transport.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace cly {
+/**
+ * Transport over an 'HTTPClientFunction'. The function is called on the thread that submits the request, with copies of the
+ * path and the data, so 'submit' returns after the completion was called. Requests can not be cancelled.
+ */
+class FunctionTransport : public Transport {
+private:
+  HTTPClientFunction _function;
+
+public:
+  FunctionTransport(HTTPClientFunction function);
+
+  TransportCapabilities getCapabilities() const override;
+  TransportHandle submit(const TransportRequest &request, TransportCompletion completion) override;
+  void cancel(TransportHandle handle) override;
+  void cancelAll() override;
+};
+
+#ifndef COUNTLY_USE_CUSTOM_HTTP
+/**
+ * Transport over the built-in HTTP client, curl or WinHTTP on Windows. A request is sent on the thread that submits it, so
+ * 'submit' returns after the completion was called. Cancelling a request from another thread aborts its transfer with curl;
+ * with WinHTTP it only keeps a request that has not been sent yet from being sent. After 'cancelAll' every request submitted
+ * later fails without being sent, the SDK creates a new transport when it is started again.
+ */
+class HTTPTransport : public Transport {
+private:
+  std::shared_ptr<CountlyConfiguration> _configuration;
+  std::shared_ptr<LoggerModule> _logger;
+  bool _use_https = true;
+
+  std::mutex _mutex;
+  TransportHandle _next_handle = 1;
+  // cancel flags of the requests in flight
+  std::map<TransportHandle, std::shared_ptr<std::atomic<bool>>> _in_flight;
+  bool _cancelled_all = false;
+
+  HTTPResponse send(const TransportRequest &request, std::atomic<bool> &cancelled);
+
+public:
+  HTTPTransport(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger);
+  ~HTTPTransport();
+
+  TransportCapabilities getCapabilities() const override;
+  TransportHandle submit(const TransportRequest &request, TransportCompletion completion) override;
+  void cancel(TransportHandle handle) override;
+  void cancelAll() override;
+};
+#endif
+} // namespace cly
+#endif
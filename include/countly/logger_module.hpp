@@ -1,5 +1,6 @@
 #ifndef LOGGER_MODULE_HPP_
 #define LOGGER_MODULE_HPP_
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <string>
@@ -14,7 +15,7 @@ public:
   ~LoggerModule();
 
   /**
-   * Set custom logger function.
+   * Set custom logger function. It can not be changed while messages are printed from a background thread.
    *
    * @param logger pointer to function.
    */
@@ -34,6 +35,64 @@ public:
    */
   void log(LogLevel level, const std::string &message);
 
+  /**
+   * Print important information. A literal message is only turned into a string if it is printed.
+   *
+   * @param level importance and urgency of the message.
+   * @param message description of log.
+   */
+  void log(LogLevel level, const char *message);
+
+  /**
+   * Print important information built only if it is printed, e.g. a message with a request in it on a hot path.
+   *
+   * @param level importance and urgency of the message.
+   * @param buildMessage callable returning the description of log.
+   */
+  template <typename MessageBuilder> void logLazy(LogLevel level, MessageBuilder buildMessage) {
+    if (isEnabled(level)) {
+      log(level, buildMessage());
+    }
+  }
+
+  /**
+   * Set the least important level that is printed, messages below it are skipped. Default is DEBUG, everything is printed.
+   *
+   * @param level importance and urgency of the least important message.
+   */
+  void setMinLevel(LogLevel level);
+
+  /**
+   * Print messages from a background thread. Messages go into a bounded ring that does not lock, so a slow logger function
+   * no longer holds up the thread that logs. Messages that do not fit into a full ring are dropped and counted.
+   *
+   * @param capacity most messages waiting to be printed, rounded up to a power of two.
+   */
+  void startAsync(size_t capacity);
+
+  /**
+   * Wait until the messages logged so far have been printed. Does nothing if messages are printed synchronously.
+   */
+  void flush();
+
+  /**
+   * Print the waiting messages, end the background thread and go back to printing on the thread that logs. Other threads may
+   * keep logging meanwhile.
+   */
+  void stopAsync();
+
+  /**
+   * Get the count of messages dropped because the ring of the background thread was full.
+   */
+  unsigned long long getDroppedCount();
+
+  /**
+   * Check if a message of the given level would be printed, to skip building messages nobody reads.
+   *
+   * @param level importance and urgency of the message.
+   */
+  bool isEnabled(LogLevel level);
+
 private:
   class LoggerModuleImpl;
   std::unique_ptr<LoggerModuleImpl> impl;
@@ -0,0 +1,106 @@
+#ifndef METRICS_REGISTRY_HPP_
+#define METRICS_REGISTRY_HPP_
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+
+namespace cly {
+// Count of buckets of a histogram, the last one takes every value above the bound of the one before it.
+const int METRICS_HISTOGRAM_BUCKETS = 8;
+
+/**
+ * Upper bounds in microseconds of the histogram buckets but the last: 10us, 100us, 1ms, 10ms, 100ms, 1s and 10s.
+ */
+extern const long long METRICS_HISTOGRAM_BOUNDS[METRICS_HISTOGRAM_BUCKETS - 1];
+
+struct HistogramSnapshot {
+  unsigned long long count = 0;
+  // sum and largest of the recorded durations in microseconds
+  unsigned long long sum = 0;
+  unsigned long long max = 0;
+  unsigned long long buckets[METRICS_HISTOGRAM_BUCKETS] = {};
+};
+
+/**
+ * Histogram of durations with fixed buckets. Recording only adds to atomic counters, so any thread can record without a lock.
+ */
+class Histogram {
+private:
+  std::atomic<unsigned long long> _count{0};
+  std::atomic<unsigned long long> _sum{0};
+  std::atomic<unsigned long long> _max{0};
+  std::atomic<unsigned long long> _buckets[METRICS_HISTOGRAM_BUCKETS] = {};
+
+public:
+  void record(std::chrono::microseconds duration);
+
+  /**
+   * Counters are read one by one, a snapshot taken while others record may be off by the values recorded meanwhile.
+   */
+  HistogramSnapshot snapshot() const;
+};
+
+struct MetricsSnapshot {
+  // events added, events packed into requests and events cleared from the queue without being sent
+  unsigned long long events_recorded = 0;
+  unsigned long long events_aggregated = 0;
+  unsigned long long events_dropped = 0;
+
+  // requests added to the queue, older requests dropped to make room and new requests dropped for lack of room
+  unsigned long long requests_queued = 0;
+  unsigned long long requests_evicted = 0;
+  unsigned long long requests_rejected = 0;
+
+  unsigned long long http_attempts = 0;
+  unsigned long long http_successes = 0;
+  unsigned long long http_failures = 0;
+  // bytes of requests handed to the transport
+  unsigned long long bytes_sent = 0;
+
+  unsigned long long log_messages_dropped = 0;
+
+  // sizes of the queues at the time of the snapshot
+  long long event_queue_bytes = 0;
+  long long request_queue_bytes = 0;
+
+  HistogramSnapshot request_latency;
+  // time of the storage operations of the request queue
+  HistogramSnapshot storage_latency;
+  // time spent waiting for the SDK lock
+  HistogramSnapshot lock_wait;
+};
+
+using MetricsCallback = std::function<void(const MetricsSnapshot &)>;
+
+/**
+ * Counters of what the SDK does, shared by the modules through the configuration.
+ */
+class MetricsRegistry {
+public:
+  std::atomic<unsigned long long> events_recorded{0};
+  std::atomic<unsigned long long> events_aggregated{0};
+  std::atomic<unsigned long long> events_dropped{0};
+  std::atomic<unsigned long long> requests_queued{0};
+  std::atomic<unsigned long long> requests_evicted{0};
+  std::atomic<unsigned long long> requests_rejected{0};
+  std::atomic<unsigned long long> http_attempts{0};
+  std::atomic<unsigned long long> http_successes{0};
+  std::atomic<unsigned long long> http_failures{0};
+  std::atomic<unsigned long long> bytes_sent{0};
+  Histogram request_latency;
+  Histogram storage_latency;
+  Histogram lock_wait;
+
+  /**
+   * Lock the mutex and record how long it took to get it.
+   */
+  void lock(std::mutex &mutex);
+
+  /**
+   * @return the counters, the sizes of the queues and the dropped log messages are left to the caller
+   */
+  MetricsSnapshot snapshot() const;
+};
+} // namespace cly
+#endif
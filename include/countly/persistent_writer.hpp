@@ -0,0 +1,97 @@
+#ifndef PERSISTENT_WRITER_HPP_
+#define PERSISTENT_WRITER_HPP_
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cly {
+/**
+ * Writes records to the database from a background thread.
+ * Records added from any thread are queued and committed together in one transaction, once 'persistentWriteBatchSize' records
+ * are waiting or the oldest one has waited 'persistentWriteMaxLatency' milliseconds.
+ * A batch that could not be committed, e.g. because another connection kept the database locked, is queued again and tried later
+ * with a growing delay, its records count as pending until they are committed. A batch that still fails after a few attempts is
+ * dropped and counted in 'droppedCount'.
+ * While the writer is not running, records are committed on the caller's thread.
+ */
+class PersistentWriter {
+public:
+  struct Record {
+    std::string statement;
+    std::string value;
+    std::chrono::steady_clock::time_point added;
+  };
+
+private:
+  std::shared_ptr<CountlyConfiguration> _configuration;
+  std::shared_ptr<LoggerModule> _logger;
+
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  std::condition_variable _committed_condition;
+  std::unique_ptr<std::thread> _thread;
+  std::deque<Record> _records;
+  std::map<std::string, size_t> _pending;
+  unsigned long long _added_count = 0;
+  unsigned long long _committed_count = 0;
+  unsigned long long _dropped_count = 0;
+  bool _running = false;
+  bool _stop_requested = false;
+  bool _flush_requested = false;
+
+  void writeLoop();
+
+  /**
+   * Commit the given records in one transaction.
+   * @return true if every record was written
+   */
+  bool commit(const std::vector<Record> &records);
+
+public:
+  PersistentWriter(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger);
+  ~PersistentWriter();
+
+  /**
+   * Start the background thread.
+   */
+  void start();
+
+  /**
+   * Commit every queued record and stop the background thread. Records that still could not be committed stay queued and are
+   * committed once the writer is started again.
+   */
+  void stop();
+
+  /**
+   * Queue a record to be written.
+   * @param statement: SQL statement with a single parameter, e.g. "INSERT INTO events (event) VALUES(?);"
+   * @param value: text bound to the parameter of the statement
+   */
+  void write(const std::string &statement, const std::string &value);
+
+  /**
+   * Block until every record queued before this call has been committed or dropped after failing to commit.
+   */
+  void flush();
+
+  /**
+   * @return the count of records dropped because they could not be committed
+   */
+  unsigned long long droppedCount();
+
+  /**
+   * @param statement: statement the records were queued with
+   * @return the count of records with the given statement that are not committed yet
+   */
+  size_t pendingCount(const std::string &statement);
+};
+} // namespace cly
+#endif
@@ -0,0 +1,46 @@
+#ifndef QUEUE_SNAPSHOT_HPP_
+#define QUEUE_SNAPSHOT_HPP_
+#include "countly/constants.hpp"
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#include "countly/storage_module_base.hpp"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace cly {
+/**
+ * Saves the event and request queues of memory-only builds to a binary file at 'queueSnapshotPath' and restores them on start.
+ * The file holds a small header followed by every event and then every request, each as a 32 bit length and its content.
+ */
+class QueueSnapshot {
+private:
+  std::shared_ptr<CountlyConfiguration> _configuration;
+  std::shared_ptr<LoggerModule> _logger;
+
+public:
+  using RecordVisitor = std::function<void(const BufferView &record)>;
+
+  QueueSnapshot(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger);
+  ~QueueSnapshot();
+
+  /**
+   * Write the given queues to the snapshot file, replacing the previous one.
+   * @param events: serialized events, oldest first
+   * @param requests: storage module holding the request queue
+   * @return true if the snapshot was written
+   */
+  bool save(const std::deque<std::string> &events, StorageModuleBase &requests);
+
+  /**
+   * Read the snapshot file and remove it, so the same queues are not restored twice.
+   * The file is memory-mapped, records are given as views that are only valid during the call.
+   * @param onEvent: called with every stored event, oldest first
+   * @param onRequest: called with every stored request, oldest first
+   * @return true if a snapshot was restored
+   */
+  bool load(const RecordVisitor &onEvent, const RecordVisitor &onRequest);
+};
+} // namespace cly
+#endif
@@ -0,0 +1,46 @@
+#ifndef REMOTE_CONFIG_CACHE_HPP_
+#define REMOTE_CONFIG_CACHE_HPP_
+#include "countly/constants.hpp"
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace cly {
+/**
+ * Keeps the last fetched remote config in a JSON file at 'remoteConfigCachePath', together with the entity tag the server sent
+ * with it, so that it can be read as soon as the SDK starts and refreshed with a conditional request. The remote config depends
+ * on the device, the cache is only used for the device it was fetched for.
+ */
+class RemoteConfigCache {
+private:
+  std::shared_ptr<CountlyConfiguration> _configuration;
+  std::shared_ptr<LoggerModule> _logger;
+  // saves may come from several fetches at a time
+  std::mutex _mutex;
+
+public:
+  RemoteConfigCache(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger);
+  ~RemoteConfigCache();
+
+  /**
+   * Write the remote config to the cache file, replacing the previous one.
+   * @param values: the remote config, a JSON object
+   * @param etag: entity tag of the response it came from, empty if the server sent none
+   * @param device_id: device the remote config was fetched for
+   * @return true if the file was written
+   */
+  bool save(const nlohmann::json &values, const std::string &etag, const std::string &device_id);
+
+  /**
+   * Read the cache file.
+   * @param device_id: current device, a cache of another device is not read
+   * @param values: set to the cached remote config
+   * @param etag: set to the cached entity tag
+   * @return true if a valid cache was read, the arguments are left as they are otherwise
+   */
+  bool load(const std::string &device_id, nlohmann::json &values, std::string &etag);
+};
+} // namespace cly
+#endif
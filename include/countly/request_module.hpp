@@ -8,6 +8,7 @@
 #include "countly/countly_configuration.hpp"
 #include "countly/logger_module.hpp"
 #include "countly/request_builder.hpp"
+#include "countly/retry_policy.hpp"
 #include "countly/storage_module_base.hpp"
 
 namespace cly {
@@ -19,12 +20,32 @@ public:
 
   HTTPResponse sendHTTP(std::string path, std::string data);
 
+  /**
+   * Sends the given request body without copying it, unless a checksum has to be appended or a custom HTTP client function needs an owning string.
+   * @param path: path of the endpoint, e.g. "/i"
+   * @param data: view of the serialized request, must stay valid until the call returns
+   * @param if_none_match: entity tag of the cached response, the server answers '304 Not Modified' if it is still current
+   */
+  HTTPResponse sendHTTP(const std::string &path, const BufferView &data, const std::string &if_none_match = "");
+
+  /**
+   * @return the SHA-256 checksum of the data with the salt appended, as it is sent with salted requests
+   */
+  std::string calculateChecksum(const std::string &salt, const BufferView &data);
+
   /**
    * SDK central execution call for processing requests in the request queue.
-   * Only one sender is active at a time. Requests are processed in order.
+   * Only one sender is active at a time. Requests of every class are processed in order, the lanes of the classes take weighted
+   * turns with the more important ones first. After a failed request nothing is sent until the retry policy allows it.
+   * A call sends at most 'getProcessingBatchSize' requests, at the upload rate allowed by the bandwidth limit, and none while
+   * uploads are paused.
    */
   void processQueue(std::shared_ptr<std::mutex> mutex);
 
+  /**
+   * Queue a request in the lane of its class. When the queue is full, the oldest request of the least important lane is dropped.
+   * @param data: parameters of the request
+   */
   void addRequestToQueue(const std::map<std::string, std::string> &data);
 
   /**
@@ -37,7 +58,53 @@ public:
 
   long long RQSize();
 
+  /**
+   * @return the size of the stored requests in bytes
+   */
+  long long RQBytes();
+
+  /**
+   * @return the state of the circuit breaker, open while the server is considered down
+   */
+  CircuitState getCircuitState();
+
+  /**
+   * @return the number of requests the next cycle of processing the queue sends at most. With a processing time budget it is the
+   * number of requests that fit in the budget at the average latency, clamped to the min and max batch size.
+   */
+  unsigned int getProcessingBatchSize();
+
+  /**
+   * @return the moving average of the time 'sendHTTP' took in microseconds, 0 before the first request
+   */
+  long long getAverageLatency();
+
+  /**
+   * Cap the rate requests are uploaded at, with the built-in HTTP client and with a custom HTTP client function alike.
+   * @param bytesPerSecond: most bytes of requests uploaded a second on average, 0 for no limit
+   * @param burstBytes: most bytes uploaded at once after being idle, 0 for a second's worth of bytes
+   */
+  void setUploadBandwidthLimit(size_t bytesPerSecond, size_t burstBytes);
+
+  /**
+   * Cancel the requests the transport has in flight, they complete as failed requests. A request waiting for upload bandwidth
+   * gives up and no further request is sent by this module, the request module created by the next 'start' sends them.
+   */
+  void cancelRequests();
+
+  /**
+   * Hold back uploads of the request queue, a request waiting for bandwidth is not sent either.
+   */
+  void pauseUploads();
+
+  void resumeUploads();
+
 private:
+  /**
+   * Sends the request with the transport, 'sendHTTP' measures how long it takes.
+   */
+  HTTPResponse transmit(const std::string &path, const BufferView &data, const std::string &if_none_match);
+
   class RequestModuleImpl;
   std::unique_ptr<RequestModuleImpl> impl;
 };
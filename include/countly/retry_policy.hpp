@@ -0,0 +1,75 @@
+#ifndef RETRY_POLICY_HPP_
+#define RETRY_POLICY_HPP_
+#include "countly/constants.hpp"
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#include <chrono>
+#include <memory>
+#include <random>
+
+namespace cly {
+/**
+ * State of the circuit breaker in front of the server.
+ * CLOSED: requests are sent, failures back off. OPEN: the server is considered down and nothing is sent until the delay has passed.
+ * HALF_OPEN: a single request probes whether the server is back.
+ */
+enum class CircuitState { CLOSED = 0, OPEN = 1, HALF_OPEN = 2 };
+
+/**
+ * Decides when the request queue is sent again after a failed request.
+ * Every failure waits a random delay between 'retryBaseDelay' and three times the previous delay, capped at 'retryMaxDelay'
+ * (decorrelated jitter), so devices that failed together do not retry together. After 'circuitBreakerThreshold' failures in a row
+ * the circuit opens. A 'Retry-After' sent with a 429 or 503 response is waited for when it is longer than the delay.
+ * Calls are serialized by the caller.
+ */
+class RetryPolicy {
+public:
+  using Clock = std::chrono::steady_clock;
+
+private:
+  std::shared_ptr<CountlyConfiguration> _configuration;
+  std::shared_ptr<LoggerModule> _logger;
+  std::default_random_engine _random;
+
+  CircuitState _state = CircuitState::CLOSED;
+  unsigned int _consecutive_failures = 0;
+  std::chrono::milliseconds _delay{0};
+  Clock::time_point _next_attempt;
+
+  /**
+   * @return the delay after the next failure, growing from the previous one with random jitter
+   */
+  std::chrono::milliseconds nextDelay();
+
+public:
+  RetryPolicy(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger);
+  ~RetryPolicy();
+
+  /**
+   * Check whether a request may be sent now. Moves an open circuit to half-open once its delay has passed.
+   * @return false while backing off or while the circuit is open
+   */
+  bool canSend(Clock::time_point now);
+
+  /**
+   * Record a delivered request. Closes the circuit and resets the delay.
+   */
+  void onSuccess();
+
+  /**
+   * Record a failed request and schedule the next attempt.
+   * @param response: response of the failed request, its status code and 'Retry-After' are taken into account
+   */
+  void onFailure(const HTTPResponse &response, Clock::time_point now);
+
+  CircuitState getState() const { return _state; }
+
+  unsigned int getConsecutiveFailures() const { return _consecutive_failures; }
+
+  /**
+   * @return the earliest time the next request may be sent, only meaningful after a failure
+   */
+  Clock::time_point getNextAttempt() const { return _next_attempt; }
+};
+} // namespace cly
+#endif
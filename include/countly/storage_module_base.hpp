@@ -2,15 +2,28 @@
 #define STORAGE_MODULE_BASE_HPP_
 #include "countly/countly_configuration.hpp"
 #include "countly/logger_module.hpp"
+#include <array>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace cly {
 
+/**
+ * Tier of a storage that keeps requests in several others, which number their requests independently.
+ */
+enum class StorageTier { NONE = 0, MEMORY = 1, PERSISTENT = 2 };
+
 class DataEntry {
 private:
   long long _id;
-  std::string _data;
+  mutable std::string _data;
+  mutable bool _is_data_copied = false;
+  BufferView _view;
+  std::shared_ptr<const void> _backing;
+  StorageTier _tier = StorageTier::NONE;
 
 public:
   DataEntry(const long long id, const std::string &data) {
@@ -18,6 +31,16 @@ public:
     this->_data = data;
   }
 
+  /**
+   * Creates an entry whose content is a view into storage owned by 'backing'.
+   * The content stays valid for as long as the entry (and so the backing) is alive.
+   */
+  DataEntry(const long long id, const BufferView &view, std::shared_ptr<const void> backing) {
+    this->_id = id;
+    this->_view = view;
+    this->_backing = backing;
+  }
+
   ~DataEntry() {}
 
   /**
@@ -26,11 +49,81 @@ public:
   long long getId() const { return _id; }
 
   /**
+   * @return tier the entry was peeked from, ids are only unique within it
+   */
+  StorageTier getTier() const { return _tier; }
+
+  void setTier(StorageTier tier) { _tier = tier; }
+
+  /**
+   * Content of the entry as a string. For view backed entries the content is copied once on the first call.
    * @return content of data entry
    */
-  const std::string &getData() const { return _data; }
+  const std::string &getData() const {
+    if (_backing != nullptr && !_is_data_copied) {
+      _data = _view.toString();
+      _is_data_copied = true;
+    }
+    return _data;
+  }
+
+  /**
+   * @return a non-owning view of the content, does not copy
+   */
+  BufferView getView() const { return _backing != nullptr ? _view : BufferView(_data); }
 };
 
+/**
+ * Class of a request. Requests of every class are queued in a lane of their own, lower values are more important.
+ */
+enum class RequestClass { SESSION = 0, CRASH = 1, USER_DETAILS = 2, EVENTS = 3 };
+
+const int REQUEST_CLASS_COUNT = 4;
+
+/**
+ * Finds the class of a serialized request from the parameters it has, in a single pass over it.
+ * Requests without any of the known parameters, e.g. device ID changes, are in the events class so they keep their order with events.
+ * @param request: serialized request, e.g. "app_key=...&begin_session=1"
+ * @return class of the most important parameter in the request
+ */
+inline RequestClass classifyRequest(const BufferView &request) {
+  static const struct {
+    const char *key;
+    RequestClass requestClass;
+  } classified_keys[] = {{"begin_session", RequestClass::SESSION}, {"end_session", RequestClass::SESSION}, {"session_duration", RequestClass::SESSION}, {"crash", RequestClass::CRASH},
+                         {"user_details", RequestClass::USER_DETAILS}, {"location", RequestClass::USER_DETAILS}, {"city", RequestClass::USER_DETAILS}, {"country_code", RequestClass::USER_DETAILS},
+                         {"ip_address", RequestClass::USER_DETAILS}};
+
+  RequestClass result = RequestClass::EVENTS;
+  const char *position = request.data();
+  const char *end = request.data() + request.size();
+  while (position < end) {
+    // values are URL encoded, so every '&' starts a new parameter
+    const char *parameter_end = static_cast<const char *>(std::memchr(position, '&', end - position));
+    if (parameter_end == nullptr) {
+      parameter_end = end;
+    }
+
+    const char *key_end = static_cast<const char *>(std::memchr(position, '=', parameter_end - position));
+    const size_t key_size = (key_end == nullptr ? parameter_end : key_end) - position;
+    for (const auto &classified_key : classified_keys) {
+      if (classified_key.requestClass < result && std::strlen(classified_key.key) == key_size && std::memcmp(classified_key.key, position, key_size) == 0) {
+        result = classified_key.requestClass;
+      }
+    }
+
+    position = parameter_end + 1;
+  }
+
+  return result;
+}
+
+/**
+ * Called with the id and the content of a stored request. The content is only valid during the call.
+ * @return false to stop visiting the following requests
+ */
+using RequestVisitor = std::function<bool(long long id, const BufferView &request)>;
+
 class StorageModuleBase {
 protected:
   bool _is_initialized = false;
@@ -61,39 +154,106 @@ public:
    */
   virtual long long RQCount() = 0;
 
+  /**
+   * Returns the count of stored requests of the given class.
+   * @param requestClass: class of the requests to count
+   * @return count of stored requests in the lane of the class
+   */
+  virtual long long RQCount(RequestClass requestClass) = 0;
+
+  /**
+   * Returns the count of stored requests of every class at once, for choosing a lane without peeking into the empty ones.
+   * @return counts of stored requests indexed by class, or '-1' for every class if the module is not initialized
+   */
+  virtual std::array<long long, REQUEST_CLASS_COUNT> RQCountByClass() {
+    std::array<long long, REQUEST_CLASS_COUNT> counts;
+    for (int lane = 0; lane < REQUEST_CLASS_COUNT; lane++) {
+      counts[lane] = RQCount(static_cast<RequestClass>(lane));
+    }
+    return counts;
+  }
+
+  /**
+   * Returns the size of stored requests in bytes. The size is tracked on every change, so this does not read the storage.
+   * @return size of stored requests in bytes
+   */
+  virtual long long RQBytes() = 0;
+
   /**
    * Delete all stored requests.
    */
   virtual void RQClearAll() = 0;
 
   /**
-   * Remove front request from the request queue.
+   * Remove the oldest request from the request queue, whatever its class.
    */
   virtual void RQRemoveFront() = 0;
 
   /**
-   * Retrieve the element at the front of the queue. It does not deletes the element in the queue.
+   * Retrieve the oldest element of the queue, whatever its class. It does not deletes the element in the queue.
    * @return front request of the queue.
    */
   const virtual std::shared_ptr<DataEntry> RQPeekFront() = 0;
 
+  /**
+   * Retrieve the oldest request of the given class. It does not delete the request.
+   * @param requestClass: class of the lane to peek
+   * @return front request of the lane, a request with id '-1' if the lane is empty
+   */
+  const virtual std::shared_ptr<DataEntry> RQPeekFront(RequestClass requestClass) = 0;
+
+  /**
+   * Visit the requests in the request queue in the order they were inserted, without removing or copying them.
+   * The queue must not be changed from the visitor.
+   * @param visitor: called with every request until it returns false
+   * @param limit: maximum count of requests to visit, 0 visits every request
+   * @return count of requests given to the visitor
+   */
+  virtual size_t RQForEach(const RequestVisitor &visitor, size_t limit = 0) = 0;
+
   /**
    * Retrieve all requests in the request queue without removing them.
+   * Every request is copied, 'RQForEach' can be used to read them in place.
    * @return a vector of requests.
    */
-  virtual std::vector<std::shared_ptr<DataEntry>> RQPeekAll() = 0;
+  std::vector<std::shared_ptr<DataEntry>> RQPeekAll() {
+    std::vector<std::shared_ptr<DataEntry>> requests;
+    RQForEach([&requests](long long id, const BufferView &request) {
+      requests.push_back(std::make_shared<DataEntry>(id, request.toString()));
+      return true;
+    });
+    return requests;
+  }
 
   /**
-   * Remove the front request from the request queue if provided request's id and front request's id do match.
-   * @param request: a shared pointer to front request
+   * Remove the given request if it is still at the front of its lane.
+   * @param request: a shared pointer to a request peeked from the front of the queue or of a lane
    */
   virtual void RQRemoveFront(std::shared_ptr<DataEntry> request) = 0;
 
   /**
-   * Insert element into the request queue at the end.
+   * Remove the oldest request of the given class.
+   * @param requestClass: class of the lane to remove from
+   */
+  virtual void RQRemoveFront(RequestClass requestClass) = 0;
+
+  /**
+   * Insert element into the request queue at the end of the lane of its class.
    * @param request: content of the request
    */
   virtual void RQInsertAtEnd(const std::string &request) = 0;
+
+  /**
+   * Write requests that are only kept in memory to persistent storage.
+   * Called when the SDK stops. Does nothing for modules that store every request persistently or only in memory.
+   */
+  virtual void persist() {}
+
+  /**
+   * Reclaim a part of the storage space freed by removed requests.
+   * Called from the update thread after the request queue has been drained. Does nothing for modules without such space.
+   */
+  virtual void compact() {}
 };
 
 } // namespace cly
@@ -2,28 +2,79 @@
 #define STORAGE_MODULE_DB_HPP_
 #include "countly/countly_configuration.hpp"
 #include "countly/logger_module.hpp"
+#include "countly/persistent_writer.hpp"
 #include "countly/storage_module_base.hpp"
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace cly {
 class StorageModuleDB : public StorageModuleBase {
 private:
+  // when set, inserts are handed to the writer and committed in batches
+  std::shared_ptr<PersistentWriter> _writer;
+
+  // size of the stored requests, read once in 'init' and kept up to date afterwards
+  long long _request_bytes = 0;
+
   bool createSchema(const char tableName[], const char keyColumnName[], const char dataColumnName[]);
+
+  /**
+   * Add the class column and its index to the requests table if it does not have them, classifying the stored requests.
+   * @return true if the table has the column
+   */
+  bool createClassColumn();
   void vacuumDatabase();
 
+  /**
+   * Move up to the given number of free pages to the end of the database file and truncate them.
+   * @param pages: count of pages to reclaim, 0 reclaims every free page
+   */
+  void incrementalVacuum(unsigned int pages);
+
+  /**
+   * @param condition: SQL condition of the rows, e.g. "WHERE RequestClass = 0", empty to include every row
+   * @return count of stored rows that match the condition, without the ones waiting in the writer
+   */
+  long long countRequests(const std::string &condition);
+
+  /**
+   * Retrieve the request with the lowest id among the rows that match the given condition.
+   * @param condition: SQL condition of the rows, empty to include every row
+   */
+  const std::shared_ptr<DataEntry> peekFront(const std::string &condition);
+
+  /**
+   * Remove the request with the lowest id among the rows that match the given condition.
+   * @param condition: SQL condition of the rows, empty to include every row
+   */
+  void removeFront(const std::string &condition);
+
 public:
-  StorageModuleDB(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger);
+  StorageModuleDB(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<PersistentWriter> writer = nullptr);
   ~StorageModuleDB();
 
   void init() override;
   long long RQCount() override;
+  long long RQCount(RequestClass requestClass) override;
+  std::array<long long, REQUEST_CLASS_COUNT> RQCountByClass() override;
+  long long RQBytes() override;
   void RQClearAll() override;
   virtual void RQRemoveFront() override;
   const std::shared_ptr<DataEntry> RQPeekFront() override;
-  std::vector<std::shared_ptr<DataEntry>> RQPeekAll() override;
+  const std::shared_ptr<DataEntry> RQPeekFront(RequestClass requestClass) override;
+  size_t RQForEach(const RequestVisitor &visitor, size_t limit = 0) override;
   void RQRemoveFront(std::shared_ptr<DataEntry> request) override;
+  void RQRemoveFront(RequestClass requestClass) override;
   void RQInsertAtEnd(const std::string &request) override;
+  void compact() override;
+
+  /**
+   * Insert the given requests in front of the stored ones, keeping their order, in a single transaction. Stored requests get
+   * higher ids if there are not enough positive ids in front of them.
+   * @param requests: content of the requests, oldest first
+   */
+  void RQInsertAtFront(const std::vector<std::string> &requests);
 };
 } // namespace cly
 #endif
\ No newline at end of file
@@ -3,16 +3,93 @@
 #include "countly/countly_configuration.hpp"
 #include "countly/logger_module.hpp"
 #include "countly/storage_module_base.hpp"
+#include <array>
 #include <deque>
 #include <memory>
 #include <string>
 #include <vector>
 
 namespace cly {
+/**
+ * Request queue kept in memory.
+ * Requests are stored as fixed-size headers in a ring per request class, their content is appended to chunks of an arena shared by all
+ * classes. A chunk is released once every request in it is removed, and kept to be reused for new requests once no peeked entry
+ * views it anymore. The entry handed out by a peek is reused too while nobody else holds it, so inserting, peeking and removing
+ * requests does not allocate once the queue has reached its usual size.
+ */
 class StorageModuleMemory : public StorageModuleBase {
 private:
+  struct RequestHeader {
+    long long id;
+    // sequence number of the arena chunk that holds the content
+    unsigned long long chunk;
+    size_t offset;
+    size_t size;
+  };
+
+  struct ArenaChunk {
+    std::shared_ptr<char> data;
+    size_t capacity = 0;
+    size_t used = 0;
+    // count of queued requests with content in this chunk
+    size_t count = 0;
+  };
+
+  struct Lane {
+    // oldest request is at 'head', the ring grows only when it is full
+    std::vector<RequestHeader> ring;
+    size_t head = 0;
+    size_t count = 0;
+    // entry given out by the last peek of the lane, reused by the next one if nobody else holds it
+    std::shared_ptr<DataEntry> peeked;
+
+    const RequestHeader &headerAt(size_t index) const { return ring[(head + index) % ring.size()]; }
+  };
+
   long long _lastUsedId = 0;
-  std::deque<std::shared_ptr<DataEntry>> request_queue;
+  long long _request_bytes = 0;
+
+  // one lane per request class, '_count' is the count of requests in all of them
+  std::array<Lane, REQUEST_CLASS_COUNT> _lanes;
+  size_t _count = 0;
+
+  // chunks in the order they were filled, '_first_chunk' is the sequence number of the front one
+  std::deque<ArenaChunk> _chunks;
+  unsigned long long _first_chunk = 0;
+  ArenaChunk _spare_chunk;
+
+  /**
+   * @return an entry viewing the front request of the lane
+   */
+  std::shared_ptr<DataEntry> peekLane(Lane &lane);
+
+  /**
+   * @return the lane whose front request is the oldest one in the queue, nullptr if the queue is empty
+   */
+  Lane *oldestLane();
+
+  /**
+   * Reserve space for the content of a new request at the end of the arena.
+   * @return where the content is to be written
+   */
+  char *allocate(size_t size, unsigned long long &chunk, size_t &offset);
+
+  void popFront(Lane &lane);
+
+  /**
+   * Make the peeked entries that nobody else holds stop viewing requests that are no longer at the front of their lane.
+   */
+  void releasePeeked();
+
+  /**
+   * Drop the chunks in front that do not hold any queued request anymore.
+   */
+  void releaseChunks();
+
+  /**
+   * Keep the given chunk to store new requests in once no entry views it anymore.
+   */
+  void recycleChunk(ArenaChunk &chunk);
 
 public:
   StorageModuleMemory(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger);
@@ -20,12 +97,22 @@ public:
 
   void init() override;
   long long RQCount() override;
+  long long RQCount(RequestClass requestClass) override;
+  long long RQBytes() override;
   void RQClearAll() override;
   virtual void RQRemoveFront() override;
   const std::shared_ptr<DataEntry> RQPeekFront() override;
-  std::vector<std::shared_ptr<DataEntry>> RQPeekAll() override;
+  const std::shared_ptr<DataEntry> RQPeekFront(RequestClass requestClass) override;
+  size_t RQForEach(const RequestVisitor &visitor, size_t limit = 0) override;
   void RQRemoveFront(std::shared_ptr<DataEntry> request) override;
+  void RQRemoveFront(RequestClass requestClass) override;
   void RQInsertAtEnd(const std::string &request) override;
+
+  /**
+   * Insert element into the request queue at the end, copying the viewed content into the queue.
+   * @param request: content of the request
+   */
+  void RQInsertAtEnd(const BufferView &request);
 };
 } // namespace cly
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,64 @@
+#ifndef STORAGE_MODULE_TIERED_HPP_
+#define STORAGE_MODULE_TIERED_HPP_
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#include "countly/storage_module_base.hpp"
+#include "countly/storage_module_db.hpp"
+#include "countly/storage_module_memory.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cly {
+/**
+ * Request queue made of an in-memory tier in front of a persistent tier.
+ * Requests are kept in memory while they fit under 'requestQueueMemoryWatermark' bytes and are written to the database only
+ * when they do not fit or when the SDK stops. Requests in memory are always older than the ones in the database, so the queue
+ * is drained from memory first, in every lane as well.
+ */
+class StorageModuleTiered : public StorageModuleBase {
+private:
+  std::shared_ptr<StorageModuleMemory> _memory;
+  std::shared_ptr<StorageModuleDB> _persistent;
+
+  // Kept in sync on every operation, so the database is not queried while it has nothing in it
+  size_t _memory_bytes = 0;
+  long long _persistent_count = 0;
+
+  /**
+   * Tag a peeked request with the tier it came from, so it is removed only from that tier.
+   */
+  static std::shared_ptr<DataEntry> tagged(std::shared_ptr<DataEntry> entry, StorageTier tier);
+
+public:
+  StorageModuleTiered(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<PersistentWriter> writer = nullptr);
+  ~StorageModuleTiered();
+
+  void init() override;
+  long long RQCount() override;
+  long long RQCount(RequestClass requestClass) override;
+  std::array<long long, REQUEST_CLASS_COUNT> RQCountByClass() override;
+  long long RQBytes() override;
+  void RQClearAll() override;
+  virtual void RQRemoveFront() override;
+  const std::shared_ptr<DataEntry> RQPeekFront() override;
+  const std::shared_ptr<DataEntry> RQPeekFront(RequestClass requestClass) override;
+  size_t RQForEach(const RequestVisitor &visitor, size_t limit = 0) override;
+  void RQRemoveFront(std::shared_ptr<DataEntry> request) override;
+  void RQRemoveFront(RequestClass requestClass) override;
+  void RQInsertAtEnd(const std::string &request) override;
+  void persist() override;
+  void compact() override;
+
+  /**
+   * @return the size in bytes of the requests held in memory
+   */
+  size_t memoryBytes() const { return _memory_bytes; }
+
+  /**
+   * @return the count of requests held in the database
+   */
+  long long persistentCount() const { return _persistent_count; }
+};
+} // namespace cly
+#endif
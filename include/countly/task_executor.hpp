@@ -0,0 +1,71 @@
+#ifndef TASK_EXECUTOR_HPP_
+#define TASK_EXECUTOR_HPP_
+#include "countly/logger_module.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace cly {
+/**
+ * Runs tasks one at a time on a background thread, started when the first task is submitted.
+ * Tasks have keys: a task submitted while another with the same key is queued or running is not run again, its caller gets
+ * the future of the one already there. This coalesces repeated requests for the same work into one.
+ */
+class TaskExecutor {
+public:
+  // returns whether the work succeeded
+  using Task = std::function<bool()>;
+
+private:
+  struct Entry {
+    std::string key;
+    Task task;
+    std::shared_ptr<std::promise<bool>> promise;
+  };
+
+  std::shared_ptr<LoggerModule> _logger;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  std::unique_ptr<std::thread> _thread;
+  std::deque<Entry> _queue;
+  // futures of the queued and the running tasks by key
+  std::map<std::string, std::shared_future<bool>> _in_flight;
+  bool _stop_requested = false;
+
+  void runLoop();
+
+  /**
+   * Fulfil the futures of the queued tasks with false and drop the tasks. Called with the lock held.
+   */
+  void dropQueued();
+
+public:
+  explicit TaskExecutor(std::shared_ptr<LoggerModule> logger);
+  ~TaskExecutor();
+
+  /**
+   * Queue a task, unless one with the same key is queued or running.
+   * @param key: what the task does, tasks with the same key are coalesced
+   * @param task: the work, run on the executor thread
+   * @return future of the result of the task, false if it was cancelled before it ran
+   */
+  std::shared_future<bool> submit(const std::string &key, Task task);
+
+  /**
+   * Drop the queued tasks, their futures give false. A running task is not interrupted.
+   */
+  void cancelPending();
+
+  /**
+   * Drop the queued tasks, wait for the running one and stop the thread. Tasks submitted later start it again.
+   */
+  void stop();
+};
+} // namespace cly
+#endif
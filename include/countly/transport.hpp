@@ -0,0 +1,64 @@
+#ifndef TRANSPORT_HPP_
+#define TRANSPORT_HPP_
+#include "countly/constants.hpp"
+#include <functional>
+
+namespace cly {
+/**
+ * Request handed to a transport. The views do not own their memory, it stays valid until the completion of the request is called.
+ */
+struct TransportRequest {
+  bool use_post = false;
+  // path of the endpoint, e.g. "/i"
+  BufferView path;
+  // serialized request, sent as the query of a GET or the body of a POST request
+  BufferView data;
+  // entity tag of a cached response, sent as 'If-None-Match' so that the server may answer '304 Not Modified'; empty for none.
+  // A transport that can not send it leaves it out and gets the whole response.
+  BufferView if_none_match;
+};
+
+/**
+ * What a transport supports on its connections, the SDK adapts how it uses the transport to it.
+ */
+struct TransportCapabilities {
+  // most requests the transport takes at a time, 0 for no limit
+  unsigned int max_in_flight = 0;
+  // the transport accepts compressed responses and decompresses them
+  bool compression = false;
+};
+
+using TransportHandle = unsigned long long;
+using TransportCompletion = std::function<void(const HTTPResponse &)>;
+
+/**
+ * Sends requests to the Countly server. Implement it to plug in an HTTP stack of your own, blocking or asynchronous.
+ * The built-in HTTP client and the 'HTTPClientFunction' are transports too.
+ */
+class Transport {
+public:
+  virtual ~Transport() {}
+
+  virtual TransportCapabilities getCapabilities() const = 0;
+
+  /**
+   * Start sending a request. The completion is called exactly once, from any thread, and possibly before 'submit' returns.
+   * @param request: the request, its views stay valid until the completion is called
+   * @param completion: called with the response, or with a failed response if the request could not be sent or was cancelled
+   * @return handle of the request for 'cancel'
+   */
+  virtual TransportHandle submit(const TransportRequest &request, TransportCompletion completion) = 0;
+
+  /**
+   * Cancel a request that is in flight. Its completion is still called, with a failed response.
+   * Nothing happens if the request has completed already.
+   */
+  virtual void cancel(TransportHandle handle) = 0;
+
+  /**
+   * Cancel every request in flight, used when the SDK stops.
+   */
+  virtual void cancelAll() = 0;
+};
+} // namespace cly
+#endif
@@ -0,0 +1,66 @@
+#include "countly/bandwidth_limiter.hpp"
+#include <algorithm>
+
+namespace cly {
+void BandwidthLimiter::refill(Clock::time_point now) {
+  const double elapsed_seconds = std::chrono::duration<double>(now - _last_refill).count();
+  _tokens = std::min(static_cast<double>(_burst_bytes), _tokens + elapsed_seconds * _bytes_per_second);
+  _last_refill = now;
+}
+
+void BandwidthLimiter::setRate(size_t bytesPerSecond, size_t burstBytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _bytes_per_second = bytesPerSecond;
+  _burst_bytes = burstBytes > 0 ? burstBytes : bytesPerSecond;
+  // a new limit starts with a full bucket
+  _tokens = static_cast<double>(_burst_bytes);
+  _last_refill = Clock::now();
+  _condition.notify_all();
+}
+
+bool BandwidthLimiter::acquire(size_t bytes) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    if (_paused || _closed) {
+      return false;
+    }
+
+    if (_bytes_per_second == 0) {
+      return true;
+    }
+
+    refill(Clock::now());
+    const double needed = static_cast<double>(std::min(bytes, _burst_bytes));
+    if (_tokens >= needed) {
+      _tokens -= static_cast<double>(bytes);
+      return true;
+    }
+
+    const std::chrono::duration<double> wait((needed - _tokens) / _bytes_per_second);
+    _condition.wait_for(lock, std::chrono::duration_cast<std::chrono::microseconds>(wait) + std::chrono::microseconds(1));
+  }
+}
+
+void BandwidthLimiter::pause() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _paused = true;
+  _condition.notify_all();
+}
+
+void BandwidthLimiter::resume() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _paused = false;
+  _condition.notify_all();
+}
+
+bool BandwidthLimiter::isPaused() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _paused;
+}
+
+void BandwidthLimiter::close() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _closed = true;
+  _condition.notify_all();
+}
+} // namespace cly
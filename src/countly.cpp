@@ -1,5 +1,8 @@
+#include "countly/queue_snapshot.hpp"
 #include "countly/storage_module_db.hpp"
 #include "countly/storage_module_memory.hpp"
+#include "countly/storage_module_tiered.hpp"
+#include <atomic>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -19,11 +22,62 @@
 #endif
 
 namespace cly {
+#ifdef COUNTLY_USE_SQLITE
+const std::string EVENTS_INSERT_STATEMENT = "INSERT INTO events (event) VALUES(?);";
+const int EVENTS_BUSY_TIMEOUT_MILLISECONDS = 1000;
+
+/**
+ * Open a connection to the database of the events. Every call opens its own connection, and the last one to close checkpoints
+ * the WAL under an exclusive lock, so the connection waits for a lock instead of failing at once while events are recorded
+ * from several threads.
+ */
+static int openEventDatabase(const std::string &path, sqlite3 **database) {
+  const int return_value = sqlite3_open(path.c_str(), database);
+  if (return_value == SQLITE_OK) {
+    sqlite3_busy_timeout(*database, EVENTS_BUSY_TIMEOUT_MILLISECONDS);
+  }
+  return return_value;
+}
+
+/**
+ * @return the size in bytes of the serialized events stored in the given database
+ */
+static size_t selectEventBytes(sqlite3 *database) {
+  size_t bytes = 0;
+  sqlite3_stmt *statement = nullptr;
+  if (sqlite3_prepare_v2(database, "SELECT IFNULL(SUM(LENGTH(CAST(event AS BLOB))), 0) FROM events;", -1, &statement, nullptr) == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW) {
+    bytes = static_cast<size_t>(sqlite3_column_int64(statement, 0));
+  }
+  sqlite3_finalize(statement);
+  return bytes;
+}
+#endif
+
+/**
+ * Raised after every remote config snapshot that is published, by any instance, so that a new instance at the address of an
+ * old one is not mistaken for it.
+ */
+static std::atomic<unsigned long long> remote_config_generation{1};
+
+/**
+ * Remote config snapshot a thread loaded last. Reusing it while no newer one is published keeps typed reads from taking the
+ * lock 'std::atomic_load' of a 'std::shared_ptr' takes from a global pool in common standard libraries.
+ */
+struct CachedRemoteConfig {
+  const Countly *owner = nullptr;
+  unsigned long long generation = 0;
+  std::shared_ptr<const nlohmann::json> snapshot;
+};
+
+static thread_local CachedRemoteConfig cached_remote_config;
+
 Countly::Countly() {
   crash_module = nullptr;
   views_module = nullptr;
   logger.reset(new cly::LoggerModule());
   configuration.reset(new cly::CountlyConfiguration("", ""));
+  remote_config_executor.reset(new cly::TaskExecutor(logger));
+  remote_config_generation++;
 }
 
 Countly::~Countly() {
@@ -31,6 +85,7 @@ Countly::~Countly() {
   stop();
   crash_module.reset();
   views_module.reset();
+  remote_config_executor.reset();
   logger.reset();
 }
 
@@ -62,6 +117,32 @@ void Countly::setMaxRequestQueueSize(unsigned int requestQueueSize) {
   mutex->unlock();
 }
 
+/**
+ * Set limit for the size in bytes of the requests that can be stored locally.
+ * @param requestQueueBytes: max size of request queue in bytes, 0 for no limit
+ */
+void Countly::setMaxRequestQueueBytes(size_t requestQueueBytes) {
+  if (is_sdk_initialized) {
+    log(LogLevel::WARNING, "[Countly][setMaxRequestQueueBytes] You can not set the request queue size after SDK initialization.");
+    return;
+  }
+
+  mutex->lock();
+  configuration->requestQueueMaxBytes = requestQueueBytes;
+  mutex->unlock();
+}
+
+void Countly::setMaxBreadcrumbBytes(size_t breadcrumbBytes) {
+  if (is_sdk_initialized) {
+    log(LogLevel::WARNING, "[Countly][setMaxBreadcrumbBytes] You can not set the breadcrumb size after SDK initialization.");
+    return;
+  }
+
+  mutex->lock();
+  configuration->breadcrumbsMaxBytes = breadcrumbBytes;
+  mutex->unlock();
+}
+
 /**
  * Set limit for the number of requests that can be processed at a time.
  * If the limit is reached, the rest of the requests will be processed in the next cycle.
@@ -73,6 +154,62 @@ void Countly::setMaxRQProcessingBatchSize(unsigned int batchSize) {
   mutex->unlock();
 }
 
+void Countly::setAdaptiveRQProcessing(unsigned int timeBudget, unsigned int minBatchSize, unsigned int maxBatchSize) {
+  if (minBatchSize == 0 || minBatchSize > maxBatchSize) {
+    log(LogLevel::WARNING, "[Countly][setAdaptiveRQProcessing] Min batch size should be at least 1 and not more than the max batch size.");
+    return;
+  }
+
+  mutex->lock();
+  configuration->processingTimeBudget = timeBudget;
+  configuration->minProcessingBatchSize = minBatchSize;
+  configuration->maxProcessingBatchSize = maxBatchSize;
+  mutex->unlock();
+}
+
+void Countly::setRetryPolicy(unsigned int baseDelay, unsigned int maxDelay, unsigned int circuitBreakerThreshold) {
+  if (is_sdk_initialized) {
+    log(LogLevel::WARNING, "[Countly][setRetryPolicy] You can not set the retry policy after SDK initialization.");
+    return;
+  }
+
+  mutex->lock();
+  configuration->retryBaseDelay = baseDelay;
+  configuration->retryMaxDelay = maxDelay;
+  configuration->circuitBreakerThreshold = circuitBreakerThreshold;
+  mutex->unlock();
+}
+
+void Countly::setUploadBandwidthLimit(size_t bytesPerSecond, size_t burstBytes) {
+  mutex->lock();
+  configuration->uploadBandwidthLimit = bytesPerSecond;
+  configuration->uploadBurstSize = burstBytes;
+  if (requestModule) {
+    requestModule->setUploadBandwidthLimit(bytesPerSecond, burstBytes);
+  }
+  mutex->unlock();
+}
+
+void Countly::pauseUploads() {
+  log(LogLevel::INFO, "[Countly][pauseUploads]");
+  mutex->lock();
+  configuration->uploadsPaused = true;
+  if (requestModule) {
+    requestModule->pauseUploads();
+  }
+  mutex->unlock();
+}
+
+void Countly::resumeUploads() {
+  log(LogLevel::INFO, "[Countly][resumeUploads]");
+  mutex->lock();
+  configuration->uploadsPaused = false;
+  if (requestModule) {
+    requestModule->resumeUploads();
+  }
+  mutex->unlock();
+}
+
 void Countly::alwaysUsePost(bool value) {
   if (is_sdk_initialized) {
     log(LogLevel::WARNING, "[Countly][alwaysUsePost] You can not set the http method after SDK initialization.");
@@ -106,6 +243,28 @@ void Countly::setLogger(void (*fun)(LogLevel level, const std::string &message))
   mutex->unlock();
 }
 
+void Countly::setMinLogLevel(LogLevel level) {
+  if (is_sdk_initialized) {
+    log(LogLevel::WARNING, "[Countly][setMinLogLevel] You can not set the log level after SDK initialization.");
+    return;
+  }
+
+  mutex->lock();
+  logger->setMinLevel(level);
+  mutex->unlock();
+}
+
+void Countly::enableAsyncLogging(size_t capacity) {
+  if (is_sdk_initialized) {
+    log(LogLevel::WARNING, "[Countly][enableAsyncLogging] You can not enable asynchronous logging after SDK initialization.");
+    return;
+  }
+
+  mutex->lock();
+  logger->startAsync(capacity);
+  mutex->unlock();
+}
+
 void Countly::setHTTPClient(HTTPClientFunction fun) {
   if (is_sdk_initialized) {
     log(LogLevel::WARNING, "[Countly][setHTTPClient] You can not set the http client after SDK initialization.");
@@ -117,6 +276,17 @@ void Countly::setHTTPClient(HTTPClientFunction fun) {
   mutex->unlock();
 }
 
+void Countly::setTransport(std::shared_ptr<Transport> transport) {
+  if (is_sdk_initialized) {
+    log(LogLevel::WARNING, "[Countly][setTransport] You can not set the transport after SDK initialization.");
+    return;
+  }
+
+  mutex->lock();
+  configuration->transport = transport;
+  mutex->unlock();
+}
+
 void Countly::setSha256(SHA256Function fun) {
   if (is_sdk_initialized) {
     log(LogLevel::WARNING, "[Countly][setHTTPClient] You can not set the 'SHA256' function after SDK initialization.");
@@ -352,6 +522,8 @@ void Countly::_changeDeviceIdWithoutMerge(const std::string &value) {
 
   mutex->lock();
   session_params["device_id"] = value;
+  // the remote config of the new user has to be fetched whole
+  remote_config_etag.clear();
   mutex->unlock();
 
   // start a new session for new user
@@ -419,11 +591,34 @@ void Countly::start(const std::string &app_key, const std::string &host, int por
   session_params["app_key"] = app_key;
 
 #ifdef COUNTLY_USE_SQLITE
-  storageModule.reset(new StorageModuleDB(configuration, logger));
+  if (configuration->persistentWriteBatchSize > 0) {
+    persistentWriter.reset(new PersistentWriter(configuration, logger));
+    persistentWriter->start();
+  }
+
+  if (configuration->requestQueueMemoryWatermark > 0) {
+    storageModule.reset(new StorageModuleTiered(configuration, logger, persistentWriter));
+  } else {
+    storageModule.reset(new StorageModuleDB(configuration, logger, persistentWriter));
+  }
 #else
   storageModule.reset(new StorageModuleMemory(configuration, logger));
 #endif
   storageModule->init();
+#ifndef COUNTLY_USE_SQLITE
+  if (!configuration->queueSnapshotPath.empty()) {
+    restoreQueueSnapshot();
+  }
+#endif
+
+  // the cached remote config can be read right away, before it is fetched again
+  if (!configuration->remoteConfigCachePath.empty()) {
+    remote_config_cache.reset(new cly::RemoteConfigCache(configuration, logger));
+    nlohmann::json cached_values;
+    if (session_params["device_id"].is_string() && remote_config_cache->load(session_params["device_id"].get<std::string>(), cached_values, remote_config_etag)) {
+      _publishRemoteConfig(std::make_shared<const nlohmann::json>(std::move(cached_values)));
+    }
+  }
 
   requestBuilder.reset(new RequestBuilder(configuration, logger));
   requestModule.reset(new RequestModule(configuration, logger, requestBuilder, storageModule));
@@ -469,10 +664,40 @@ void Countly::startOnCloud(const std::string &app_key) {
 }
 
 void Countly::stop() {
+  // fetches not started yet are dropped, the one being sent is cancelled with the other requests
+  remote_config_executor->cancelPending();
+  // the update loop does not wait for a slow response to stop, and a fetch that starts meanwhile does not send its request
+  if (requestModule) {
+    requestModule->cancelRequests();
+  }
+  // not under the SDK mutex, a running fetch takes it to publish the values
+  remote_config_executor->stop();
   _deleteThread();
   if (configuration->manualSessionControl == false) {
     endSession();
   }
+
+  if (storageModule) {
+    mutex->lock();
+    storageModule->persist();
+    mutex->unlock();
+  }
+
+#ifndef COUNTLY_USE_SQLITE
+  if (storageModule && !configuration->queueSnapshotPath.empty()) {
+    saveQueueSnapshot();
+  }
+#endif
+
+#ifdef COUNTLY_USE_SQLITE
+  // commit whatever is still waiting in the writer, later writes are done on the caller's thread
+  if (persistentWriter) {
+    persistentWriter->stop();
+  }
+#endif
+
+  // messages logged while stopping are printed before 'stop' returns, later ones are printed synchronously
+  logger->stopAsync();
 }
 
 void Countly::_deleteThread() {
@@ -496,9 +721,11 @@ void Countly::setUpdateInterval(size_t milliseconds) {
 }
 
 void Countly::addEvent(const cly::Event &event) {
-  mutex->lock();
+  configuration->metricsRegistry->events_recorded++;
+  configuration->metricsRegistry->lock(*mutex);
 #ifndef COUNTLY_USE_SQLITE
   event_queue.push_back(event.serialize());
+  event_queue_bytes += event_queue.back().size();
 #else
   addEventToSqlite(event);
 #endif
@@ -510,8 +737,9 @@ void Countly::checkAndSendEventToRQ() {
   nlohmann::json events = nlohmann::json::array();
   int queueSize = checkEQSize();
   mutex->lock();
+  const bool is_over_byte_threshold = configuration->eventQueueMaxBytes > 0 && event_queue_bytes >= configuration->eventQueueMaxBytes;
 #ifdef COUNTLY_USE_SQLITE
-  if (queueSize >= configuration->eventQueueThreshold) {
+  if (queueSize >= configuration->eventQueueThreshold || is_over_byte_threshold) {
     log(LogLevel::DEBUG, "Event queue threshold is reached");
     std::string event_ids;
 
@@ -525,13 +753,14 @@ void Countly::checkAndSendEventToRQ() {
     removeEventWithId(event_ids);
   }
 #else
-  if (queueSize >= configuration->eventQueueThreshold) {
+  if (queueSize >= configuration->eventQueueThreshold || is_over_byte_threshold) {
     log(LogLevel::WARNING, "Event queue is full, dropping the oldest event to insert a new one");
     for (const auto &event_json : event_queue) {
       events.push_back(nlohmann::json::parse(event_json));
     }
     sendEventsToRQ(events);
     event_queue.clear();
+    event_queue_bytes = 0;
   }
 #endif
   mutex->unlock();
@@ -560,6 +789,15 @@ void Countly::setEventsToRQThreshold(int value) {
   checkAndSendEventToRQ();
 }
 
+void Countly::setEventsToRQByteThreshold(size_t value) {
+  log(LogLevel::DEBUG, "[Countly][setEventsToRQByteThreshold] Given threshold:[" + std::to_string(value) + "] bytes");
+  mutex->lock();
+  configuration->eventQueueMaxBytes = value;
+  // if current queue is already bigger than the new threshold, send events to RQ
+  mutex->unlock();
+  checkAndSendEventToRQ();
+}
+
 void Countly::flushEvents(std::chrono::seconds timeout) {
   log(LogLevel::DEBUG, "[Countly][flushEvents] timeout: " + std::to_string(timeout.count()) + " seconds");
 
@@ -622,7 +860,9 @@ bool Countly::attemptSessionUpdateEQ() {
 
 void Countly::clearEQInternal() {
 #ifndef COUNTLY_USE_SQLITE
+  configuration->metricsRegistry->events_dropped += event_queue.size();
   event_queue.clear();
+  event_queue_bytes = 0;
 #else
   clearPersistentEQ();
 #endif
@@ -633,13 +873,17 @@ std::vector<std::string> Countly::debugReturnStateOfEQ() {
   try {
 
 #ifdef COUNTLY_USE_SQLITE
+    if (persistentWriter) {
+      persistentWriter->flush();
+    }
+
     std::vector<std::string> v;
     sqlite3 *database;
     int return_value, row_count, column_count;
     char **table;
     char *error_message;
 
-    return_value = sqlite3_open(configuration->databasePath.c_str(), &database);
+    return_value = openEventDatabase(configuration->databasePath, &database);
     if (return_value == SQLITE_OK) {
       std::ostringstream sql_statement_stream;
       sql_statement_stream << "SELECT * FROM events ORDER BY evtid ASC;";
@@ -790,6 +1034,7 @@ bool Countly::updateSession() {
 // TODO: check if we want to totally wipe the event queue in memory but not in database
 #ifndef COUNTLY_USE_SQLITE
     event_queue.clear();
+    event_queue_bytes = 0;
 #else
     if (!event_ids.empty()) {
       // this is a partial clearance, we only remove the events that were sent
@@ -838,6 +1083,7 @@ void Countly::packEvents() {
 // TODO: check if we want to totally wipe the event queue in memory but not in database
 #ifndef COUNTLY_USE_SQLITE
     event_queue.clear();
+    event_queue_bytes = 0;
 #else
     if (!event_ids.empty()) {
       // this is a partial clearance, we only remove the events that were sent
@@ -855,6 +1101,7 @@ void Countly::packEvents() {
 
 void Countly::sendEventsToRQ(const nlohmann::json &events) {
   log(LogLevel::DEBUG, "[Countly][sendEventsToRQ] Sending events to RQ.");
+  configuration->metricsRegistry->events_aggregated += events.size();
   std::map<std::string, std::string> data = {{"app_key", session_params["app_key"].get<std::string>()}, {"device_id", session_params["device_id"].get<std::string>()}, {"events", events.dump()}};
   requestModule->addRequestToQueue(data);
 }
@@ -904,6 +1151,67 @@ int Countly::checkEQSize() {
   return event_count;
 }
 
+size_t Countly::checkEQBytes() {
+  log(LogLevel::DEBUG, "[Countly][checkEQBytes]");
+  mutex->lock();
+  size_t result = event_queue_bytes;
+  mutex->unlock();
+  return result;
+}
+
+long long Countly::checkRQBytes() {
+  log(LogLevel::DEBUG, "[Countly][checkRQBytes]");
+  if (!is_sdk_initialized) {
+    log(LogLevel::DEBUG, "[Countly][checkRQBytes] SDK is not initialized.");
+    return -1;
+  }
+
+  mutex->lock();
+  long long result = requestModule->RQBytes();
+  mutex->unlock();
+  return result;
+}
+
+CircuitState Countly::getCircuitState() {
+  if (!is_sdk_initialized) {
+    log(LogLevel::DEBUG, "[Countly][getCircuitState] SDK is not initialized.");
+    return CircuitState::CLOSED;
+  }
+
+  mutex->lock();
+  CircuitState result = requestModule->getCircuitState();
+  mutex->unlock();
+  return result;
+}
+
+unsigned long long Countly::checkDroppedLogCount() { return logger->getDroppedCount(); }
+
+void Countly::setMetricsCallback(MetricsCallback callback, unsigned int intervalMilliseconds) {
+  if (is_sdk_initialized) {
+    log(LogLevel::WARNING, "[Countly][setMetricsCallback] You can not set the metrics callback after SDK initialization.");
+    return;
+  }
+
+  mutex->lock();
+  configuration->metricsCallback = callback;
+  configuration->metricsCallbackInterval = intervalMilliseconds;
+  mutex->unlock();
+}
+
+MetricsSnapshot Countly::getMetricsSnapshot() {
+  MetricsSnapshot snapshot = configuration->metricsRegistry->snapshot();
+  snapshot.log_messages_dropped = logger->getDroppedCount();
+
+  mutex->lock();
+  snapshot.event_queue_bytes = static_cast<long long>(event_queue_bytes);
+  // the storage modules keep the size in bytes at hand, unlike the count of requests which the database has to look up
+  if (is_sdk_initialized) {
+    snapshot.request_queue_bytes = requestModule->RQBytes();
+  }
+  mutex->unlock();
+  return snapshot;
+}
+
 int Countly::checkRQSize() {
   log(LogLevel::DEBUG, "[Countly][checkRQSize]");
   int request_count = -1;
@@ -925,19 +1233,63 @@ int Countly::checkMemoryEQSize() {
   mutex->unlock();
   return result;
 }
+
+void Countly::setQueueSnapshotPath(const std::string &path) {
+  if (is_sdk_initialized) {
+    log(LogLevel::ERROR, "[Countly][setQueueSnapshotPath] You can not set the snapshot path after SDK initialization.");
+    return;
+  }
+
+  configuration->queueSnapshotPath = path;
+  log(LogLevel::INFO, "[Countly][setQueueSnapshotPath] path = " + path);
+}
+
+bool Countly::saveQueueSnapshot() {
+  log(LogLevel::DEBUG, "[Countly][saveQueueSnapshot]");
+  if (!is_sdk_initialized) {
+    log(LogLevel::WARNING, "[Countly][saveQueueSnapshot] SDK is not initialized.");
+    return false;
+  }
+
+  if (configuration->queueSnapshotPath.empty()) {
+    log(LogLevel::ERROR, "[Countly][saveQueueSnapshot] Snapshot path is not set.");
+    return false;
+  }
+
+  mutex->lock();
+  QueueSnapshot snapshot(configuration, logger);
+  bool result = snapshot.save(event_queue, *storageModule);
+  mutex->unlock();
+  return result;
+}
+
+void Countly::restoreQueueSnapshot() {
+  // memory-only builds always queue requests in a memory module, it takes the restored requests without an extra copy
+  std::shared_ptr<StorageModuleMemory> memory_storage = std::static_pointer_cast<StorageModuleMemory>(storageModule);
+  QueueSnapshot snapshot(configuration, logger);
+  snapshot.load(
+      [this](const BufferView &event) {
+        event_queue.push_back(event.toString());
+        event_queue_bytes += event.size();
+      },
+      [&memory_storage](const BufferView &request) { memory_storage->RQInsertAtEnd(request); });
+}
 #endif
 
 // Standalone Sqlite functions
 #ifdef COUNTLY_USE_SQLITE
 void Countly::removeEventWithId(const std::string &event_ids) {
   // TODO: Check if we should check database_path set or not
-  log(LogLevel::DEBUG, "[Countly][removeEventWithId] Removing events from storage: " + event_ids);
+  logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][removeEventWithId] Removing events from storage: " + event_ids; });
+  if (persistentWriter) {
+    persistentWriter->flush();
+  }
   sqlite3 *database;
   int return_value;
   char *error_message;
 
   // we attempt to clear the events in the database only if there were any events collected previously
-  return_value = sqlite3_open(database_path.c_str(), &database);
+  return_value = openEventDatabase(database_path, &database);
   if (return_value == SQLITE_OK) {
     std::ostringstream sql_statement_stream;
     sql_statement_stream << "DELETE FROM events WHERE evtid IN " << event_ids << ';';
@@ -949,6 +1301,7 @@ void Countly::removeEventWithId(const std::string &event_ids) {
       sqlite3_free(error_message);
     } else {
       log(LogLevel::DEBUG, "[Countly][removeEventWithId] Removed events with the given ID(s).");
+      event_queue_bytes = selectEventBytes(database);
     }
   } else {
     log(LogLevel::ERROR, "[Countly][removeEventWithId] Could not open database.");
@@ -966,13 +1319,16 @@ void Countly::fillEventsIntoJson(nlohmann::json &events, std::string &event_ids)
   }
 
   log(LogLevel::DEBUG, "[Countly][fillEventsIntoJson] Fetching events from storage.");
+  if (persistentWriter) {
+    persistentWriter->flush();
+  }
   sqlite3 *database;
   int return_value, row_count, column_count;
   char **table;
   char *error_message;
 
   // open database
-  return_value = sqlite3_open(database_path.c_str(), &database);
+  return_value = openEventDatabase(database_path, &database);
   // if database opened successfully
   if (return_value == SQLITE_OK) {
 
@@ -992,7 +1348,7 @@ void Countly::fillEventsIntoJson(nlohmann::json &events, std::string &event_ids)
         events.push_back(nlohmann::json::parse(table[(event_index * column_count) + 1]));
       }
 
-      log(LogLevel::DEBUG, "[Countly][fillEventsIntoJson] Events count = " + std::to_string(events.size()));
+      logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][fillEventsIntoJson] Events count = " + std::to_string(events.size()); });
 
       event_id_stream.seekp(-1, event_id_stream.cur);
       event_id_stream << ')';
@@ -1021,7 +1377,7 @@ int Countly::checkPersistentEQSize() {
   }
 
   sqlite3 *database;
-  int return_value = sqlite3_open(database_path.c_str(), &database);
+  int return_value = openEventDatabase(database_path, &database);
   mutex->unlock();
 
   if (return_value == SQLITE_OK) {
@@ -1031,7 +1387,11 @@ int Countly::checkPersistentEQSize() {
     return_value = sqlite3_get_table(database, "SELECT COUNT(*) FROM events;", &table, &row_count, &column_count, &error_message);
     if (return_value == SQLITE_OK) {
       result = atoi(table[1]);
-      log(LogLevel::DEBUG, "[Countly][checkEQSize] Fetched event count from database: " + std::to_string(result));
+      // events waiting in the writer are part of the queue as well
+      if (persistentWriter) {
+        result += static_cast<int>(persistentWriter->pendingCount(EVENTS_INSERT_STATEMENT));
+      }
+      logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][checkEQSize] Fetched event count from database: " + std::to_string(result); });
     } else {
       log(LogLevel::ERROR, error_message);
       sqlite3_free(error_message);
@@ -1052,21 +1412,32 @@ void Countly::addEventToSqlite(const cly::Event &event) {
       return;
     }
 
+    if (persistentWriter) {
+      // committed later together with other events and requests by the writer thread
+      const std::string serialized_event = event.serialize();
+      persistentWriter->write(EVENTS_INSERT_STATEMENT, serialized_event);
+      event_queue_bytes += serialized_event.size();
+      return;
+    }
+
     sqlite3 *database;
     int return_value;
     char *error_message;
 
-    return_value = sqlite3_open(database_path.c_str(), &database);
+    return_value = openEventDatabase(database_path, &database);
     if (return_value == SQLITE_OK) {
       std::ostringstream sql_statement_stream;
       // TODO Investigate if we need to escape single quotes in serialized event
-      sql_statement_stream << "INSERT INTO events (event) VALUES('" << event.serialize() << "');";
+      const std::string serialized_event = event.serialize();
+      sql_statement_stream << "INSERT INTO events (event) VALUES('" << serialized_event << "');";
       std::string sql_statement = sql_statement_stream.str();
 
       return_value = sqlite3_exec(database, sql_statement.c_str(), nullptr, nullptr, &error_message);
       if (return_value != SQLITE_OK) {
         log(LogLevel::ERROR, error_message);
         sqlite3_free(error_message);
+      } else {
+        event_queue_bytes += serialized_event.size();
       }
     }
     sqlite3_close(database);
@@ -1079,11 +1450,14 @@ void Countly::addEventToSqlite(const cly::Event &event) {
 
 void Countly::clearPersistentEQ() {
   log(LogLevel::DEBUG, "[Countly][clearEQ]");
+  if (persistentWriter) {
+    persistentWriter->flush();
+  }
   sqlite3 *database;
   int return_value;
   char *error_message;
 
-  return_value = sqlite3_open(database_path.c_str(), &database);
+  return_value = openEventDatabase(database_path, &database);
   if (return_value == SQLITE_OK) {
     return_value = sqlite3_exec(database, "DELETE FROM events;", nullptr, nullptr, &error_message);
     if (return_value != SQLITE_OK) {
@@ -1091,6 +1465,8 @@ void Countly::clearPersistentEQ() {
       sqlite3_free(error_message);
     } else {
       log(LogLevel::DEBUG, "[Countly][clearEQ] Cleared event queue");
+      configuration->metricsRegistry->events_dropped += static_cast<unsigned long long>(sqlite3_changes(database));
+      event_queue_bytes = 0;
     }
   }
   sqlite3_close(database);
@@ -1111,6 +1487,45 @@ void Countly::setDatabasePath(const std::string &path) {
   log(LogLevel::INFO, "[Countly][setDatabasePath] path = " + path);
 }
 
+void Countly::enableRequestQueueMemoryTier(size_t watermarkBytes) {
+  if (is_sdk_initialized) {
+    log(LogLevel::ERROR, "[Countly][enableRequestQueueMemoryTier] You can not enable the memory tier after SDK initialization.");
+    return;
+  }
+
+  configuration->requestQueueMemoryWatermark = watermarkBytes;
+  log(LogLevel::INFO, "[Countly][enableRequestQueueMemoryTier] watermark = " + std::to_string(watermarkBytes) + " bytes");
+}
+
+void Countly::enablePersistentWriteBatching(unsigned int maxBatchSize, unsigned int maxLatencyMilliseconds) {
+  if (is_sdk_initialized) {
+    log(LogLevel::ERROR, "[Countly][enablePersistentWriteBatching] You can not enable write batching after SDK initialization.");
+    return;
+  }
+
+  configuration->persistentWriteBatchSize = maxBatchSize;
+  configuration->persistentWriteMaxLatency = maxLatencyMilliseconds;
+  log(LogLevel::INFO, "[Countly][enablePersistentWriteBatching] batch size = " + std::to_string(maxBatchSize) + ", max latency = " + std::to_string(maxLatencyMilliseconds) + " ms");
+}
+
+void Countly::flushPersistentWrites() {
+  log(LogLevel::DEBUG, "[Countly][flushPersistentWrites]");
+  if (persistentWriter) {
+    persistentWriter->flush();
+  }
+}
+
+void Countly::setDatabaseVacuum(unsigned int pagesPerStep, size_t startupThresholdBytes) {
+  if (is_sdk_initialized) {
+    log(LogLevel::ERROR, "[Countly][setDatabaseVacuum] You can not change the database vacuum after SDK initialization.");
+    return;
+  }
+
+  configuration->incrementalVacuumPages = pagesPerStep;
+  configuration->startupVacuumThreshold = startupThresholdBytes;
+  log(LogLevel::INFO, "[Countly][setDatabaseVacuum] pages per step = " + std::to_string(pagesPerStep) + ", startup threshold = " + std::to_string(startupThresholdBytes) + " bytes");
+}
+
 bool Countly::createEventTableSchema() {
   try {
     bool result = false;
@@ -1121,7 +1536,7 @@ bool Countly::createEventTableSchema() {
 
     database_path = configuration->databasePath;
 
-    return_value = sqlite3_open(database_path.c_str(), &database);
+    return_value = openEventDatabase(database_path, &database);
     if (return_value == SQLITE_OK) {
       return_value = sqlite3_exec(database, "CREATE TABLE IF NOT EXISTS events (evtid INTEGER PRIMARY KEY, event TEXT)", nullptr, nullptr, &error_message);
       if (return_value != SQLITE_OK) {
@@ -1129,6 +1544,8 @@ bool Countly::createEventTableSchema() {
         sqlite3_free(error_message);
       } else {
         result = true;
+        // events left from the previous run
+        event_queue_bytes = selectEventBytes(database);
       }
     } else {
       const char *error = sqlite3_errmsg(database);
@@ -1146,11 +1563,7 @@ bool Countly::createEventTableSchema() {
 #endif
 void Countly::log(LogLevel level, const std::string &message) { logger->log(cly::LogLevel(level), message); }
 
-static size_t countly_curl_write_callback(void *data, size_t byte_size, size_t n_bytes, std::string *body) {
-  size_t data_size = byte_size * n_bytes;
-  body->append((const char *)data, data_size);
-  return data_size;
-}
+void Countly::log(LogLevel level, const char *message) { logger->log(cly::LogLevel(level), message); }
 
 std::string Countly::calculateChecksum(const std::string &salt, const std::string &data) {
   std::string salted_data = data + salt;
@@ -1192,6 +1605,7 @@ void Countly::updateLoop() {
   mutex->lock();
   running = true;
   mutex->unlock();
+  std::chrono::steady_clock::time_point last_metrics_callback = std::chrono::steady_clock::now();
   while (true) {
     mutex->lock();
     if (stop_thread) {
@@ -1208,6 +1622,11 @@ void Countly::updateLoop() {
       packEvents();
     }
     requestModule->processQueue(mutex);
+
+    if (configuration->metricsCallback && std::chrono::steady_clock::now() - last_metrics_callback >= std::chrono::milliseconds(configuration->metricsCallbackInterval)) {
+      last_metrics_callback = std::chrono::steady_clock::now();
+      configuration->metricsCallback(getMetricsSnapshot());
+    }
   }
   mutex->lock();
   running = false;
@@ -1220,51 +1639,160 @@ void Countly::enableRemoteConfig() {
   mutex->unlock();
 }
 
-void Countly::_fetchRemoteConfig(const std::map<std::string, std::string> &data) {
-  HTTPResponse response = requestModule->sendHTTP("/o/sdk", requestBuilder->serializeData(data));
+void Countly::setRemoteConfigCachePath(const std::string &path) {
+  if (is_sdk_initialized) {
+    log(LogLevel::ERROR, "[Countly][setRemoteConfigCachePath] You can not set the cache path after SDK initialization.");
+    return;
+  }
+
+  configuration->remoteConfigCachePath = path;
+  log(LogLevel::INFO, "[Countly][setRemoteConfigCachePath] path = " + path);
+}
+
+bool Countly::_fetchRemoteConfig(const std::map<std::string, std::string> &data) {
   mutex->lock();
-  if (response.success) {
-    remote_config = response.data;
+  const std::string etag = remote_config_etag;
+  mutex->unlock();
+
+  HTTPResponse response = requestModule->sendHTTP("/o/sdk", requestBuilder->serializeData(data), etag);
+  if (response.status_code == COUNTLY_HTTP_NOT_MODIFIED) {
+    log(LogLevel::DEBUG, "[Countly][fetchRemoteConfig] Remote config has not changed.");
+    return true;
+  }
+
+  if (response.success && !response.parseBody()) {
+    log(LogLevel::WARNING, "[Countly][fetchRemoteConfig] Returned response from the server was not a valid JSON.");
+    return false;
+  }
+
+  if (!response.success) {
+    return false;
   }
+
+  // readers keep the snapshot they loaded, the new one is published whole
+  std::shared_ptr<const nlohmann::json> snapshot = std::make_shared<const nlohmann::json>(response.data.is_object() ? std::move(response.data) : nlohmann::json::object());
+  mutex->lock();
+  _publishRemoteConfig(snapshot);
+  remote_config_etag = response.etag;
   mutex->unlock();
+
+  if (remote_config_cache) {
+    remote_config_cache->save(*snapshot, response.etag, data.at("device_id"));
+  }
+  return true;
+}
+
+std::shared_future<bool> Countly::_submitRemoteConfigFetch(const std::map<std::string, std::string> &data, bool merge) {
+  // fetches of the same keys for the same device are the same, a caller asking again while one is in flight gets its result
+  std::string key = data.at("device_id");
+  for (const char *parameter : {"keys", "omit_keys"}) {
+    auto value = data.find(parameter);
+    if (value != data.end()) {
+      key += std::string("&") + parameter + "=" + value->second;
+    }
+  }
+
+  if (merge) {
+    return remote_config_executor->submit(key, [this, data]() { return _updateRemoteConfigWithSpecificValues(data); });
+  }
+  return remote_config_executor->submit(key, [this, data]() { return _fetchRemoteConfig(data); });
 }
 
-void Countly::updateRemoteConfig() {
+std::shared_future<bool> Countly::updateRemoteConfig() {
   mutex->lock();
   if (!session_params["app_key"].is_string() || !session_params["device_id"].is_string()) {
 
     log(LogLevel::ERROR, "Error updating remote config, app key or device id is missing");
     mutex->unlock();
-    return;
+    std::promise<bool> failed;
+    failed.set_value(false);
+    return failed.get_future().share();
   }
   std::map<std::string, std::string> data = {{"method", "fetch_remote_config"}, {"app_key", session_params["app_key"].get<std::string>()}, {"device_id", session_params["device_id"].get<std::string>()}};
 
   mutex->unlock();
 
-  // Fetch remote config asynchronously
-  std::thread _thread(&Countly::_fetchRemoteConfig, this, data);
-  _thread.detach();
+  return _submitRemoteConfigFetch(data, false);
+}
+
+void Countly::_publishRemoteConfig(std::shared_ptr<const nlohmann::json> snapshot) {
+  std::atomic_store(&remote_config, std::move(snapshot));
+  // raised after the store, so a thread that sees the new generation loads this snapshot or a newer one
+  remote_config_generation++;
 }
 
+const std::shared_ptr<const nlohmann::json> &Countly::_cachedRemoteConfig() const {
+  const unsigned long long generation = remote_config_generation.load();
+  if (cached_remote_config.owner != this || cached_remote_config.generation != generation) {
+    cached_remote_config.snapshot = std::atomic_load(&remote_config);
+    cached_remote_config.owner = this;
+    cached_remote_config.generation = generation;
+  }
+  return cached_remote_config.snapshot;
+}
+
+std::shared_ptr<const nlohmann::json> Countly::getRemoteConfigSnapshot() const { return std::atomic_load(&remote_config); }
+
 nlohmann::json Countly::getRemoteConfigValue(const std::string &key) {
-  mutex->lock();
-  nlohmann::json value = remote_config[key];
-  mutex->unlock();
-  return value;
+  const std::shared_ptr<const nlohmann::json> snapshot = getRemoteConfigSnapshot();
+  auto value = snapshot->find(key);
+  return value != snapshot->end() ? *value : nlohmann::json();
+}
+
+bool Countly::getRemoteConfigBool(const std::string &key, bool default_value) const {
+  const std::shared_ptr<const nlohmann::json> &snapshot = _cachedRemoteConfig();
+  auto value = snapshot->find(key);
+  return value != snapshot->end() && value->is_boolean() ? value->get<bool>() : default_value;
 }
 
-void Countly::_updateRemoteConfigWithSpecificValues(const std::map<std::string, std::string> &data) {
+long long Countly::getRemoteConfigInt(const std::string &key, long long default_value) const {
+  const std::shared_ptr<const nlohmann::json> &snapshot = _cachedRemoteConfig();
+  auto value = snapshot->find(key);
+  return value != snapshot->end() && value->is_number() ? value->get<long long>() : default_value;
+}
+
+double Countly::getRemoteConfigDouble(const std::string &key, double default_value) const {
+  const std::shared_ptr<const nlohmann::json> &snapshot = _cachedRemoteConfig();
+  auto value = snapshot->find(key);
+  return value != snapshot->end() && value->is_number() ? value->get<double>() : default_value;
+}
+
+std::string Countly::getRemoteConfigString(const std::string &key, const std::string &default_value) const {
+  const std::shared_ptr<const nlohmann::json> &snapshot = _cachedRemoteConfig();
+  auto value = snapshot->find(key);
+  return value != snapshot->end() && value->is_string() ? value->get_ref<const std::string &>() : default_value;
+}
+
+bool Countly::_updateRemoteConfigWithSpecificValues(const std::map<std::string, std::string> &data) {
   HTTPResponse response = requestModule->sendHTTP("/o/sdk", requestBuilder->serializeData(data));
-  mutex->lock();
-  if (response.success) {
-    for (auto it = response.data.begin(); it != response.data.end(); ++it) {
-      remote_config[it.key()] = it.value();
-    }
+  if (response.success && !response.parseBody()) {
+    log(LogLevel::WARNING, "[Countly][updateRemoteConfigFor] Returned response from the server was not a valid JSON.");
+    return false;
   }
+
+  if (!response.success || !response.data.is_object()) {
+    return false;
+  }
+
+  // writers copy and merge under the lock so that concurrent updates are not lost, readers do not take it
+  mutex->lock();
+  std::shared_ptr<nlohmann::json> merged = std::make_shared<nlohmann::json>(*std::atomic_load(&remote_config));
+  for (auto it = response.data.begin(); it != response.data.end(); ++it) {
+    (*merged)[it.key()] = it.value();
+  }
+  std::shared_ptr<const nlohmann::json> snapshot = std::move(merged);
+  _publishRemoteConfig(snapshot);
+  // the entity tag is kept: the server answers 304 to it only if nothing changed since, merged values included
+  const std::string etag = remote_config_etag;
   mutex->unlock();
+
+  if (remote_config_cache) {
+    remote_config_cache->save(*snapshot, etag, data.at("device_id"));
+  }
+  return true;
 }
 
-void Countly::updateRemoteConfigFor(std::string *keys, size_t key_count) {
+std::shared_future<bool> Countly::updateRemoteConfigFor(std::string *keys, size_t key_count) {
   mutex->lock();
   std::map<std::string, std::string> data = {{"method", "fetch_remote_config"}, {"app_key", session_params["app_key"].get<std::string>()}, {"device_id", session_params["device_id"].get<std::string>()}};
 
@@ -1277,12 +1805,10 @@ void Countly::updateRemoteConfigFor(std::string *keys, size_t key_count) {
   }
   mutex->unlock();
 
-  // Fetch remote config asynchronously
-  std::thread _thread(&Countly::_updateRemoteConfigWithSpecificValues, this, data);
-  _thread.detach();
+  return _submitRemoteConfigFetch(data, true);
 }
 
-void Countly::updateRemoteConfigExcept(std::string *keys, size_t key_count) {
+std::shared_future<bool> Countly::updateRemoteConfigExcept(std::string *keys, size_t key_count) {
   mutex->lock();
   std::map<std::string, std::string> data = {{"method", "fetch_remote_config"}, {"app_key", session_params["app_key"].get<std::string>()}, {"device_id", session_params["device_id"].get<std::string>()}};
 
@@ -1295,8 +1821,6 @@ void Countly::updateRemoteConfigExcept(std::string *keys, size_t key_count) {
   }
   mutex->unlock();
 
-  // Fetch remote config asynchronously
-  std::thread _thread(&Countly::_updateRemoteConfigWithSpecificValues, this, data);
-  _thread.detach();
+  return _submitRemoteConfigFetch(data, true);
 }
 } // namespace cly
@@ -2,21 +2,125 @@
 #include "countly/request_module.hpp"
 
 #include <algorithm>
-#include <deque>
-#include <iostream>
-#include <iterator>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 // define namespace
 namespace cly {
+/**
+ * Ring of the latest breadcrumbs in slots of a fixed size, allocated up front. Any thread adds to it without a lock, a new
+ * breadcrumb takes the slot of the oldest. The sequence number of a slot is odd while a breadcrumb is written into it and
+ * 2 * (number + 1) once breadcrumb 'number' is in it, so a snapshot tells a complete breadcrumb from one being replaced.
+ * A snapshot may read a slot while it is replaced, so the bytes are copied one by one as relaxed atomics and what was read is
+ * only kept if the sequence did not change meanwhile.
+ */
+class BreadcrumbRing {
+private:
+  struct Slot {
+    std::atomic<unsigned long long> sequence{0};
+    std::atomic<size_t> length{0};
+  };
+
+  std::vector<Slot> _slots;
+  std::unique_ptr<std::atomic<char>[]> _bytes;
+  size_t _slot_bytes = 0;
+  std::atomic<unsigned long long> _next{0};
+
+public:
+  BreadcrumbRing(size_t capacity, size_t max_bytes) : _slots(capacity) {
+    if (capacity > 0) {
+      _slot_bytes = std::max<size_t>(max_bytes / capacity, 1);
+      _bytes.reset(new std::atomic<char>[capacity * _slot_bytes]);
+    }
+  }
+
+  /**
+   * @return the most bytes a breadcrumb keeps, longer ones are cut
+   */
+  size_t slotBytes() const { return _slot_bytes; }
+
+  void add(const std::string &value) {
+    if (_slots.empty()) {
+      return;
+    }
+
+    const unsigned long long number = _next.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = _slots[number % _slots.size()];
+    const unsigned long long written = 2 * (number + 1);
+    unsigned long long sequence = slot.sequence.load(std::memory_order_relaxed);
+    while (true) {
+      // a newer breadcrumb is in the slot or is being written into it, this one is already overwritten
+      if (((sequence + 1) & ~1ULL) > written) {
+        return;
+      }
+      if (sequence & 1) {
+        // an older breadcrumb is still being written, only when the ring laps a slow writer
+        std::this_thread::yield();
+        sequence = slot.sequence.load(std::memory_order_relaxed);
+      } else if (slot.sequence.compare_exchange_weak(sequence, written - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t length = std::min(value.size(), _slot_bytes);
+    if (length < value.size()) {
+      // do not cut a UTF-8 character in two
+      while (length > 0 && (static_cast<unsigned char>(value[length]) & 0xC0) == 0x80) {
+        length--;
+      }
+    }
+    std::atomic<char> *bytes = _bytes.get() + (number % _slots.size()) * _slot_bytes;
+    for (size_t index = 0; index < length; index++) {
+      bytes[index].store(value[index], std::memory_order_relaxed);
+    }
+    slot.length.store(length, std::memory_order_relaxed);
+    slot.sequence.store(written, std::memory_order_release);
+  }
+
+  /**
+   * Append the breadcrumbs, oldest first, each followed by a new line, in one pass over the ring. Breadcrumbs being written
+   * while the snapshot is taken are left out.
+   */
+  void snapshot(std::string &logs) const {
+    const unsigned long long end = _next.load(std::memory_order_acquire);
+    const unsigned long long begin = end > _slots.size() ? end - _slots.size() : 0;
+    for (unsigned long long number = begin; number < end; number++) {
+      const Slot &slot = _slots[number % _slots.size()];
+      const unsigned long long written = 2 * (number + 1);
+      if (slot.sequence.load(std::memory_order_acquire) != written) {
+        continue;
+      }
+
+      const size_t start = logs.size();
+      const std::atomic<char> *bytes = _bytes.get() + (number % _slots.size()) * _slot_bytes;
+      logs.resize(start + std::min(slot.length.load(std::memory_order_relaxed), _slot_bytes));
+      for (size_t index = start; index < logs.size(); index++) {
+        logs[index] = bytes[index - start].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != written) {
+        // replaced while it was copied
+        logs.resize(start);
+        continue;
+      }
+      logs.push_back('\n');
+    }
+  }
+};
+
 // define CrashModuleImpl class
 class CrashModule::CrashModuleImpl {
 public:
-  std::deque<std::string> _breadCrumbs; // breadcrumbs deque
+  BreadcrumbRing _breadCrumbs; // breadcrumbs ring
+  std::atomic<bool> _is_cut_logged{false};
   std::shared_ptr<CountlyConfiguration> _configuration;
   std::shared_ptr<LoggerModule> _logger;
   std::shared_ptr<RequestModule> _requestModule;
   std::shared_ptr<std::mutex> _mutex;
-  CrashModuleImpl(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<RequestModule> requestModule, std::shared_ptr<std::mutex> mutex) : _configuration(config), _logger(logger), _requestModule(requestModule), _mutex(mutex) {}
+  CrashModuleImpl(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<RequestModule> requestModule, std::shared_ptr<std::mutex> mutex)
+      : _breadCrumbs(config->breadcrumbsThreshold, config->breadcrumbsMaxBytes), _configuration(config), _logger(logger), _requestModule(requestModule), _mutex(mutex) {}
 
   // destructor to reset logger
   ~CrashModuleImpl() { _logger.reset(); }
@@ -33,16 +137,17 @@ CrashModule::CrashModule(std::shared_ptr<CountlyConfiguration> config, std::shar
 
 // function to add breadcrumb
 void CrashModule::addBreadcrumb(const std::string &value) {
-  impl->_logger->log(LogLevel::INFO, "[CrashModule] addBreadcrumb : " + value);
+  impl->_logger->logLazy(LogLevel::INFO, [&value]() { return "[CrashModule] addBreadcrumb : " + value; });
 
-  impl->_mutex->lock();
-  // if breadcrumb threshold is reached, remove oldest breadcrumb
-  if (impl->_breadCrumbs.size() >= impl->_configuration->breadcrumbsThreshold) {
-    impl->_breadCrumbs.pop_front();
+  if (value.size() > impl->_breadCrumbs.slotBytes() && !impl->_is_cut_logged.exchange(true)) {
+    // logged once, so that an app adding long breadcrumbs does not flood the log
+    impl->_logger->logLazy(LogLevel::WARNING, [this]() {
+      return "[CrashModule] addBreadcrumb : Breadcrumbs longer than " + std::to_string(impl->_breadCrumbs.slotBytes()) + " bytes are cut, 'setMaxBreadcrumbBytes' gives them more room";
+    });
   }
-  // add new breadcrumb
-  impl->_breadCrumbs.push_back(value);
-  impl->_mutex->unlock();
+
+  // the oldest breadcrumb is replaced once the threshold is reached
+  impl->_breadCrumbs.add(value);
 }
 
 // function to record exception
@@ -70,11 +175,9 @@ void CrashModule::recordException(const std::string &title, const std::string &s
     impl->_logger->log(LogLevel::ERROR, "[CrashModule] recordException : The crash metric '_app_version' can't be empty");
   }
 
-  // lock mutex to avoid concurrent access
-  impl->_mutex->lock();
-  // convert breadcrumbs vector to a string and add to json object
-  std::ostringstream outstream;
-  std::copy(impl->_breadCrumbs.begin(), impl->_breadCrumbs.end(), std::ostream_iterator<std::string>(outstream, "\n"));
+  // join the breadcrumbs, without the lock
+  std::string logs;
+  impl->_breadCrumbs.snapshot(logs);
 
   // create json objects for crash metrics and segmentation
   nlohmann::json crash(crashMetrics);
@@ -83,12 +186,14 @@ void CrashModule::recordException(const std::string &title, const std::string &s
   // add relevant fields to the crash json object
   crash["_name"] = title;
   crash["_error"] = stackTrace;
-  crash["_logs"] = outstream.str();
+  crash["_logs"] = std::move(logs);
   crash["_custom"] = segments;
   crash["_nonfatal"] = !fatal;
 
   // create a map with the crash json object as value and "crash" as key, and add the map to the request queue
   std::map<std::string, std::string> data = {{"crash", crash.dump()}};
+  // lock mutex to avoid concurrent access
+  impl->_mutex->lock();
   impl->_requestModule->addRequestToQueue(data);
   // unlock mutex
   impl->_mutex->unlock();
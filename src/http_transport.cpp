@@ -0,0 +1,352 @@
+#include "countly/http_transport.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <sstream>
+#include <utility>
+
+#ifndef COUNTLY_USE_CUSTOM_HTTP
+#ifdef _WIN32
+#include "Windows.h"
+#include "WinHTTP.h"
+#undef ERROR
+#pragma comment(lib, "winhttp.lib")
+#else
+#include "curl/curl.h"
+#endif
+#endif
+
+#ifndef COUNTLY_USE_CUSTOM_HTTP
+// Most seconds curl waits for a connection and for a whole transfer, so that a server that does not answer can not hold up a
+// sender, and 'stop' waiting for it, for long. They match the timeouts set for WinHTTP.
+const long CURL_CONNECT_TIMEOUT_SECONDS = 10;
+const long CURL_TRANSFER_TIMEOUT_SECONDS = 30;
+#endif
+
+namespace cly {
+FunctionTransport::FunctionTransport(HTTPClientFunction function) : _function(function) {}
+
+TransportCapabilities FunctionTransport::getCapabilities() const { return TransportCapabilities(); }
+
+TransportHandle FunctionTransport::submit(const TransportRequest &request, TransportCompletion completion) {
+  completion(_function(request.use_post, request.path.toString(), request.data.toString()));
+  return 0;
+}
+
+// the function is already running by the time a request could be cancelled
+void FunctionTransport::cancel(TransportHandle /* handle */) {}
+
+void FunctionTransport::cancelAll() {}
+
+#ifndef COUNTLY_USE_CUSTOM_HTTP
+static size_t countly_curl_write_callback(void *data, size_t byte_size, size_t n_bytes, std::string *body) {
+  size_t data_size = byte_size * n_bytes;
+  body->append((const char *)data, data_size);
+  return data_size;
+}
+
+#ifndef _WIN32
+/**
+ * @return the trimmed value of the header line if it has the given lowercase name, otherwise an empty string
+ */
+static std::string countly_header_value(const char *data, size_t data_size, const char *name, size_t name_size) {
+  if (data_size <= name_size) {
+    return "";
+  }
+
+  for (size_t index = 0; index < name_size; index++) {
+    if (std::tolower(static_cast<unsigned char>(data[index])) != name[index]) {
+      return "";
+    }
+  }
+
+  std::string value(data + name_size, data_size - name_size);
+  value.erase(0, value.find_first_not_of(" \t"));
+  value.erase(value.find_last_not_of(" \t\r\n") + 1);
+  return value;
+}
+
+/**
+ * Reads the 'ETag' header and the 'Retry-After' header, given either in seconds or as an HTTP date, into the response.
+ */
+static size_t countly_curl_header_callback(char *data, size_t byte_size, size_t n_bytes, HTTPResponse *response) {
+  const size_t data_size = byte_size * n_bytes;
+  static const char etag_name[] = "etag:";
+  const std::string etag = countly_header_value(data, data_size, etag_name, sizeof(etag_name) - 1);
+  if (!etag.empty()) {
+    response->etag = etag;
+    return data_size;
+  }
+
+  static const char retry_after_name[] = "retry-after:";
+  const std::string value = countly_header_value(data, data_size, retry_after_name, sizeof(retry_after_name) - 1);
+  if (value.empty()) {
+    return data_size;
+  }
+
+  if (!value.empty() && std::all_of(value.begin(), value.end(), [](char character) { return std::isdigit(static_cast<unsigned char>(character)) != 0; })) {
+    response->retry_after = static_cast<unsigned int>(std::stoul(value));
+  } else {
+    const time_t retry_time = curl_getdate(value.c_str(), nullptr);
+    const time_t now = std::time(nullptr);
+    if (retry_time > now) {
+      response->retry_after = static_cast<unsigned int>(retry_time - now);
+    }
+  }
+
+  return data_size;
+}
+
+static int countly_curl_progress_callback(void *cancelled, curl_off_t /* download_total */, curl_off_t /* downloaded */, curl_off_t /* upload_total */, curl_off_t /* uploaded */) {
+  return static_cast<std::atomic<bool> *>(cancelled)->load() ? 1 : 0;
+}
+#endif
+
+HTTPTransport::HTTPTransport(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger) : _configuration(config), _logger(logger) {
+  _use_https = _configuration->serverUrl.find("https://") == 0;
+#ifndef _WIN32
+  curl_global_init(CURL_GLOBAL_ALL);
+#endif
+}
+
+HTTPTransport::~HTTPTransport() {
+#ifndef _WIN32
+  curl_global_cleanup();
+#endif
+  _configuration.reset();
+  _logger.reset();
+}
+
+TransportCapabilities HTTPTransport::getCapabilities() const {
+  TransportCapabilities capabilities;
+#ifndef _WIN32
+  capabilities.compression = true;
+#endif
+  return capabilities;
+}
+
+TransportHandle HTTPTransport::submit(const TransportRequest &request, TransportCompletion completion) {
+  std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+  TransportHandle handle;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_cancelled_all) {
+      // a request submitted after 'cancelAll', e.g. by a fetch that started while the SDK was stopping, is not sent at all
+      HTTPResponse response;
+      response.success = false;
+      completion(response);
+      return 0;
+    }
+
+    handle = _next_handle++;
+    _in_flight[handle] = cancelled;
+  }
+
+  HTTPResponse response = send(request, *cancelled);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _in_flight.erase(handle);
+  }
+
+  completion(response);
+  return handle;
+}
+
+void HTTPTransport::cancel(TransportHandle handle) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::map<TransportHandle, std::shared_ptr<std::atomic<bool>>>::iterator request = _in_flight.find(handle);
+  if (request != _in_flight.end()) {
+    request->second->store(true);
+  }
+}
+
+void HTTPTransport::cancelAll() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _cancelled_all = true;
+  for (std::pair<const TransportHandle, std::shared_ptr<std::atomic<bool>>> &request : _in_flight) {
+    request.second->store(true);
+  }
+}
+
+HTTPResponse HTTPTransport::send(const TransportRequest &request, std::atomic<bool> &cancelled) {
+  HTTPResponse response;
+  response.success = false;
+
+#ifdef _WIN32
+  HINTERNET hSession = nullptr;
+  HINTERNET hConnect = nullptr;
+  HINTERNET hRequest = nullptr;
+
+  hSession = WinHttpOpen(NULL, WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+  if (hSession) {
+    // Set way Shorter timeouts:
+    WinHttpSetTimeouts(hSession,
+                       10000,  // nResolveTimeout: 10sec (default 'infinite').
+                       10000,  // nConnectTimeout: 10sec (default 60sec).
+                       10000,  // nSendTimeout: 10sec (default 30sec).
+                       10000); // nReceiveTimeout: 10sec (default 30sec).
+
+    size_t scheme_offset = _use_https ? (sizeof("https://") - 1) : (sizeof("http://") - 1);
+    size_t buffer_size = MultiByteToWideChar(CP_ACP, 0, _configuration->serverUrl.c_str() + scheme_offset, -1, nullptr, 0);
+    wchar_t *wide_hostname = new wchar_t[buffer_size];
+    MultiByteToWideChar(CP_ACP, 0, _configuration->serverUrl.c_str() + scheme_offset, -1, wide_hostname, static_cast<int>(buffer_size));
+
+    hConnect = WinHttpConnect(hSession, wide_hostname, _configuration->port, 0);
+
+    delete[] wide_hostname;
+  }
+
+  if (hConnect) {
+    std::string request_path = request.path.toString();
+    if (!request.use_post) {
+      request_path += '?';
+      request_path.append(request.data.data(), request.data.size());
+    }
+
+    size_t buffer_size = MultiByteToWideChar(CP_ACP, 0, request_path.c_str(), -1, nullptr, 0);
+    wchar_t *wide_path = new wchar_t[buffer_size];
+    MultiByteToWideChar(CP_ACP, 0, request_path.c_str(), -1, wide_path, static_cast<int>(buffer_size));
+
+    hRequest = WinHttpOpenRequest(hConnect, request.use_post ? L"POST" : L"GET", wide_path, NULL, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, _use_https ? WINHTTP_FLAG_SECURE : 0);
+    delete[] wide_path;
+  }
+
+  // a blocking WinHTTP request can not be aborted, a cancelled one is not started
+  if (hRequest && !cancelled) {
+    std::wstring headers = request.use_post ? L"content-type:application/x-www-form-urlencoded" : L"";
+    if (!request.if_none_match.empty()) {
+      const std::string if_none_match = request.if_none_match.toString();
+      headers += (headers.empty() ? L"" : L"\r\n") + std::wstring(L"If-None-Match: ") + std::wstring(if_none_match.begin(), if_none_match.end());
+    }
+    bool ok = WinHttpSendRequest(hRequest, headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(), headers.empty() ? 0 : static_cast<DWORD>(-1L), request.use_post ? (LPVOID)request.data.data() : WINHTTP_NO_REQUEST_DATA, request.use_post ? request.data.size() : 0, request.use_post ? request.data.size() : 0, 0) != 0;
+    if (ok) {
+      ok = WinHttpReceiveResponse(hRequest, NULL);
+      if (ok) {
+        DWORD dwStatusCode = 0;
+        DWORD dwSize = static_cast<DWORD>(sizeof(dwStatusCode));
+        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX, &dwStatusCode, &dwSize, WINHTTP_NO_HEADER_INDEX);
+        response.success = (dwStatusCode >= 200 && dwStatusCode < 300);
+        response.status_code = static_cast<int>(dwStatusCode);
+
+        DWORD dwRetryAfter = 0;
+        dwSize = static_cast<DWORD>(sizeof(dwRetryAfter));
+        if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RETRY_AFTER | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX, &dwRetryAfter, &dwSize, WINHTTP_NO_HEADER_INDEX)) {
+          response.retry_after = static_cast<unsigned int>(dwRetryAfter);
+        }
+
+        wchar_t etag[256];
+        dwSize = static_cast<DWORD>(sizeof(etag));
+        if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_ETAG, WINHTTP_HEADER_NAME_BY_INDEX, etag, &dwSize, WINHTTP_NO_HEADER_INDEX)) {
+          // entity tags are ASCII
+          const std::wstring wide_etag(etag, dwSize / sizeof(wchar_t));
+          response.etag.assign(wide_etag.begin(), wide_etag.end());
+        }
+
+        if (response.success) {
+          DWORD n_bytes_available;
+          bool error_reading_body = false;
+          std::string body;
+          do {
+            n_bytes_available = 0;
+            if (!WinHttpQueryDataAvailable(hRequest, &n_bytes_available)) {
+              error_reading_body = true;
+              break;
+            }
+
+            if (n_bytes_available == 0) {
+              break;
+            }
+
+            char *body_part = new char[n_bytes_available + 1];
+            memset(body_part, 0, n_bytes_available + 1);
+            DWORD n_bytes_read = 0;
+
+            if (!WinHttpReadData(hRequest, body_part, n_bytes_available, &n_bytes_read)) {
+              error_reading_body = true;
+              delete[] body_part;
+              break;
+            }
+
+            body += body_part;
+            delete[] body_part;
+          } while (n_bytes_available > 0);
+
+          response.body = std::move(body);
+        }
+      }
+    }
+
+    WinHttpCloseHandle(hRequest);
+  }
+
+  if (hConnect) {
+    WinHttpCloseHandle(hConnect);
+  }
+
+  if (hSession) {
+    WinHttpCloseHandle(hSession);
+  }
+#else
+  CURL *curl;
+  CURLcode curl_code;
+  curl = curl_easy_init();
+  if (curl) {
+    std::ostringstream full_url_stream;
+    full_url_stream << _configuration->serverUrl << ':' << std::dec << _configuration->port;
+    full_url_stream.write(request.path.data(), request.path.size());
+
+    if (!request.use_post) {
+      full_url_stream << '?';
+      full_url_stream.write(request.data.data(), request.data.size());
+      curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
+    } else {
+      // curl sends the body straight from the given buffer, it does not copy it
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request.data.size()));
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.data.data());
+    }
+
+    std::string full_url = full_url_stream.str();
+    _logger->logLazy(LogLevel::DEBUG, [&full_url]() { return "[Countly][HTTPTransport] request: " + full_url; });
+    curl_easy_setopt(curl, CURLOPT_URL, full_url.c_str());
+
+    std::string body;
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, countly_curl_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, countly_curl_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, CURL_CONNECT_TIMEOUT_SECONDS);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, CURL_TRANSFER_TIMEOUT_SECONDS);
+
+    struct curl_slist *headers = nullptr;
+    if (!request.if_none_match.empty()) {
+      headers = curl_slist_append(headers, ("If-None-Match: " + request.if_none_match.toString()).c_str());
+      curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    }
+
+    // the transfer is aborted from the progress callback once the request is cancelled
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, countly_curl_progress_callback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &cancelled);
+
+    curl_code = curl_easy_perform(curl);
+    if (curl_code == CURLE_OK) {
+
+      long status_code;
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
+      response.success = (status_code >= 200 && status_code < 300);
+      response.status_code = static_cast<int>(status_code);
+
+      // the body is parsed only by the callers that need it
+      response.body = std::move(body);
+    }
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+  }
+#endif
+  _logger->logLazy(LogLevel::DEBUG, [&response]() { return "[Countly][HTTPTransport] response: " + response.body; });
+  return response;
+}
+#endif
+} // namespace cly
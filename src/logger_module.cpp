@@ -1,24 +1,259 @@
 #include "countly/logger_module.hpp"
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 namespace cly {
+/**
+ * Bounded ring of log records that any thread can add to without a lock and that a single writer thread takes from.
+ * Every slot carries a sequence number telling whose turn it is, a producer that finds the slot of its position still taken
+ * knows the ring is full.
+ */
+class LogRing {
+private:
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    LogLevel level = LogLevel::DEBUG;
+    std::string message;
+  };
+
+  std::vector<Slot> _slots;
+  size_t _mask = 0;
+  std::atomic<size_t> _enqueue_position{0};
+  // only the writer thread moves it
+  size_t _dequeue_position = 0;
+
+public:
+  LogRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+
+    _slots = std::vector<Slot>(size);
+    _mask = size - 1;
+    for (size_t index = 0; index < size; index++) {
+      _slots[index].sequence.store(index, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @return false if the ring is full
+   */
+  bool push(LogLevel level, std::string &&message) {
+    size_t position = _enqueue_position.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &_slots[position & _mask];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      if (sequence == position) {
+        if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (sequence < position) {
+        // the writer has not taken the record of the previous round yet
+        return false;
+      } else {
+        position = _enqueue_position.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->level = level;
+    slot->message = std::move(message);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @return false if the ring is empty
+   */
+  bool pop(LogLevel &level, std::string &message) {
+    Slot &slot = _slots[_dequeue_position & _mask];
+    if (slot.sequence.load(std::memory_order_acquire) != _dequeue_position + 1) {
+      return false;
+    }
+
+    level = slot.level;
+    message = std::move(slot.message);
+    slot.sequence.store(_dequeue_position + _slots.size(), std::memory_order_release);
+    _dequeue_position++;
+    return true;
+  }
+};
+
 class LoggerModule::LoggerModuleImpl {
 public:
   LoggerModuleImpl() {}
   LoggerFunction logger_function;
+  LogLevel min_level = LogLevel::DEBUG;
+
+  // messages are handed to the writer thread instead of the logger function while 'async' is set
+  std::unique_ptr<LogRing> ring;
+  std::atomic<bool> async{false};
+  // threads that may be adding to the ring, 'stopAsync' waits for them before the ring goes away
+  std::atomic<unsigned int> producers{0};
+  std::thread writer;
+  std::mutex writer_mutex;
+  std::condition_variable writer_condition;
+  std::condition_variable flushed_condition;
+  bool stopping = false;
+  // set while the writer waits for records, producers only take the lock to wake it up then
+  std::atomic<bool> writer_sleeping{false};
+  // records added to the ring and records the writer has passed to the logger function
+  std::atomic<unsigned long long> queued{0};
+  std::atomic<unsigned long long> written{0};
+  std::atomic<unsigned long long> dropped{0};
+
+  /**
+   * Hand the message to the writer thread if messages are printed asynchronously.
+   * @return false if the message is to be printed on the calling thread
+   */
+  template <typename Message> bool enqueueIfAsync(LogLevel level, const Message &message) {
+    producers++;
+    const bool is_async = async.load();
+    if (is_async) {
+      enqueue(level, std::string(message));
+    }
+    producers--;
+    return is_async;
+  }
+
+  void enqueue(LogLevel level, std::string &&message) {
+    if (!ring->push(level, std::move(message))) {
+      dropped++;
+      return;
+    }
+
+    // the writer sets 'writer_sleeping' before it checks 'queued' for the last time, so one of the two sees the other
+    queued++;
+    if (writer_sleeping.load()) {
+      std::lock_guard<std::mutex> lock(writer_mutex);
+      writer_condition.notify_one();
+    }
+  }
+
+  void writeQueued() {
+    LogLevel level;
+    std::string message;
+    while (ring->pop(level, message)) {
+      logger_function(level, message);
+      written++;
+    }
+  }
+
+  void drain() {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    while (true) {
+      lock.unlock();
+      writeQueued();
+      lock.lock();
+      flushed_condition.notify_all();
+      if (stopping) {
+        break;
+      }
+
+      // sleeps until a producer wakes it up, without waking up on its own while nothing is logged
+      writer_sleeping = true;
+      writer_condition.wait(lock, [this]() { return stopping || queued.load() > written.load(); });
+      writer_sleeping = false;
+    }
+
+    // records added before 'stopping' was set are written before the thread ends
+    lock.unlock();
+    writeQueued();
+    lock.lock();
+    flushed_condition.notify_all();
+  }
 };
 
 LoggerModule::LoggerModule() { impl = std::make_unique<LoggerModuleImpl>(); }
 
-LoggerModule::~LoggerModule() {}
+LoggerModule::~LoggerModule() { stopAsync(); }
 
-void LoggerModule::setLogger(LoggerFunction logger) { impl->logger_function = logger; }
+void LoggerModule::setLogger(LoggerFunction logger) {
+  if (impl->async.load()) {
+    // the writer thread calls the logger function, it is not replaced under it
+    log(LogLevel::WARNING, "[Countly][LoggerModule] setLogger: The logger can not be changed while messages are printed from a background thread.");
+    return;
+  }
+
+  impl->logger_function = logger;
+}
 
 const LoggerFunction LoggerModule::getLogger() { return impl->logger_function; }
 
 void LoggerModule::log(LogLevel level, const std::string &message) {
-  if (impl->logger_function != nullptr) {
+  if (!isEnabled(level)) {
+    return;
+  }
+
+  if (!impl->enqueueIfAsync(level, message)) {
+    impl->logger_function(level, message);
+  }
+}
+
+void LoggerModule::log(LogLevel level, const char *message) {
+  if (!isEnabled(level)) {
+    return;
+  }
+
+  if (!impl->enqueueIfAsync(level, message)) {
     impl->logger_function(level, message);
   }
 }
+
+void LoggerModule::setMinLevel(LogLevel level) { impl->min_level = level; }
+
+bool LoggerModule::isEnabled(LogLevel level) { return level >= impl->min_level && impl->logger_function != nullptr; }
+
+void LoggerModule::startAsync(size_t capacity) {
+  if (impl->async.load() || capacity == 0) {
+    return;
+  }
+
+  impl->stopping = false;
+  impl->ring.reset(new LogRing(capacity));
+  impl->writer = std::thread(&LoggerModuleImpl::drain, impl.get());
+  impl->async = true;
+}
+
+void LoggerModule::flush() {
+  if (!impl->async.load() || std::this_thread::get_id() == impl->writer.get_id()) {
+    return;
+  }
+
+  // the writer is awake while it has records to write, and tells after every pass
+  const unsigned long long target = impl->queued.load();
+  std::unique_lock<std::mutex> lock(impl->writer_mutex);
+  impl->flushed_condition.wait(lock, [this, target]() { return impl->written.load() >= target || impl->stopping; });
+}
+
+void LoggerModule::stopAsync() {
+  if (!impl->async.load()) {
+    return;
+  }
+
+  // messages are printed on the calling thread again, a thread that has just seen the ring in use finishes adding to it first
+  impl->async = false;
+  while (impl->producers.load() > 0) {
+    std::this_thread::yield();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(impl->writer_mutex);
+    impl->stopping = true;
+  }
+  impl->writer_condition.notify_one();
+  if (impl->writer.joinable()) {
+    impl->writer.join();
+  }
+
+  impl->ring.reset();
+}
+
+unsigned long long LoggerModule::getDroppedCount() { return impl->dropped.load(); }
 } // namespace cly
@@ -0,0 +1,53 @@
+#include "countly/metrics_registry.hpp"
+#include <algorithm>
+
+namespace cly {
+const long long METRICS_HISTOGRAM_BOUNDS[METRICS_HISTOGRAM_BUCKETS - 1] = {10, 100, 1000, 10000, 100000, 1000000, 10000000};
+
+void Histogram::record(std::chrono::microseconds duration) {
+  const unsigned long long value = static_cast<unsigned long long>(std::max(static_cast<long long>(duration.count()), 0LL));
+  const long long *bucket = std::lower_bound(METRICS_HISTOGRAM_BOUNDS, METRICS_HISTOGRAM_BOUNDS + METRICS_HISTOGRAM_BUCKETS - 1, static_cast<long long>(value));
+  _buckets[bucket - METRICS_HISTOGRAM_BOUNDS].fetch_add(1, std::memory_order_relaxed);
+  _count.fetch_add(1, std::memory_order_relaxed);
+  _sum.fetch_add(value, std::memory_order_relaxed);
+
+  unsigned long long max = _max.load(std::memory_order_relaxed);
+  while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+HistogramSnapshot Histogram::snapshot() const {
+  HistogramSnapshot result;
+  result.count = _count.load(std::memory_order_relaxed);
+  result.sum = _sum.load(std::memory_order_relaxed);
+  result.max = _max.load(std::memory_order_relaxed);
+  for (int index = 0; index < METRICS_HISTOGRAM_BUCKETS; index++) {
+    result.buckets[index] = _buckets[index].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+void MetricsRegistry::lock(std::mutex &mutex) {
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  mutex.lock();
+  lock_wait.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const {
+  MetricsSnapshot result;
+  result.events_recorded = events_recorded.load();
+  result.events_aggregated = events_aggregated.load();
+  result.events_dropped = events_dropped.load();
+  result.requests_queued = requests_queued.load();
+  result.requests_evicted = requests_evicted.load();
+  result.requests_rejected = requests_rejected.load();
+  result.http_attempts = http_attempts.load();
+  result.http_successes = http_successes.load();
+  result.http_failures = http_failures.load();
+  result.bytes_sent = bytes_sent.load();
+  result.request_latency = request_latency.snapshot();
+  result.storage_latency = storage_latency.snapshot();
+  result.lock_wait = lock_wait.snapshot();
+  return result;
+}
+} // namespace cly
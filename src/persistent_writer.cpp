@@ -0,0 +1,243 @@
+#include "countly/persistent_writer.hpp"
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#ifdef COUNTLY_USE_SQLITE
+#include "sqlite3.h"
+#endif
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+
+// How long a connection of the writer waits for another connection to finish writing.
+const int WRITER_BUSY_TIMEOUT_MILLISECONDS = 1000;
+
+// Delay before a failed batch is committed again, doubled after every further failure up to the max.
+const int WRITER_RETRY_MIN_DELAY_MILLISECONDS = 50;
+const int WRITER_RETRY_MAX_DELAY_MILLISECONDS = 5000;
+
+// Count of times a failed batch is tried again once the writer is asked to stop, its records are kept queued after that.
+const int WRITER_STOP_ATTEMPTS = 2;
+
+// Count of times a batch is tried before its records are dropped, so a database that keeps failing, e.g. because it is full or
+// read-only, does not keep 'flush' and with it every caller waiting forever.
+const int WRITER_MAX_ATTEMPTS = 5;
+
+namespace cly {
+PersistentWriter::PersistentWriter(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger) : _configuration(config), _logger(logger) {}
+
+PersistentWriter::~PersistentWriter() {
+  stop();
+  _configuration.reset();
+  _logger.reset();
+}
+
+void PersistentWriter::start() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_running) {
+    return;
+  }
+
+  _stop_requested = false;
+  try {
+    _thread.reset(new std::thread(&PersistentWriter::writeLoop, this));
+    _running = true;
+    _logger->log(LogLevel::DEBUG, "[Countly][PersistentWriter] started, batch size = [" + std::to_string(_configuration->persistentWriteBatchSize) + "], max latency = [" + std::to_string(_configuration->persistentWriteMaxLatency) + "] ms");
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "[Countly][PersistentWriter] Could not create thread, records will be written synchronously: " << e.what();
+    _logger->log(LogLevel::ERROR, log_message.str());
+  }
+}
+
+void PersistentWriter::stop() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (!_running) {
+    return;
+  }
+
+  // the writer commits everything that is left before it exits
+  _stop_requested = true;
+  _condition.notify_all();
+  lock.unlock();
+
+  if (_thread && _thread->joinable()) {
+    _thread->join();
+  }
+
+  lock.lock();
+  _thread.reset();
+  _running = false;
+  _committed_condition.notify_all();
+  _logger->log(LogLevel::DEBUG, "[Countly][PersistentWriter] stopped");
+}
+
+void PersistentWriter::write(const std::string &statement, const std::string &value) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (!_running) {
+    lock.unlock();
+    commit({{statement, value, std::chrono::steady_clock::now()}});
+    return;
+  }
+
+  _records.push_back({statement, value, std::chrono::steady_clock::now()});
+  _pending[statement]++;
+  _added_count++;
+  _condition.notify_all();
+}
+
+void PersistentWriter::flush() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (!_running) {
+    return;
+  }
+
+  unsigned long long target = _added_count;
+  _flush_requested = true;
+  _condition.notify_all();
+  _committed_condition.wait(lock, [this, target] { return _committed_count + _dropped_count >= target || !_running; });
+}
+
+unsigned long long PersistentWriter::droppedCount() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _dropped_count;
+}
+
+size_t PersistentWriter::pendingCount(const std::string &statement) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::map<std::string, size_t>::const_iterator it = _pending.find(statement);
+  return it == _pending.end() ? 0 : it->second;
+}
+
+void PersistentWriter::writeLoop() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  int failed_attempts = 0;
+  int stop_attempts = 0;
+  while (true) {
+    _condition.wait(lock, [this] { return _stop_requested || !_records.empty(); });
+    if (_records.empty()) {
+      break;
+    }
+
+    // give other records a chance to join the batch, but never keep the oldest one waiting longer than the max latency
+    const size_t batch_size = _configuration->persistentWriteBatchSize > 0 ? _configuration->persistentWriteBatchSize : 1;
+    const std::chrono::steady_clock::time_point deadline = _records.front().added + std::chrono::milliseconds(_configuration->persistentWriteMaxLatency);
+    _condition.wait_until(lock, deadline, [this, batch_size] { return _stop_requested || _flush_requested || _records.size() >= batch_size; });
+
+    std::vector<Record> batch;
+    batch.reserve(std::min(batch_size, _records.size()));
+    while (!_records.empty() && batch.size() < batch_size) {
+      batch.push_back(std::move(_records.front()));
+      _records.pop_front();
+    }
+
+    if (_records.empty()) {
+      _flush_requested = false;
+    }
+
+    lock.unlock();
+    const bool committed = commit(batch);
+    lock.lock();
+
+    if (!committed && failed_attempts + 1 >= WRITER_MAX_ATTEMPTS) {
+      _logger->log(LogLevel::ERROR, "[Countly][PersistentWriter] Could not commit [" + std::to_string(batch.size()) + "] records in [" + std::to_string(WRITER_MAX_ATTEMPTS) + "] attempts, they are dropped");
+      failed_attempts = 0;
+      for (const Record &record : batch) {
+        _pending[record.statement]--;
+      }
+      _dropped_count += batch.size();
+      _committed_condition.notify_all();
+      continue;
+    }
+
+    if (!committed) {
+      // the batch was rolled back, its records go back to the front of the queue in their order and are tried again later
+      _records.insert(_records.begin(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+      failed_attempts++;
+      if (_stop_requested && ++stop_attempts > WRITER_STOP_ATTEMPTS) {
+        _logger->log(LogLevel::ERROR, "[Countly][PersistentWriter] Could not commit [" + std::to_string(_records.size()) + "] records before stopping, they are kept until the writer is started again");
+        break;
+      }
+
+      const int delay = std::min(WRITER_RETRY_MIN_DELAY_MILLISECONDS << std::min(failed_attempts - 1, 16), WRITER_RETRY_MAX_DELAY_MILLISECONDS);
+      _logger->log(LogLevel::WARNING, "[Countly][PersistentWriter] Could not commit [" + std::to_string(batch.size()) + "] records, will try again in [" + std::to_string(delay) + "] ms");
+      _condition.wait_for(lock, std::chrono::milliseconds(delay), [this] { return _stop_requested; });
+      continue;
+    }
+
+    failed_attempts = 0;
+    for (const Record &record : batch) {
+      _pending[record.statement]--;
+    }
+    _committed_count += batch.size();
+    _committed_condition.notify_all();
+  }
+}
+
+bool PersistentWriter::commit(const std::vector<Record> &records) {
+  bool result = false;
+  try {
+#ifdef COUNTLY_USE_SQLITE
+    sqlite3 *database;
+    int return_value;
+    char *error_message = nullptr;
+
+    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    if (return_value == SQLITE_OK) {
+      sqlite3_busy_timeout(database, WRITER_BUSY_TIMEOUT_MILLISECONDS);
+      return_value = sqlite3_exec(database, "BEGIN IMMEDIATE;", nullptr, nullptr, &error_message);
+
+      // records of a batch usually share a statement, so it is prepared again only when it changes
+      sqlite3_stmt *statement = nullptr;
+      const std::string *prepared_statement = nullptr;
+      for (size_t index = 0; return_value == SQLITE_OK && index < records.size(); index++) {
+        const Record &record = records[index];
+        if (prepared_statement == nullptr || *prepared_statement != record.statement) {
+          sqlite3_finalize(statement);
+          return_value = sqlite3_prepare_v2(database, record.statement.c_str(), -1, &statement, nullptr);
+          prepared_statement = &record.statement;
+          if (return_value != SQLITE_OK) {
+            break;
+          }
+        }
+
+        sqlite3_bind_text(statement, 1, record.value.data(), static_cast<int>(record.value.size()), SQLITE_STATIC);
+        return_value = sqlite3_step(statement) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_reset(statement);
+      }
+      sqlite3_finalize(statement);
+
+      if (return_value == SQLITE_OK) {
+        return_value = sqlite3_exec(database, "COMMIT;", nullptr, nullptr, &error_message);
+      }
+
+      if (return_value != SQLITE_OK) {
+        if (error_message == nullptr) {
+          error_message = sqlite3_mprintf("%s", sqlite3_errmsg(database));
+        }
+        // nothing of a failed batch is kept, does nothing if the transaction was not started
+        sqlite3_exec(database, "ROLLBACK;", nullptr, nullptr, nullptr);
+      }
+
+      if (return_value == SQLITE_OK) {
+        result = true;
+        _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][PersistentWriter] Committed [" + std::to_string(records.size()) + "] records"; });
+      } else {
+        std::string error(error_message);
+        _logger->log(LogLevel::ERROR, "[Countly][PersistentWriter] commit error = " + error);
+        sqlite3_free(error_message);
+      }
+    } else {
+      _logger->log(LogLevel::ERROR, "[Countly][PersistentWriter] commit: Could not open database");
+    }
+    sqlite3_close(database);
+#endif
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "[Countly][PersistentWriter] commit, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+
+  return result;
+}
+} // namespace cly
@@ -0,0 +1,200 @@
+#include "countly/queue_snapshot.hpp"
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// First bytes of a snapshot file, also tells files written on a machine with a different byte order apart.
+const uint32_t SNAPSHOT_MAGIC = 0x51594c43;
+const uint32_t SNAPSHOT_VERSION = 1;
+
+namespace cly {
+// snapshots are only taken of the queues kept in memory
+#ifndef COUNTLY_USE_SQLITE
+/**
+ * Header of a snapshot file, followed by 'event_count' events and 'request_count' requests.
+ */
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t event_count;
+  uint32_t request_count;
+};
+
+static void writeRecord(std::ofstream &file, const char *data, size_t size) {
+  const uint32_t length = static_cast<uint32_t>(size);
+  file.write(reinterpret_cast<const char *>(&length), sizeof(length));
+  file.write(data, size);
+}
+
+/**
+ * Read 'count' records starting at 'position', which is moved past them.
+ * @return false if the content ends before the records do
+ */
+static bool readRecords(const char *content, size_t size, size_t &position, uint32_t count, const QueueSnapshot::RecordVisitor &visitor) {
+  for (uint32_t index = 0; index < count; index++) {
+    uint32_t length;
+    if (size - position < sizeof(length)) {
+      return false;
+    }
+    std::memcpy(&length, content + position, sizeof(length));
+    position += sizeof(length);
+
+    if (size - position < length) {
+      return false;
+    }
+    visitor(BufferView(content + position, length));
+    position += length;
+  }
+
+  return true;
+}
+
+QueueSnapshot::QueueSnapshot(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger) : _configuration(config), _logger(logger) {}
+
+QueueSnapshot::~QueueSnapshot() {
+  _configuration.reset();
+  _logger.reset();
+}
+
+bool QueueSnapshot::save(const std::deque<std::string> &events, StorageModuleBase &requests) {
+  try {
+    const std::string &path = _configuration->queueSnapshotPath;
+    const std::string temporary_path = path + ".tmp";
+
+    SnapshotHeader header;
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.event_count = static_cast<uint32_t>(events.size());
+    header.request_count = 0;
+
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      _logger->log(LogLevel::ERROR, "[Countly][QueueSnapshot] save: Could not open file [" + temporary_path + "]");
+      return false;
+    }
+
+    // the request count is only known after the requests are visited, the header is written again at the end
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const std::string &event : events) {
+      writeRecord(file, event.data(), event.size());
+    }
+
+    header.request_count = static_cast<uint32_t>(requests.RQForEach([&file](long long id, const BufferView &request) {
+      writeRecord(file, request.data(), request.size());
+      return true;
+    }));
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+    if (!file) {
+      _logger->log(LogLevel::ERROR, "[Countly][QueueSnapshot] save: Could not write file [" + temporary_path + "]");
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+
+    // a reader never sees a partly written snapshot
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+      _logger->log(LogLevel::ERROR, "[Countly][QueueSnapshot] save: Could not replace file [" + path + "]");
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+
+    _logger->log(LogLevel::DEBUG, "[Countly][QueueSnapshot] save: Saved [" + std::to_string(header.event_count) + "] events and [" + std::to_string(header.request_count) + "] requests");
+    return true;
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "[Countly][QueueSnapshot] save, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+
+  return false;
+}
+
+bool QueueSnapshot::load(const RecordVisitor &onEvent, const RecordVisitor &onRequest) {
+  try {
+    const std::string &path = _configuration->queueSnapshotPath;
+    const char *content = nullptr;
+    size_t size = 0;
+
+#ifndef _WIN32
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+      _logger->log(LogLevel::DEBUG, "[Countly][QueueSnapshot] load: There is no snapshot to restore");
+      return false;
+    }
+
+    struct stat file_status;
+    void *mapping = MAP_FAILED;
+    if (fstat(descriptor, &file_status) == 0 && file_status.st_size > 0) {
+      size = static_cast<size_t>(file_status.st_size);
+      mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    }
+    close(descriptor);
+
+    if (mapping == MAP_FAILED) {
+      _logger->log(LogLevel::ERROR, "[Countly][QueueSnapshot] load: Could not map file [" + path + "]");
+      return false;
+    }
+    content = static_cast<const char *>(mapping);
+#else
+    // without a memory mapping the file is read at once
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      _logger->log(LogLevel::DEBUG, "[Countly][QueueSnapshot] load: There is no snapshot to restore");
+      return false;
+    }
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    content = buffer.data();
+    size = buffer.size();
+#endif
+
+    bool result = false;
+    SnapshotHeader header;
+    if (size >= sizeof(header)) {
+      std::memcpy(&header, content, sizeof(header));
+    }
+
+    if (size < sizeof(header) || header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) {
+      _logger->log(LogLevel::WARNING, "[Countly][QueueSnapshot] load: File [" + path + "] is not a snapshot of this version");
+    } else {
+      size_t position = sizeof(header);
+      result = readRecords(content, size, position, header.event_count, onEvent) && readRecords(content, size, position, header.request_count, onRequest);
+      if (result) {
+        _logger->log(LogLevel::DEBUG, "[Countly][QueueSnapshot] load: Restored [" + std::to_string(header.event_count) + "] events and [" + std::to_string(header.request_count) + "] requests");
+      } else {
+        _logger->log(LogLevel::WARNING, "[Countly][QueueSnapshot] load: File [" + path + "] is truncated, restored only the complete records");
+      }
+    }
+
+#ifndef _WIN32
+    munmap(const_cast<char *>(content), size);
+#endif
+    std::remove(path.c_str());
+    return result;
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "[Countly][QueueSnapshot] load, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+
+  return false;
+}
+#endif
+} // namespace cly
@@ -0,0 +1,95 @@
+#include "countly/remote_config_cache.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+
+// Version of the cache file, a file of another version is ignored.
+const int REMOTE_CONFIG_CACHE_VERSION = 1;
+
+namespace cly {
+RemoteConfigCache::RemoteConfigCache(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger) : _configuration(config), _logger(logger) {}
+
+RemoteConfigCache::~RemoteConfigCache() {
+  _configuration.reset();
+  _logger.reset();
+}
+
+bool RemoteConfigCache::save(const nlohmann::json &values, const std::string &etag, const std::string &device_id) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  try {
+    const std::string &path = _configuration->remoteConfigCachePath;
+    const std::string temporary_path = path + ".tmp";
+    const nlohmann::json cache = {{"version", REMOTE_CONFIG_CACHE_VERSION}, {"device_id", device_id}, {"etag", etag}, {"values", values}};
+
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      _logger->log(LogLevel::ERROR, "[Countly][RemoteConfigCache] save: Could not open file [" + temporary_path + "]");
+      return false;
+    }
+
+    file << cache.dump();
+    file.close();
+    if (!file) {
+      _logger->log(LogLevel::ERROR, "[Countly][RemoteConfigCache] save: Could not write file [" + temporary_path + "]");
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+
+    // a reader never sees a partly written cache
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+      _logger->log(LogLevel::ERROR, "[Countly][RemoteConfigCache] save: Could not replace file [" + path + "]");
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+
+    _logger->log(LogLevel::DEBUG, "[Countly][RemoteConfigCache] save: Saved [" + std::to_string(values.size()) + "] values, etag = [" + etag + "]");
+    return true;
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "[Countly][RemoteConfigCache] save, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+
+  return false;
+}
+
+bool RemoteConfigCache::load(const std::string &device_id, nlohmann::json &values, std::string &etag) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  try {
+    const std::string &path = _configuration->remoteConfigCachePath;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      _logger->log(LogLevel::DEBUG, "[Countly][RemoteConfigCache] load: There is no cached remote config");
+      return false;
+    }
+
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const nlohmann::json cache = nlohmann::json::parse(content, nullptr, false);
+    if (!cache.is_object() || cache.value("version", 0) != REMOTE_CONFIG_CACHE_VERSION || !cache.contains("values") || !cache["values"].is_object() || !cache.contains("etag") || !cache["etag"].is_string()) {
+      _logger->log(LogLevel::WARNING, "[Countly][RemoteConfigCache] load: File [" + path + "] is not a remote config cache of this version");
+      return false;
+    }
+
+    if (cache.value("device_id", "") != device_id) {
+      _logger->log(LogLevel::DEBUG, "[Countly][RemoteConfigCache] load: The cached remote config is of another device");
+      return false;
+    }
+
+    values = cache["values"];
+    etag = cache["etag"].get<std::string>();
+    _logger->log(LogLevel::DEBUG, "[Countly][RemoteConfigCache] load: Loaded [" + std::to_string(values.size()) + "] values, etag = [" + etag + "]");
+    return true;
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "[Countly][RemoteConfigCache] load, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+
+  return false;
+}
+} // namespace cly
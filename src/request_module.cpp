@@ -1,37 +1,56 @@
 #include "countly/request_module.hpp"
+#include "countly/bandwidth_limiter.hpp"
+#include "countly/http_transport.hpp"
 #include "countly/request_builder.hpp"
+#include "countly/retry_policy.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <future>
 #include <iomanip>
+#include <iterator>
 
 #ifndef COUNTLY_USE_CUSTOM_SHA256
 #include "openssl/sha.h"
 #endif
 
-#ifndef COUNTLY_USE_CUSTOM_HTTP
-#ifdef _WIN32
-#include "Windows.h"
-#include "WinHTTP.h"
-#undef ERROR
-#pragma comment(lib, "winhttp.lib")
-#else
-#include "curl/curl.h"
-#endif
-#endif
-
 namespace cly {
+// Weight of the newest latency sample in the moving average, as a divisor: 1/8 like the smoothed round-trip time of TCP.
+const long long LATENCY_SMOOTHING_DIVISOR = 8;
+
+// Count of requests sent from every lane in a round of the scheduler, in the order of 'RequestClass'.
+const unsigned int REQUEST_CLASS_WEIGHTS[REQUEST_CLASS_COUNT] = {8, 4, 2, 1};
+
 class RequestModule::RequestModuleImpl {
 private:
 public:
   bool use_https = true;
   bool is_queue_being_processed = false;
+  // requests each lane may still send in the current round of the scheduler
+  unsigned int lane_credits[REQUEST_CLASS_COUNT] = {};
+  // moving average of the time a request takes in microseconds, 0 until a request was sent
+  std::atomic<long long> average_latency{0};
   std::shared_ptr<CountlyConfiguration> _configuration;
   std::shared_ptr<LoggerModule> _logger;
   std::shared_ptr<RequestBuilder> _requestBuilder;
   std::shared_ptr<StorageModuleBase> _storageModule;
+  RetryPolicy _retryPolicy;
+  BandwidthLimiter _bandwidthLimiter;
+  std::shared_ptr<MetricsRegistry> _metrics;
+  std::shared_ptr<Transport> _transport;
+  TransportCapabilities _transport_capabilities;
+  // requests handed to the transport that have not completed yet, bounded by its 'max_in_flight'
+  std::mutex in_flight_mutex;
+  std::condition_variable in_flight_condition;
+  unsigned int in_flight = 0;
+  // set by 'cancelRequests', later requests are not handed to the transport
+  bool requests_cancelled = false;
   RequestModuleImpl(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<RequestBuilder> requestBuilder, std::shared_ptr<StorageModuleBase> storageModule)
-      : _configuration(config), _logger(logger), _requestBuilder(requestBuilder), _storageModule(storageModule) {
+      : _configuration(config), _logger(logger), _requestBuilder(requestBuilder), _storageModule(storageModule), _retryPolicy(config, logger), _metrics(config->metricsRegistry) {
     if (_configuration->serverUrl.find("http://") == 0) {
       use_https = false;
     } else if (_configuration->serverUrl.find("https://") == 0) {
@@ -44,33 +63,173 @@ public:
     if (_configuration->port <= 0) {
       _configuration->port = use_https ? 443 : 80;
     }
+
+    // a transport of the integrator comes first, then an HTTP client function, then the built-in HTTP client
+    if (_configuration->transport) {
+      _transport = _configuration->transport;
+    } else if (_configuration->http_client_function) {
+      _transport = std::make_shared<FunctionTransport>(_configuration->http_client_function);
+    } else {
+#ifndef COUNTLY_USE_CUSTOM_HTTP
+      _transport = std::make_shared<HTTPTransport>(_configuration, _logger);
+#endif
+    }
+    if (_transport) {
+      _transport_capabilities = _transport->getCapabilities();
+    }
+
+    _bandwidthLimiter.setRate(_configuration->uploadBandwidthLimit, _configuration->uploadBurstSize);
+    if (_configuration->uploadsPaused) {
+      _bandwidthLimiter.pause();
+    }
+  }
+
+  ~RequestModuleImpl() {
+    // a sender waiting for bandwidth or for a response gives up
+    _bandwidthLimiter.close();
+    if (_transport) {
+      _transport->cancelAll();
+    }
+    _logger.reset();
+  }
+
+  /**
+   * Pick the request to send next. Lanes take turns in the order of their class, each sending up to its weight of requests in a
+   * round, so session and crash requests do not wait behind a backlog of events and the events are not starved by them either.
+   * @return front request of the picked lane, a request with id '-1' if every lane is empty
+   */
+  std::shared_ptr<DataEntry> nextRequest() {
+    // the lane is picked from the counts, so only the lane that sends is peeked
+    const std::array<long long, REQUEST_CLASS_COUNT> counts = _storageModule->RQCountByClass();
+    for (int round = 0; round < 2; round++) {
+      for (int lane = 0; lane < REQUEST_CLASS_COUNT; lane++) {
+        if (lane_credits[lane] == 0) {
+          continue;
+        }
+
+        if (counts[lane] > 0) {
+          lane_credits[lane]--;
+          return _storageModule->RQPeekFront(static_cast<RequestClass>(lane));
+        }
+
+        // an empty lane gives up the rest of its turn in this round
+        lane_credits[lane] = 0;
+      }
+
+      std::copy(std::begin(REQUEST_CLASS_WEIGHTS), std::end(REQUEST_CLASS_WEIGHTS), lane_credits);
+    }
+
+    return std::make_shared<DataEntry>(-1, "");
+  }
+
+  /**
+   * Add the time a request took to the moving average.
+   * Requests sent from other threads at the same time may overwrite each other's sample, which is fine for an average.
+   */
+  void recordLatency(std::chrono::microseconds latency) {
+    const long long sample = std::max(static_cast<long long>(latency.count()), 1LL);
+    const long long average = average_latency.load();
+    average_latency.store(average == 0 ? sample : average + (sample - average) / LATENCY_SMOOTHING_DIVISOR);
+  }
+
+  /**
+   * @return the most requests a cycle of processing the queue sends
+   */
+  unsigned int processingBatchSize() {
+    const unsigned int max_batch_size = _configuration->maxProcessingBatchSize;
+    if (_configuration->processingTimeBudget == 0) {
+      return max_batch_size;
+    }
+
+    const unsigned int min_batch_size = std::min(_configuration->minProcessingBatchSize, max_batch_size);
+    const long long average = average_latency.load();
+    if (average == 0) {
+      // nothing is known about the connection yet
+      return min_batch_size;
+    }
+
+    const long long fitting = static_cast<long long>(_configuration->processingTimeBudget) * 1000 / average;
+    return static_cast<unsigned int>(std::max(static_cast<long long>(min_batch_size), std::min(fitting, static_cast<long long>(max_batch_size))));
+  }
+
+  /**
+   * Hand a request to the transport and wait for its completion, which may come from another thread.
+   * Waits first while the transport has as many requests in flight as it takes.
+   */
+  HTTPResponse submitAndWait(const TransportRequest &request) {
+    const unsigned int max_in_flight = _transport_capabilities.max_in_flight;
+    {
+      std::unique_lock<std::mutex> lock(in_flight_mutex);
+      in_flight_condition.wait(lock, [this, max_in_flight]() { return requests_cancelled || max_in_flight == 0 || in_flight < max_in_flight; });
+      if (requests_cancelled) {
+        HTTPResponse response;
+        response.success = false;
+        return response;
+      }
+
+      if (max_in_flight > 0) {
+        in_flight++;
+      }
+    }
+
+    // the views of the request stay valid while this thread waits for the completion
+    std::shared_ptr<std::promise<HTTPResponse>> completed = std::make_shared<std::promise<HTTPResponse>>();
+    std::future<HTTPResponse> response = completed->get_future();
+    _transport->submit(request, [completed](const HTTPResponse &result) { completed->set_value(result); });
+    HTTPResponse result = response.get();
+
+    if (max_in_flight > 0) {
+      std::lock_guard<std::mutex> lock(in_flight_mutex);
+      in_flight--;
+      in_flight_condition.notify_one();
+    }
+    return result;
   }
 
-  ~RequestModuleImpl() { _logger.reset(); }
+  /**
+   * Make room in the queue by removing the oldest request of the least important lane that is not more important than the given class.
+   * @param requestClass: class of the request that needs the room
+   * @return false if every queued request is more important than the given class
+   */
+  bool evictRequest(RequestClass requestClass) {
+    for (int lane = REQUEST_CLASS_COUNT - 1; lane >= static_cast<int>(requestClass); lane--) {
+      if (_storageModule->RQCount(static_cast<RequestClass>(lane)) > 0) {
+        _storageModule->RQRemoveFront(static_cast<RequestClass>(lane));
+        _metrics->requests_evicted++;
+        return true;
+      }
+    }
+
+    return false;
+  }
 
-  std::string calculateChecksum(const std::string &salt, const std::string &data) {
-    std::string salted_data = data + salt;
+  std::string calculateChecksum(const std::string &salt, const BufferView &data) {
 #ifdef COUNTLY_USE_CUSTOM_SHA256
     if (_configuration->sha256_function == nullptr) {
       _logger->log(LogLevel::FATAL, "Missing SHA 256 function");
       return {};
     }
 
+    std::string salted_data = data.toString() + salt;
     return _configuration->sha256_function(salted_data);
 #else
     unsigned char checksum[SHA256_DIGEST_LENGTH];
     SHA256_CTX sha256;
 
+    // hash the data and the salt one after another instead of concatenating them
     SHA256_Init(&sha256);
-    SHA256_Update(&sha256, salted_data.c_str(), salted_data.size());
+    SHA256_Update(&sha256, data.data(), data.size());
+    SHA256_Update(&sha256, salt.c_str(), salt.size());
     SHA256_Final(checksum, &sha256);
 
-    std::ostringstream checksum_stream;
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string checksum_string(SHA256_DIGEST_LENGTH * 2, '0');
     for (size_t index = 0; index < SHA256_DIGEST_LENGTH; index++) {
-      checksum_stream << std::setfill('0') << std::setw(2) << std::hex << static_cast<int>(checksum[index]);
+      checksum_string[index * 2] = hex_digits[checksum[index] >> 4];
+      checksum_string[index * 2 + 1] = hex_digits[checksum[index] & 0x0F];
     }
 
-    return checksum_stream.str();
+    return checksum_string;
 #endif
   }
 };
@@ -78,34 +237,46 @@ public:
 RequestModule::RequestModule(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<RequestBuilder> requestBuilder, std::shared_ptr<StorageModuleBase> storageModule) {
   impl.reset(new RequestModuleImpl(config, logger, requestBuilder, storageModule));
 
-  impl->_logger->log(LogLevel::DEBUG, cly::utils::format_string("[RequestModule] Initialized"));
-
-#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
-  curl_global_init(CURL_GLOBAL_ALL);
-#endif
+  impl->_logger->log(LogLevel::DEBUG, "[RequestModule] Initialized");
 }
 
-RequestModule::~RequestModule() {
-  impl.reset();
-#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
-  curl_global_cleanup();
-#endif
-}
-
-static size_t countly_curl_write_callback(void *data, size_t byte_size, size_t n_bytes, std::string *body) {
-  size_t data_size = byte_size * n_bytes;
-  body->append((const char *)data, data_size);
-  return data_size;
-}
+RequestModule::~RequestModule() { impl.reset(); }
 
 void RequestModule::addRequestToQueue(const std::map<std::string, std::string> &data) {
+  const std::string request = impl->_requestBuilder->buildRequest(data);
+  const long long max_bytes = static_cast<long long>(impl->_configuration->requestQueueMaxBytes);
+  const long long request_bytes = static_cast<long long>(request.size());
+  if (max_bytes > 0 && request_bytes > max_bytes) {
+    // dropping older requests would not make room for it
+    impl->_logger->log(LogLevel::WARNING, cly::utils::format_string("[RequestModule] addRequestToQueue: Request of [%lld] bytes is larger than the Request Queue. Dropping the request.", request_bytes));
+    impl->_metrics->requests_rejected++;
+    return;
+  }
+
+  // the cheapest requests are dropped first, a request is only dropped for one of the same or a more important class
+  const RequestClass request_class = classifyRequest(request);
   if (impl->_configuration->requestQueueThreshold <= impl->_storageModule->RQCount()) {
-    impl->_logger->log(LogLevel::WARNING, cly::utils::format_string("[RequestModule] addRequestToQueue: Request Queue is full. Dropping the oldest request."));
-    impl->_storageModule->RQRemoveFront();
+    impl->_logger->log(LogLevel::WARNING, "[RequestModule] addRequestToQueue: Request Queue is full. Dropping the oldest of the least important requests.");
+    if (!impl->evictRequest(request_class)) {
+      impl->_logger->log(LogLevel::WARNING, "[RequestModule] addRequestToQueue: Request Queue is full of more important requests. Dropping the request.");
+      impl->_metrics->requests_rejected++;
+      return;
+    }
   }
 
-  const std::string request = impl->_requestBuilder->buildRequest(data);
+  while (max_bytes > 0 && impl->_storageModule->RQCount() > 0 && impl->_storageModule->RQBytes() + request_bytes > max_bytes) {
+    impl->_logger->log(LogLevel::WARNING, cly::utils::format_string("[RequestModule] addRequestToQueue: Request Queue is over [%lld] bytes. Dropping the oldest of the least important requests.", max_bytes));
+    if (!impl->evictRequest(request_class)) {
+      impl->_logger->log(LogLevel::WARNING, "[RequestModule] addRequestToQueue: Request Queue is full of more important requests. Dropping the request.");
+      impl->_metrics->requests_rejected++;
+      return;
+    }
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
   impl->_storageModule->RQInsertAtEnd(request);
+  impl->_metrics->storage_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+  impl->_metrics->requests_queued++;
 }
 
 void RequestModule::clearRequestQueue() { impl->_storageModule->RQClearAll(); }
@@ -123,38 +294,78 @@ void RequestModule::processQueue(std::shared_ptr<std::mutex> mutex) {
   mutex->unlock();
 
   // this counter is used to make sure that we don't get stuck in an infinite/long loop of request processing
-  int processedRequestsCounter = 0;
+  unsigned int processedRequestsCounter = 0;
+
+  mutex->lock();
+  const bool can_send = impl->_retryPolicy.canSend(RetryPolicy::Clock::now());
+  const unsigned int batch_size = impl->processingBatchSize();
+  const unsigned int time_budget = impl->_configuration->processingTimeBudget;
+  mutex->unlock();
+  const std::chrono::steady_clock::time_point cycle_start = std::chrono::steady_clock::now();
+  if (!can_send) {
+    impl->_logger->log(LogLevel::DEBUG, "[RequestModule] processQueue: Backing off after failed requests, will try again later.");
+  }
 
-  while (true) {
+  while (can_send) {
     mutex->lock();
-    impl->_logger->log(LogLevel::DEBUG, cly::utils::format_string("[RequestModule] processQueue: Processing the request queue."));
+    impl->_logger->log(LogLevel::DEBUG, "[RequestModule] processQueue: Processing the request queue.");
     if (impl->_storageModule->RQCount() == 0) {
-      impl->_logger->log(LogLevel::DEBUG, cly::utils::format_string("[RequestModule] processQueue: Queue is empty."));
+      impl->_logger->log(LogLevel::DEBUG, "[RequestModule] processQueue: Queue is empty.");
+
+      if (processedRequestsCounter > 0) {
+        // the queue has just been drained, give back a part of the space the sent requests used
+        impl->_storageModule->compact();
+      }
 
       // stop sending requests once the queue is empty
       mutex->unlock();
       break;
     }
 
-    std::shared_ptr<DataEntry> data = impl->_storageModule->RQPeekFront();
+    std::chrono::steady_clock::time_point storage_start = std::chrono::steady_clock::now();
+    std::shared_ptr<DataEntry> data = impl->nextRequest();
+    impl->_metrics->storage_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - storage_start));
+    if (data->getId() == -1) {
+      impl->_logger->log(LogLevel::ERROR, "[RequestModule] processQueue: Could not read the next request.");
+      mutex->unlock();
+      break;
+    }
     mutex->unlock();
-    HTTPResponse response = sendHTTP("/i", data->getData());
 
-    mutex->lock();
+    // waits for the bandwidth the request needs, outside of the lock
+    if (!impl->_bandwidthLimiter.acquire(data->getView().size())) {
+      impl->_logger->log(LogLevel::DEBUG, "[RequestModule] processQueue: Uploads are paused, will try again later.");
+      break;
+    }
+    HTTPResponse response = sendHTTP("/i", data->getView());
+
+    impl->_metrics->lock(*mutex);
     if (!response.success) {
-      impl->_logger->log(LogLevel::DEBUG, cly::utils::format_string("[RequestModule] processQueue: Failed to deliver to server, will try again later."));
-      // if the request was not a success, abort sending and try again in the future
+      impl->_logger->log(LogLevel::DEBUG, "[RequestModule] processQueue: Failed to deliver to server, will try again later.");
+      // if the request was not a success, abort sending and try again once the retry policy allows it
+      impl->_retryPolicy.onFailure(response, RetryPolicy::Clock::now());
       mutex->unlock();
       break;
     }
 
-    // we pop the front only if it is still the same request
+    impl->_retryPolicy.onSuccess();
+
+    // we pop the front of the lane only if it is still the same request
     // the queue might have changed while we were sending the request
+    storage_start = std::chrono::steady_clock::now();
     impl->_storageModule->RQRemoveFront(data);
+    impl->_metrics->storage_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - storage_start));
     processedRequestsCounter++;
 
-    if (processedRequestsCounter > impl->_configuration->maxProcessingBatchSize) {
-      impl->_logger->log(LogLevel::DEBUG, cly::utils::format_string("[RequestModule] processQueue: Batch limit has been reached, will do next batch later."));
+    if (processedRequestsCounter >= batch_size) {
+      impl->_logger->log(LogLevel::DEBUG, "[RequestModule] processQueue: Batch limit has been reached, will do next batch later.");
+      mutex->unlock();
+      break;
+    }
+
+    // the latency can grow within a cycle, the budget is not overrun by more than a request
+    if (time_budget > 0 && std::chrono::steady_clock::now() - cycle_start >= std::chrono::milliseconds(time_budget)) {
+      impl->_logger->log(LogLevel::DEBUG, "[RequestModule] processQueue: Time budget has been used up, will do next batch later.");
       mutex->unlock();
       break;
     }
@@ -168,178 +379,87 @@ void RequestModule::processQueue(std::shared_ptr<std::mutex> mutex) {
   mutex->unlock();
 }
 
-HTTPResponse RequestModule::sendHTTP(std::string path, std::string data) {
+HTTPResponse RequestModule::sendHTTP(std::string path, std::string data) { return sendHTTP(path, BufferView(data)); }
+
+HTTPResponse RequestModule::sendHTTP(const std::string &path, const BufferView &data, const std::string &if_none_match) {
+  impl->_metrics->http_attempts++;
+  impl->_metrics->bytes_sent += data.size();
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  HTTPResponse response = transmit(path, data, if_none_match);
+  const std::chrono::microseconds latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  impl->recordLatency(latency);
+  impl->_metrics->request_latency.record(latency);
+  if (response.success || response.status_code == COUNTLY_HTTP_NOT_MODIFIED) {
+    impl->_metrics->http_successes++;
+  } else {
+    impl->_metrics->http_failures++;
+  }
+  return response;
+}
+
+HTTPResponse RequestModule::transmit(const std::string &path, const BufferView &request_data, const std::string &if_none_match) {
+  BufferView data = request_data;
   bool use_post = impl->_configuration->forcePost || (data.size() > COUNTLY_POST_THRESHOLD);
-  impl->_logger->log(LogLevel::DEBUG, "[Countly][sendHTTP] data: " + data);
+  impl->_logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][sendHTTP] data: " + data.toString(); });
+
+  // only a salted request needs its own buffer, otherwise the caller's data is sent as it is
+  std::string signed_data;
   if (!impl->_configuration->salt.empty()) {
     std::string checksum = impl->calculateChecksum(impl->_configuration->salt, data);
+    signed_data.reserve(data.size() + checksum.size() + 13);
+    signed_data.append(data.data(), data.size());
     if (!data.empty()) {
-      data += '&';
+      signed_data += '&';
     }
 
-    data += "checksum256=" + checksum;
-    impl->_logger->log(LogLevel::DEBUG, "[Countly][sendHTTP] with checksum, data: " + data);
+    signed_data += "checksum256=" + checksum;
+    data = BufferView(signed_data);
+    impl->_logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][sendHTTP] with checksum, data: " + signed_data; });
   }
 
-  HTTPResponse response;
-  response.success = false;
-
-#ifdef COUNTLY_USE_CUSTOM_HTTP
-  if (!impl->_configuration->http_client_function) {
+  if (!impl->_transport) {
     impl->_logger->log(LogLevel::FATAL, "Missing HTTP client function");
+    HTTPResponse response;
+    response.success = false;
     return response;
   }
 
-  return impl->_configuration->http_client_function(use_post, path, data);
-#else
-  if (impl->_configuration->http_client_function) {
-    return impl->_configuration->http_client_function(use_post, path, data);
-  }
-#ifdef _WIN32
-  HINTERNET hSession = nullptr;
-  HINTERNET hConnect = nullptr;
-  HINTERNET hRequest = nullptr;
-
-  hSession = WinHttpOpen(NULL, WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-  if (hSession) {
-    // Set way Shorter timeouts:
-    WinHttpSetTimeouts(hSession,
-                       10000,  // nResolveTimeout: 10sec (default 'infinite').
-                       10000,  // nConnectTimeout: 10sec (default 60sec).
-                       10000,  // nSendTimeout: 10sec (default 30sec).
-                       10000); // nReceiveTimeout: 10sec (default 30sec).
-
-    size_t scheme_offset = impl->use_https ? (sizeof("https://") - 1) : (sizeof("http://") - 1);
-    size_t buffer_size = MultiByteToWideChar(CP_ACP, 0, impl->_configuration->serverUrl.c_str() + scheme_offset, -1, nullptr, 0);
-    wchar_t *wide_hostname = new wchar_t[buffer_size];
-    MultiByteToWideChar(CP_ACP, 0, impl->_configuration->serverUrl.c_str() + scheme_offset, -1, wide_hostname, static_cast<int>(buffer_size));
-
-    hConnect = WinHttpConnect(hSession, wide_hostname, impl->_configuration->port, 0);
-
-    delete[] wide_hostname;
-  }
-
-  if (hConnect) {
-    if (!use_post) {
-      path += '?';
-      path += data;
-    }
-
-    size_t buffer_size = MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, nullptr, 0);
-    wchar_t *wide_path = new wchar_t[buffer_size];
-    MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, wide_path, static_cast<int>(buffer_size));
-
-    hRequest = WinHttpOpenRequest(hConnect, use_post ? L"POST" : L"GET", wide_path, NULL, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, impl->use_https ? WINHTTP_FLAG_SECURE : 0);
-    delete[] wide_path;
-  }
-
-  if (hRequest) {
-    LPCWSTR headers = use_post ? L"content-type:application/x-www-form-urlencoded" : WINHTTP_NO_ADDITIONAL_HEADERS;
-    bool ok = WinHttpSendRequest(hRequest, headers, 0, use_post ? (LPVOID)data.data() : WINHTTP_NO_REQUEST_DATA, use_post ? data.size() : 0, use_post ? data.size() : 0, 0) != 0;
-    if (ok) {
-      ok = WinHttpReceiveResponse(hRequest, NULL);
-      if (ok) {
-        DWORD dwStatusCode = 0;
-        DWORD dwSize = static_cast<DWORD>(sizeof(dwStatusCode));
-        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX, &dwStatusCode, &dwSize, WINHTTP_NO_HEADER_INDEX);
-        response.success = (dwStatusCode >= 200 && dwStatusCode < 300);
-        if (response.success) {
-          DWORD n_bytes_available;
-          bool error_reading_body = false;
-          std::string body;
-          do {
-            n_bytes_available = 0;
-            if (!WinHttpQueryDataAvailable(hRequest, &n_bytes_available)) {
-              error_reading_body = true;
-              break;
-            }
-
-            if (n_bytes_available == 0) {
-              break;
-            }
-
-            char *body_part = new char[n_bytes_available + 1];
-            memset(body_part, 0, n_bytes_available + 1);
-            DWORD n_bytes_read = 0;
-
-            if (!WinHttpReadData(hRequest, body_part, n_bytes_available, &n_bytes_read)) {
-              error_reading_body = true;
-              delete[] body_part;
-              break;
-            }
-
-            body += body_part;
-            delete[] body_part;
-          } while (n_bytes_available > 0);
-
-          if (!body.empty()) {
-            const nlohmann::json &parseResult = nlohmann::json::parse(body, nullptr, false);
-            if (parseResult.is_discarded()) {
-              impl->_logger->log(LogLevel::WARNING, "[Countly][sendHTTP] Returned response from the server was not a valid JSON.");
-            } else {
-              response.data = parseResult;
-            }
-          }
-        }
-      }
-    }
-
-    WinHttpCloseHandle(hRequest);
-  }
+  TransportRequest request;
+  request.use_post = use_post;
+  request.path = BufferView(path);
+  request.data = data;
+  request.if_none_match = BufferView(if_none_match);
+  return impl->submitAndWait(request);
+}
 
-  if (hConnect) {
-    WinHttpCloseHandle(hConnect);
-  }
+std::string RequestModule::calculateChecksum(const std::string &salt, const BufferView &data) { return impl->calculateChecksum(salt, data); }
 
-  if (hSession) {
-    WinHttpCloseHandle(hSession);
-  }
-#else
-  CURL *curl;
-  CURLcode curl_code;
-  curl = curl_easy_init();
-  if (curl) {
-    std::ostringstream full_url_stream;
-    full_url_stream << impl->_configuration->serverUrl << ':' << std::dec << impl->_configuration->port << path;
-
-    if (!use_post) {
-      full_url_stream << '?' << data;
-      curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
-    } else {
-      curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
-    }
+long long RequestModule::RQSize() { return impl->_storageModule->RQCount(); }
 
-    impl->_logger->log(LogLevel::DEBUG, "[Countly][sendHTTP] request: " + full_url_stream.str());
+long long RequestModule::RQBytes() { return impl->_storageModule->RQBytes(); }
 
-    std::string full_url = full_url_stream.str();
-    curl_easy_setopt(curl, CURLOPT_URL, full_url.c_str());
+CircuitState RequestModule::getCircuitState() { return impl->_retryPolicy.getState(); }
 
-    std::string body;
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, countly_curl_write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+unsigned int RequestModule::getProcessingBatchSize() { return impl->processingBatchSize(); }
 
-    curl_code = curl_easy_perform(curl);
-    if (curl_code == CURLE_OK) {
+long long RequestModule::getAverageLatency() { return impl->average_latency.load(); }
 
-      long status_code;
-      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
-      response.success = (status_code >= 200 && status_code < 300);
+void RequestModule::setUploadBandwidthLimit(size_t bytesPerSecond, size_t burstBytes) { impl->_bandwidthLimiter.setRate(bytesPerSecond, burstBytes); }
 
-      if (!body.empty()) {
-        const nlohmann::json &parseResult = nlohmann::json::parse(body, nullptr, false);
-        if (parseResult.is_discarded()) {
-          impl->_logger->log(LogLevel::WARNING, "[Countly][sendHTTP] Returned response from the server was not a valid JSON.");
-        } else {
-          response.data = parseResult;
-        }
-      }
-    }
-    curl_easy_cleanup(curl);
+void RequestModule::cancelRequests() {
+  // a sender waiting for bandwidth, possibly for many seconds after a request bigger than the burst, gives up too
+  impl->_bandwidthLimiter.close();
+  {
+    std::lock_guard<std::mutex> lock(impl->in_flight_mutex);
+    impl->requests_cancelled = true;
+    impl->in_flight_condition.notify_all();
+  }
+  if (impl->_transport) {
+    impl->_transport->cancelAll();
   }
-#endif
-  impl->_logger->log(LogLevel::DEBUG, "[Countly][sendHTTP] response: " + response.data.dump());
-  return response;
-#endif
 }
-long long RequestModule::RQSize() { return impl->_storageModule->RQCount(); }
+
+void RequestModule::pauseUploads() { impl->_bandwidthLimiter.pause(); }
+
+void RequestModule::resumeUploads() { impl->_bandwidthLimiter.resume(); }
 } // namespace cly
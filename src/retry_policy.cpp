@@ -0,0 +1,75 @@
+#include "countly/retry_policy.hpp"
+#include <algorithm>
+
+// Status codes of responses whose 'Retry-After' header is honored.
+const int HTTP_TOO_MANY_REQUESTS = 429;
+const int HTTP_SERVICE_UNAVAILABLE = 503;
+
+namespace cly {
+RetryPolicy::RetryPolicy(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger) : _configuration(config), _logger(logger), _random(static_cast<unsigned int>(std::chrono::system_clock::now().time_since_epoch().count())) {}
+
+RetryPolicy::~RetryPolicy() {
+  _configuration.reset();
+  _logger.reset();
+}
+
+std::chrono::milliseconds RetryPolicy::nextDelay() {
+  const long long base_delay = _configuration->retryBaseDelay;
+  const long long max_delay = std::max(base_delay, static_cast<long long>(_configuration->retryMaxDelay));
+  const long long previous_delay = _delay.count() > 0 ? _delay.count() : base_delay;
+  const long long upper_bound = std::min(max_delay, previous_delay * 3);
+  if (upper_bound <= base_delay) {
+    return std::chrono::milliseconds(base_delay);
+  }
+
+  std::uniform_int_distribution<long long> distribution(base_delay, upper_bound);
+  return std::chrono::milliseconds(distribution(_random));
+}
+
+bool RetryPolicy::canSend(Clock::time_point now) {
+  if (_consecutive_failures == 0) {
+    return true;
+  }
+
+  if (now < _next_attempt) {
+    return false;
+  }
+
+  if (_state == CircuitState::OPEN) {
+    _logger->log(LogLevel::INFO, "[Countly][RetryPolicy] canSend: Circuit is half-open, probing the server");
+    _state = CircuitState::HALF_OPEN;
+  }
+
+  return true;
+}
+
+void RetryPolicy::onSuccess() {
+  if (_state != CircuitState::CLOSED) {
+    _logger->log(LogLevel::INFO, "[Countly][RetryPolicy] onSuccess: Server is reachable again, closing the circuit");
+  }
+
+  _state = CircuitState::CLOSED;
+  _consecutive_failures = 0;
+  _delay = std::chrono::milliseconds(0);
+}
+
+void RetryPolicy::onFailure(const HTTPResponse &response, Clock::time_point now) {
+  _consecutive_failures++;
+  _delay = nextDelay();
+
+  std::chrono::milliseconds wait = _delay;
+  if ((response.status_code == HTTP_TOO_MANY_REQUESTS || response.status_code == HTTP_SERVICE_UNAVAILABLE) && response.retry_after > 0) {
+    // the server knows best when it can take requests again
+    wait = std::max(wait, std::chrono::milliseconds(std::chrono::seconds(response.retry_after)));
+  }
+  _next_attempt = now + wait;
+
+  const unsigned int threshold = _configuration->circuitBreakerThreshold;
+  if (_state == CircuitState::HALF_OPEN || (_state == CircuitState::CLOSED && threshold > 0 && _consecutive_failures >= threshold)) {
+    _logger->log(LogLevel::WARNING, "[Countly][RetryPolicy] onFailure: Opening the circuit after [" + std::to_string(_consecutive_failures) + "] failed requests");
+    _state = CircuitState::OPEN;
+  }
+
+  _logger->log(LogLevel::DEBUG, "[Countly][RetryPolicy] onFailure: status = [" + std::to_string(response.status_code) + "], next attempt in [" + std::to_string(wait.count()) + "] ms");
+}
+} // namespace cly
@@ -10,11 +10,92 @@
 const char REQUESTS_TABLE_NAME[] = "Requests";
 const char REQUESTS_TABLE_REQUEST_ID[] = "RequestID";
 const char REQUESTS_TABLE_REQUEST_DATA[] = "RequestData";
+const char REQUESTS_TABLE_REQUEST_CLASS[] = "RequestClass";
+const char REQUESTS_CLASS_INDEX_NAME[] = "RequestsClassIndex";
+
+// The writer binds a single value, so requests of every class are queued with a statement of their own
+const std::string REQUESTS_INSERT_STATEMENT_PREFIX = std::string("INSERT INTO ") + REQUESTS_TABLE_NAME + " (" + REQUESTS_TABLE_REQUEST_DATA + ", " + REQUESTS_TABLE_REQUEST_CLASS + ") VALUES(?, ";
+const std::string REQUESTS_INSERT_STATEMENTS[] = {REQUESTS_INSERT_STATEMENT_PREFIX + "0);", REQUESTS_INSERT_STATEMENT_PREFIX + "1);", REQUESTS_INSERT_STATEMENT_PREFIX + "2);", REQUESTS_INSERT_STATEMENT_PREFIX + "3);"};
+
+// Upper bound of the database file that SQLite may memory-map when reading requests.
+const long long DATABASE_MMAP_SIZE = 64 * 1024 * 1024;
+
+// Value of 'PRAGMA auto_vacuum' for databases that free pages only on 'PRAGMA incremental_vacuum'.
+const int AUTO_VACUUM_INCREMENTAL = 2;
+
+// How long a connection waits for another connection to release its lock on the database.
+const int REQUESTS_BUSY_TIMEOUT_MILLISECONDS = 1000;
 
 namespace cly {
-StorageModuleDB::StorageModuleDB(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger) : StorageModuleBase(config, logger) {}
+/**
+ * @return SQL condition of the rows in the lane of the given class
+ */
+static std::string classCondition(RequestClass requestClass) { return std::string("WHERE ") + REQUESTS_TABLE_REQUEST_CLASS + " = " + std::to_string(static_cast<int>(requestClass)); }
+
+#ifdef COUNTLY_USE_SQLITE
+/**
+ * Open a connection to the database of the requests. Requests are read and removed on the sending thread while the writer and
+ * other threads insert them on connections of their own, so the connection waits for a lock instead of failing at once.
+ */
+static int openRequestDatabase(const std::string &path, sqlite3 **database) {
+  const int return_value = sqlite3_open(path.c_str(), database);
+  if (return_value == SQLITE_OK) {
+    sqlite3_busy_timeout(*database, REQUESTS_BUSY_TIMEOUT_MILLISECONDS);
+  }
+  return return_value;
+}
+
+/**
+ * Keeps the connection and the statement of a peeked row alive.
+ * The row content returned by SQLite stays valid until the statement is finalized, so entries can view it without copying.
+ * The database runs in WAL mode, so holding this read open does not block writers on other connections.
+ */
+class SqliteRowLease {
+public:
+  sqlite3 *database = nullptr;
+  sqlite3_stmt *statement = nullptr;
+
+  ~SqliteRowLease() {
+    sqlite3_finalize(statement);
+    sqlite3_close(database);
+  }
+};
+
+/**
+ * Sums up the size of the request data in the rows that match the given condition.
+ * @param condition: SQL condition of the rows, e.g. "WHERE RequestID = 1", empty to include every row
+ * @return size of the request data in bytes
+ */
+static long long selectRequestBytes(sqlite3 *database, const std::string &condition) {
+  long long bytes = 0;
+  sqlite3_stmt *statement = nullptr;
+  std::ostringstream sql_statement_stream;
+  sql_statement_stream << "SELECT IFNULL(SUM(LENGTH(CAST(" << REQUESTS_TABLE_REQUEST_DATA << " AS BLOB))), 0) FROM " << REQUESTS_TABLE_NAME << ' ' << condition << ';';
+  if (sqlite3_prepare_v2(database, sql_statement_stream.str().c_str(), -1, &statement, nullptr) == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW) {
+    bytes = sqlite3_column_int64(statement, 0);
+  }
+  sqlite3_finalize(statement);
+  return bytes;
+}
+
+/**
+ * @param pragma: name of a pragma that returns a single number, e.g. "page_size"
+ * @return the value of the pragma, 0 if it could not be read
+ */
+static long long selectPragma(sqlite3 *database, const std::string &pragma) {
+  long long value = 0;
+  sqlite3_stmt *statement = nullptr;
+  if (sqlite3_prepare_v2(database, ("PRAGMA " + pragma + ";").c_str(), -1, &statement, nullptr) == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW) {
+    value = sqlite3_column_int64(statement, 0);
+  }
+  sqlite3_finalize(statement);
+  return value;
+}
+#endif
 
-StorageModuleDB::~StorageModuleDB() {}
+StorageModuleDB::StorageModuleDB(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<PersistentWriter> writer) : StorageModuleBase(config, logger), _writer(writer) {}
+
+StorageModuleDB::~StorageModuleDB() { _writer.reset(); }
 
 void StorageModuleDB::init() {
   try {
@@ -29,10 +110,29 @@ void StorageModuleDB::init() {
 #endif
 
     // Create schema for the requests table
-    _is_initialized = createSchema(REQUESTS_TABLE_NAME, REQUESTS_TABLE_REQUEST_ID, REQUESTS_TABLE_REQUEST_DATA);
+    _is_initialized = createSchema(REQUESTS_TABLE_NAME, REQUESTS_TABLE_REQUEST_ID, REQUESTS_TABLE_REQUEST_DATA) && createClassColumn();
 
     if (_is_initialized) {
-      vacuumDatabase();
+#ifdef COUNTLY_USE_SQLITE
+      // the size is only read here, every later change updates it directly
+      sqlite3 *database;
+      int auto_vacuum = AUTO_VACUUM_INCREMENTAL;
+      long long free_bytes = 0;
+      if (openRequestDatabase(_configuration->databasePath, &database) == SQLITE_OK) {
+        _request_bytes = selectRequestBytes(database, "");
+        auto_vacuum = static_cast<int>(selectPragma(database, "auto_vacuum"));
+        free_bytes = selectPragma(database, "freelist_count") * selectPragma(database, "page_size");
+      }
+      sqlite3_close(database);
+
+      if (auto_vacuum != AUTO_VACUUM_INCREMENTAL) {
+        // databases created by older versions are rewritten once to switch the vacuum mode
+        vacuumDatabase();
+      } else if (_configuration->startupVacuumThreshold > 0 && free_bytes >= static_cast<long long>(_configuration->startupVacuumThreshold)) {
+        _logger->log(LogLevel::INFO, "[Countly][StorageModuleDB] init: Compacting [" + std::to_string(free_bytes) + "] free bytes");
+        incrementalVacuum(0);
+      }
+#endif
     }
   } catch (const std::system_error &e) {
     std::ostringstream log_message;
@@ -49,9 +149,10 @@ void StorageModuleDB::vacuumDatabase() {
     sqlite3 *database;
     int return_value;
     char *error_message;
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
     if (return_value == SQLITE_OK) {
-      return_value = sqlite3_exec(database, "VACUUM", nullptr, nullptr, &error_message);
+      // the vacuum mode of an existing database only changes when it is rewritten
+      return_value = sqlite3_exec(database, "PRAGMA auto_vacuum=INCREMENTAL; VACUUM;", nullptr, nullptr, &error_message);
       if (return_value != SQLITE_OK) {
         _logger->log(LogLevel::ERROR, error_message);
         sqlite3_free(error_message);
@@ -71,6 +172,141 @@ void StorageModuleDB::vacuumDatabase() {
   }
 }
 
+void StorageModuleDB::incrementalVacuum(unsigned int pages) {
+  try {
+#ifdef COUNTLY_USE_SQLITE
+    sqlite3 *database;
+    int return_value;
+    char *error_message;
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
+    if (return_value == SQLITE_OK) {
+      if (selectPragma(database, "freelist_count") > 0) {
+        std::string sql_statement = "PRAGMA incremental_vacuum(" + std::to_string(pages) + ");";
+        return_value = sqlite3_exec(database, sql_statement.c_str(), nullptr, nullptr, &error_message);
+        if (return_value != SQLITE_OK) {
+          // another connection is writing, the pages are reclaimed next time
+          _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] incrementalVacuum error = " + std::string(error_message));
+          sqlite3_free(error_message);
+        } else {
+          _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] incrementalVacuum: Reclaimed up to [" + std::to_string(pages) + "] pages");
+        }
+      }
+    } else {
+      const char *error = sqlite3_errmsg(database);
+      _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB][incrementalVacuum] " + std::string(error));
+    }
+    sqlite3_close(database);
+#endif
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "incrementalVacuum, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+}
+
+void StorageModuleDB::compact() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] compact: Module is not initialized");
+    return;
+  }
+
+  if (_configuration->incrementalVacuumPages > 0) {
+    incrementalVacuum(_configuration->incrementalVacuumPages);
+  }
+}
+
+bool StorageModuleDB::createClassColumn() {
+  try {
+    bool result = false;
+#ifdef COUNTLY_USE_SQLITE
+    sqlite3 *database;
+    sqlite3_stmt *statement = nullptr;
+    int return_value;
+    char *error_message = nullptr;
+
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
+    if (return_value == SQLITE_OK) {
+      std::ostringstream select_statement_stream;
+      select_statement_stream << "SELECT " << REQUESTS_TABLE_REQUEST_CLASS << " FROM " << REQUESTS_TABLE_NAME << " LIMIT 0;";
+      const bool has_column = sqlite3_prepare_v2(database, select_statement_stream.str().c_str(), -1, &statement, nullptr) == SQLITE_OK;
+      sqlite3_finalize(statement);
+      statement = nullptr;
+
+      result = true;
+      if (!has_column) {
+        // tables created by older versions get the column, their requests are classified once in a single transaction
+        _logger->log(LogLevel::INFO, "[Countly][StorageModuleDB] createClassColumn: Adding request classes to the requests table");
+        std::ostringstream alter_statement_stream;
+        alter_statement_stream << "BEGIN IMMEDIATE; ALTER TABLE " << REQUESTS_TABLE_NAME << " ADD COLUMN " << REQUESTS_TABLE_REQUEST_CLASS << " INTEGER NOT NULL DEFAULT " << static_cast<int>(RequestClass::EVENTS) << ';';
+        return_value = sqlite3_exec(database, alter_statement_stream.str().c_str(), nullptr, nullptr, &error_message);
+
+        std::vector<std::pair<long long, RequestClass>> classes;
+        if (return_value == SQLITE_OK) {
+          std::ostringstream rows_statement_stream;
+          rows_statement_stream << "SELECT " << REQUESTS_TABLE_REQUEST_ID << ", " << REQUESTS_TABLE_REQUEST_DATA << " FROM " << REQUESTS_TABLE_NAME << ';';
+          return_value = sqlite3_prepare_v2(database, rows_statement_stream.str().c_str(), -1, &statement, nullptr);
+          while (return_value == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW) {
+            const RequestClass requestClass = classifyRequest(BufferView(reinterpret_cast<const char *>(sqlite3_column_text(statement, 1)), static_cast<size_t>(sqlite3_column_bytes(statement, 1))));
+            if (requestClass != RequestClass::EVENTS) {
+              classes.push_back(std::make_pair(sqlite3_column_int64(statement, 0), requestClass));
+            }
+          }
+          sqlite3_finalize(statement);
+          statement = nullptr;
+        }
+
+        if (return_value == SQLITE_OK) {
+          std::ostringstream update_statement_stream;
+          update_statement_stream << "UPDATE " << REQUESTS_TABLE_NAME << " SET " << REQUESTS_TABLE_REQUEST_CLASS << " = ? WHERE " << REQUESTS_TABLE_REQUEST_ID << " = ?;";
+          return_value = sqlite3_prepare_v2(database, update_statement_stream.str().c_str(), -1, &statement, nullptr);
+          for (size_t index = 0; return_value == SQLITE_OK && index < classes.size(); index++) {
+            sqlite3_bind_int(statement, 1, static_cast<int>(classes[index].second));
+            sqlite3_bind_int64(statement, 2, classes[index].first);
+            return_value = sqlite3_step(statement) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+            sqlite3_reset(statement);
+          }
+          sqlite3_finalize(statement);
+        }
+
+        if (return_value == SQLITE_OK) {
+          return_value = sqlite3_exec(database, "COMMIT;", nullptr, nullptr, &error_message);
+        } else if (error_message == nullptr) {
+          error_message = sqlite3_mprintf("%s", sqlite3_errmsg(database));
+        }
+
+        if (return_value != SQLITE_OK) {
+          _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] createClassColumn error = " + std::string(error_message));
+          sqlite3_free(error_message);
+          sqlite3_exec(database, "ROLLBACK;", nullptr, nullptr, nullptr);
+          result = false;
+        }
+      }
+
+      // lanes are read in id order, so a lane front is found without scanning the other lanes
+      std::ostringstream index_statement_stream;
+      index_statement_stream << "CREATE INDEX IF NOT EXISTS " << REQUESTS_CLASS_INDEX_NAME << " ON " << REQUESTS_TABLE_NAME << " (" << REQUESTS_TABLE_REQUEST_CLASS << ", " << REQUESTS_TABLE_REQUEST_ID << ");";
+      if (result && sqlite3_exec(database, index_statement_stream.str().c_str(), nullptr, nullptr, &error_message) != SQLITE_OK) {
+        _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] createClassColumn error = " + std::string(error_message));
+        sqlite3_free(error_message);
+        result = false;
+      }
+    } else {
+      const char *error = sqlite3_errmsg(database);
+      _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB][createClassColumn] " + std::string(error));
+    }
+    sqlite3_close(database);
+#endif
+
+    return result;
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "createClassColumn, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+
+  return false;
+}
+
 bool StorageModuleDB::createSchema(const char tableName[], const char keyColumnName[], const char dataColumnName[]) {
   try {
     _logger->log(LogLevel::INFO, "[StorageModuleDB][createSchema]");
@@ -82,8 +318,11 @@ bool StorageModuleDB::createSchema(const char tableName[], const char keyColumnN
     char *error_message;
 
     // Open the SQLite database
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
     if (return_value == SQLITE_OK) {
+      // Only applies to a new database, it has to be set before the first table is created
+      sqlite3_exec(database, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
+
       // Create the table if it does not exist
       std::ostringstream sql_statement_stream;
       sql_statement_stream << "CREATE TABLE IF NOT EXISTS " << tableName << " (" << keyColumnName << " INTEGER PRIMARY KEY, " << dataColumnName << " TEXT)";
@@ -98,6 +337,12 @@ bool StorageModuleDB::createSchema(const char tableName[], const char keyColumnN
       } else {
         result = true;
       }
+
+      // WAL lets a peeked request stay readable while other connections keep writing
+      if (result && sqlite3_exec(database, "PRAGMA journal_mode=WAL;", nullptr, nullptr, &error_message) != SQLITE_OK) {
+        _logger->log(LogLevel::WARNING, "[Countly][StorageModuleDB][createSchema] Could not enable WAL journal mode: " + std::string(error_message));
+        sqlite3_free(error_message);
+      }
     } else {
       const char *error = sqlite3_errmsg(database);
       _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB][createSchema] " + std::string(error));
@@ -117,28 +362,49 @@ bool StorageModuleDB::createSchema(const char tableName[], const char keyColumnN
 
 // Remove the first item from the SQLite database's requests table
 void StorageModuleDB::RQRemoveFront() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQRemoveFront: Module is not initialized");
+    return;
+  }
+
+  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQRemoveFront");
+  removeFront("");
+}
+
+void StorageModuleDB::RQRemoveFront(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQRemoveFront(class): Module is not initialized");
+    return;
+  }
+
+  _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQRemoveFront class = [" + std::to_string(static_cast<int>(requestClass)) + "]"; });
+  removeFront(classCondition(requestClass));
+}
+
+void StorageModuleDB::removeFront(const std::string &condition) {
   try {
-    if (!_is_initialized) {
-      _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQRemoveFront: Module is not initialized");
-      return;
+    // the front request may still be waiting in the writer
+    if (_writer) {
+      _writer->flush();
     }
 
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQRemoveFront");
-
 #ifdef COUNTLY_USE_SQLITE
     // Declare SQLite database, return value and error message variables
     sqlite3 *database;
     int return_value;
     char *error_message;
     // Open the SQLite database
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
     if (return_value == SQLITE_OK) { // Check if the SQL statement execution is successful
       // Remove the first entry in the requests table
       std::ostringstream sql_statement_stream;
-      sql_statement_stream << "DELETE FROM " << REQUESTS_TABLE_NAME << " WHERE " << REQUESTS_TABLE_REQUEST_ID << " = ( SELECT MIN(" << REQUESTS_TABLE_REQUEST_ID << ") FROM " << REQUESTS_TABLE_NAME << " );";
-      _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQRemoveFront SQL = " + sql_statement_stream.str());
+      std::ostringstream condition_stream;
+      condition_stream << "WHERE " << REQUESTS_TABLE_REQUEST_ID << " = ( SELECT MIN(" << REQUESTS_TABLE_REQUEST_ID << ") FROM " << REQUESTS_TABLE_NAME << ' ' << condition << " )";
+      sql_statement_stream << "DELETE FROM " << REQUESTS_TABLE_NAME << ' ' << condition_stream.str() << ';';
+      _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQRemoveFront SQL = " + sql_statement_stream.str(); });
 
       std::string sql_statement = sql_statement_stream.str();
+      const long long removed_bytes = selectRequestBytes(database, condition_stream.str());
 
       // Execute the SQL statement
       return_value = sqlite3_exec(database, sql_statement.c_str(), nullptr, nullptr, &error_message);
@@ -146,6 +412,8 @@ void StorageModuleDB::RQRemoveFront() {
         std::string error(error_message);
         _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQRemoveFront error = " + error);
         sqlite3_free(error_message);
+      } else {
+        _request_bytes -= removed_bytes;
       }
     }
     // Close the database
@@ -153,7 +421,7 @@ void StorageModuleDB::RQRemoveFront() {
 #endif
   } catch (const std::system_error &e) {
     std::ostringstream log_message;
-    log_message << "RQRemoveFront, error: " << e.what();
+    log_message << "removeFront, error: " << e.what();
     _logger->log(LogLevel::FATAL, log_message.str());
   }
 }
@@ -172,21 +440,29 @@ void StorageModuleDB::RQRemoveFront(std::shared_ptr<DataEntry> request) {
     }
 
     // Log the request ID being removed
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQRemoveFront RequestID = " + request->getId());
+    _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQRemoveFront RequestID = " + std::to_string(request->getId()); });
+
+    if (_writer) {
+      _writer->flush();
+    }
 
 #ifdef COUNTLY_USE_SQLITE
     sqlite3 *database;
     int return_value;
     char *error_message;
     // Open the SQLite database
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
     if (return_value == SQLITE_OK) {
       // Build SQL statement to remove request from database
       std::ostringstream sql_statement_stream;
-      sql_statement_stream << "DELETE FROM " << REQUESTS_TABLE_NAME << " WHERE " << REQUESTS_TABLE_REQUEST_ID << " = " << request->getId() << ';';
-      _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQRemoveFront SQL = " + sql_statement_stream.str());
+      std::ostringstream condition_stream;
+      condition_stream << "WHERE " << REQUESTS_TABLE_REQUEST_ID << " = " << request->getId();
+      sql_statement_stream << "DELETE FROM " << REQUESTS_TABLE_NAME << ' ' << condition_stream.str() << ';';
+      _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQRemoveFront SQL = " + sql_statement_stream.str(); });
 
       std::string sql_statement = sql_statement_stream.str();
+      // the stored row is measured, the entry may not be in the table at all
+      const long long removed_bytes = selectRequestBytes(database, condition_stream.str());
 
       // Execute the SQL statement
       return_value = sqlite3_exec(database, sql_statement.c_str(), nullptr, nullptr, &error_message);
@@ -194,6 +470,8 @@ void StorageModuleDB::RQRemoveFront(std::shared_ptr<DataEntry> request) {
         std::string error(error_message);
         _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQRemoveFront error = " + error);
         sqlite3_free(error_message);
+      } else {
+        _request_bytes -= removed_bytes;
       }
     }
     // Close the database connection
@@ -206,14 +484,107 @@ void StorageModuleDB::RQRemoveFront(std::shared_ptr<DataEntry> request) {
   }
 }
 
+long long StorageModuleDB::RQBytes() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQBytes: Module is not initialized");
+    return -1;
+  }
+
+  return _request_bytes;
+}
+
 long long StorageModuleDB::RQCount() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQCount: Module is not initialized");
+    return -1;
+  }
+
+  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQCount");
+  long long requestCount = countRequests("");
+
+  // Requests waiting in the writer are part of the queue as well
+  if (_writer) {
+    for (const std::string &statement : REQUESTS_INSERT_STATEMENTS) {
+      requestCount += static_cast<long long>(_writer->pendingCount(statement));
+    }
+  }
+
+  // Log the number of requests in the requests table
+  _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQCount requests count = " + std::to_string(requestCount); });
+  // Return the number of requests
+  return requestCount;
+}
+
+long long StorageModuleDB::RQCount(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQCount(class): Module is not initialized");
+    return -1;
+  }
+
+  long long requestCount = countRequests(classCondition(requestClass));
+  if (_writer) {
+    requestCount += static_cast<long long>(_writer->pendingCount(REQUESTS_INSERT_STATEMENTS[static_cast<int>(requestClass)]));
+  }
+
+  return requestCount;
+}
+
+std::array<long long, REQUEST_CLASS_COUNT> StorageModuleDB::RQCountByClass() {
+  std::array<long long, REQUEST_CLASS_COUNT> counts;
+  counts.fill(-1);
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQCountByClass: Module is not initialized");
+    return counts;
+  }
+
+  counts.fill(0);
   try {
-    if (!_is_initialized) {
-      _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQCount: Module is not initialized");
-      return -1;
+#ifdef COUNTLY_USE_SQLITE
+    sqlite3 *database;
+    int return_value, row_count, column_count;
+    char **table;
+    char *error_message;
+
+    // a single query counts every lane, instead of one per lane
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
+    if (return_value == SQLITE_OK) {
+      std::ostringstream sql_statement_stream;
+      sql_statement_stream << "SELECT " << REQUESTS_TABLE_REQUEST_CLASS << ", COUNT(*) FROM " << REQUESTS_TABLE_NAME << " GROUP BY " << REQUESTS_TABLE_REQUEST_CLASS << ";";
+      return_value = sqlite3_get_table(database, sql_statement_stream.str().c_str(), &table, &row_count, &column_count, &error_message);
+      if (return_value == SQLITE_OK) {
+        // the first row of the table holds the column names
+        for (int row = 1; row <= row_count; row++) {
+          const int lane = atoi(table[row * column_count]);
+          if (lane >= 0 && lane < REQUEST_CLASS_COUNT) {
+            counts[lane] = atoll(table[row * column_count + 1]);
+          }
+        }
+      } else {
+        std::string error(error_message);
+        _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQCountByClass error = " + error);
+        sqlite3_free(error_message);
+      }
+      sqlite3_free_table(table);
+    }
+    sqlite3_close(database);
+#endif
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "RQCountByClass, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+
+  if (_writer) {
+    for (int lane = 0; lane < REQUEST_CLASS_COUNT; lane++) {
+      counts[lane] += static_cast<long long>(_writer->pendingCount(REQUESTS_INSERT_STATEMENTS[lane]));
     }
+  }
+
+  return counts;
+}
 
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQCount");
+long long StorageModuleDB::countRequests(const std::string &condition) {
+  try {
     long long requestCount = 0;
 
 #ifdef COUNTLY_USE_SQLITE
@@ -224,11 +595,11 @@ long long StorageModuleDB::RQCount() {
     char *error_message;
 
     // Open the SQLite database
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
     if (return_value == SQLITE_OK) {
       // Define the SQL statement for counting the number of rows in the requests table
       std::ostringstream sql_statement_stream;
-      sql_statement_stream << "SELECT COUNT(*) FROM " << REQUESTS_TABLE_NAME << ";";
+      sql_statement_stream << "SELECT COUNT(*) FROM " << REQUESTS_TABLE_NAME << ' ' << condition << ";";
       // Execute the SQL statement
       return_value = sqlite3_get_table(database, sql_statement_stream.str().c_str(), &table, &row_count, &column_count, &error_message);
       if (return_value == SQLITE_OK) {
@@ -247,72 +618,71 @@ long long StorageModuleDB::RQCount() {
     sqlite3_close(database);
 #endif
 
-    // Log the number of requests in the requests table
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQCount requests count = " + std::to_string(requestCount));
-    // Return the number of requests
     return requestCount;
   } catch (const std::system_error &e) {
     std::ostringstream log_message;
-    log_message << "RQCount, error: " << e.what();
+    log_message << "countRequests, error: " << e.what();
     _logger->log(LogLevel::FATAL, log_message.str());
   }
+
+  return 0;
 }
 
-std::vector<std::shared_ptr<DataEntry>> StorageModuleDB::RQPeekAll() {
+size_t StorageModuleDB::RQForEach(const RequestVisitor &visitor, size_t limit) {
+  size_t visited = 0;
   try {
     if (!_is_initialized) {
-      _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQPeekAll: Module is not initialized");
-      return {}; // Return an empty vector if the module is not initialized
+      _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQForEach: Module is not initialized");
+      return 0;
     }
 
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQPeekAll");
+    _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQForEach limit = " + std::to_string(limit); });
 
-    std::vector<std::shared_ptr<DataEntry>> v; // Initialize a vector to store the data entries
+    if (_writer) {
+      _writer->flush();
+    }
 
 #ifdef COUNTLY_USE_SQLITE
     sqlite3 *database;
-    int return_value, row_count, column_count;
-    char **table;
-    char *error_message;
+    sqlite3_stmt *statement = nullptr;
+    int return_value;
 
-    // Open the database
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
     if (return_value == SQLITE_OK) {
-      std::ostringstream sql_statement_stream;
-      sql_statement_stream << "SELECT * FROM " << REQUESTS_TABLE_NAME << " ORDER BY " << REQUESTS_TABLE_REQUEST_ID << " ASC;";
-      std::string sql_statement = sql_statement_stream.str();
+      sqlite3_exec(database, ("PRAGMA mmap_size=" + std::to_string(DATABASE_MMAP_SIZE) + ";").c_str(), nullptr, nullptr, nullptr);
 
-      // Execute the query to get all the data entries
-      return_value = sqlite3_get_table(database, sql_statement.c_str(), &table, &row_count, &column_count, &error_message);
-      // Check if there are any data entries in the table
-      bool no_request = (row_count == 0);
-      // If the query was successful and there are data entries in the table
-      if (return_value == SQLITE_OK && !no_request) {
-
-        // Loop through all the data entries and add them to the vector
-        for (int event_index = 1; event_index < row_count + 1; event_index++) {
-          std::string requestId = table[event_index * column_count];
-          std::string request = table[(event_index * column_count) + 1];
-          v.push_back(std::make_shared<DataEntry>(std::stoll(requestId), request));
+      std::ostringstream sql_statement_stream;
+      sql_statement_stream << "SELECT " << REQUESTS_TABLE_REQUEST_ID << ", " << REQUESTS_TABLE_REQUEST_DATA << " FROM " << REQUESTS_TABLE_NAME << " ORDER BY " << REQUESTS_TABLE_REQUEST_ID << " ASC";
+      if (limit > 0) {
+        sql_statement_stream << " LIMIT " << limit;
+      }
+      sql_statement_stream << ';';
+
+      return_value = sqlite3_prepare_v2(database, sql_statement_stream.str().c_str(), -1, &statement, nullptr);
+      // rows are read one at a time, the content is viewed where SQLite keeps it
+      while (return_value == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW) {
+        const char *request = reinterpret_cast<const char *>(sqlite3_column_text(statement, 1));
+        const int request_size = sqlite3_column_bytes(statement, 1);
+        visited++;
+        if (!visitor(sqlite3_column_int64(statement, 0), BufferView(request, static_cast<size_t>(request_size)))) {
+          break;
         }
+      }
 
-      } else if (return_value != SQLITE_OK) { // If there was an error executing the query
-        std::string error(error_message);
-        _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQPeekAll error =" + error);
-        sqlite3_free(error_message);
+      if (return_value != SQLITE_OK) {
+        _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQForEach error = " + std::string(sqlite3_errmsg(database)));
       }
-      // Free the result table
-      sqlite3_free_table(table);
+      sqlite3_finalize(statement);
     }
-    // Close the database
     sqlite3_close(database);
 #endif
-    return v; // Return the vector containing all the data entries
   } catch (const std::system_error &e) {
     std::ostringstream log_message;
-    log_message << "RQPeekAll, error: " << e.what();
+    log_message << "RQForEach, error: " << e.what();
     _logger->log(LogLevel::FATAL, log_message.str());
   }
+
+  return visited;
 }
 
 void StorageModuleDB::RQInsertAtEnd(const std::string &request) {
@@ -323,13 +693,21 @@ void StorageModuleDB::RQInsertAtEnd(const std::string &request) {
     }
 
     // Logs the request being inserted
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQInsertAtEnd request = " + request);
+    _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQInsertAtEnd request = " + request; });
 
     if (request == "") {
       _logger->log(LogLevel::WARNING, "[Countly][StorageModuleMemory] RQInsertAtEnd request is empty");
       return; // Checks if the request is empty, logs a warning and returns if it is
     }
 
+    const RequestClass requestClass = classifyRequest(request);
+    if (_writer) {
+      // Committed later together with other requests and events by the writer thread
+      _writer->write(REQUESTS_INSERT_STATEMENTS[static_cast<int>(requestClass)], request);
+      _request_bytes += request.size();
+      return;
+    }
+
 #ifdef COUNTLY_USE_SQLITE
     // Initializes variables for working with SQLite
     sqlite3 *database;
@@ -337,11 +715,11 @@ void StorageModuleDB::RQInsertAtEnd(const std::string &request) {
     char *error_message;
 
     // Opens the database connection
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
     if (return_value == SQLITE_OK) {
       // Prepares the SQL statement for inserting the request into the database
       std::ostringstream sql_statement_stream;
-      sql_statement_stream << "INSERT INTO " << REQUESTS_TABLE_NAME << " (" << REQUESTS_TABLE_REQUEST_DATA << ") VALUES('" << request << "');";
+      sql_statement_stream << "INSERT INTO " << REQUESTS_TABLE_NAME << " (" << REQUESTS_TABLE_REQUEST_DATA << ", " << REQUESTS_TABLE_REQUEST_CLASS << ") VALUES('" << request << "', " << static_cast<int>(requestClass) << ");";
       std::string sql_statement = sql_statement_stream.str();
 
       return_value = sqlite3_exec(database, sql_statement.c_str(), nullptr, nullptr, &error_message);
@@ -349,6 +727,8 @@ void StorageModuleDB::RQInsertAtEnd(const std::string &request) {
         std::string error(error_message);
         _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQInsertAtEnd error =" + error);
         sqlite3_free(error_message);
+      } else {
+        _request_bytes += request.size();
       }
     }
     // Closes the database connection
@@ -361,6 +741,102 @@ void StorageModuleDB::RQInsertAtEnd(const std::string &request) {
   }
 }
 
+void StorageModuleDB::RQInsertAtFront(const std::vector<std::string> &requests) {
+  try {
+    if (!_is_initialized) {
+      _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQInsertAtFront: Module is not initialized");
+      return;
+    }
+
+    _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQInsertAtFront count = " + std::to_string(requests.size()); });
+    if (requests.empty()) {
+      return;
+    }
+
+    if (_writer) {
+      _writer->flush();
+    }
+
+#ifdef COUNTLY_USE_SQLITE
+    sqlite3 *database;
+    int return_value;
+    char *error_message;
+
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
+    if (return_value == SQLITE_OK) {
+      // All rows are written in one transaction, so either every request is moved or none of them
+      sqlite3_exec(database, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+
+      // Rows are ordered by id, so the new requests take the ids right below the current front
+      const long long count = static_cast<long long>(requests.size());
+      long long first_id = 1;
+      long long min_id = 0;
+      long long max_id = 0;
+      bool is_empty = true;
+      sqlite3_stmt *statement = nullptr;
+      std::ostringstream select_statement_stream;
+      select_statement_stream << "SELECT MIN(" << REQUESTS_TABLE_REQUEST_ID << "), MAX(" << REQUESTS_TABLE_REQUEST_ID << ") FROM " << REQUESTS_TABLE_NAME << ";";
+      if (sqlite3_prepare_v2(database, select_statement_stream.str().c_str(), -1, &statement, nullptr) == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW && sqlite3_column_type(statement, 0) != SQLITE_NULL) {
+        min_id = sqlite3_column_int64(statement, 0);
+        max_id = sqlite3_column_int64(statement, 1);
+        is_empty = false;
+      }
+      sqlite3_finalize(statement);
+      statement = nullptr;
+
+      return_value = SQLITE_OK;
+      if (!is_empty && min_id - count >= 1) {
+        first_id = min_id - count;
+      } else if (!is_empty) {
+        // ids have to stay positive, '-1' means there is no request, so the queued rows make room by moving up. They are first
+        // moved below the current ids and then above the new ones, so no step of an update meets an id that is still taken.
+        const long long span = max_id - min_id + 1;
+        std::ostringstream update_statement_stream;
+        update_statement_stream << "UPDATE " << REQUESTS_TABLE_NAME << " SET " << REQUESTS_TABLE_REQUEST_ID << " = " << REQUESTS_TABLE_REQUEST_ID << " - " << span << ";";
+        update_statement_stream << "UPDATE " << REQUESTS_TABLE_NAME << " SET " << REQUESTS_TABLE_REQUEST_ID << " = " << REQUESTS_TABLE_REQUEST_ID << " + " << (span - min_id + count + 1) << ";";
+        return_value = sqlite3_exec(database, update_statement_stream.str().c_str(), nullptr, nullptr, nullptr);
+      }
+
+      std::ostringstream insert_statement_stream;
+      insert_statement_stream << "INSERT INTO " << REQUESTS_TABLE_NAME << " (" << REQUESTS_TABLE_REQUEST_ID << ", " << REQUESTS_TABLE_REQUEST_DATA << ", " << REQUESTS_TABLE_REQUEST_CLASS << ") VALUES(?, ?, ?);";
+      if (return_value == SQLITE_OK) {
+        return_value = sqlite3_prepare_v2(database, insert_statement_stream.str().c_str(), -1, &statement, nullptr);
+      }
+      for (size_t index = 0; return_value == SQLITE_OK && index < requests.size(); index++) {
+        sqlite3_bind_int64(statement, 1, first_id + static_cast<long long>(index));
+        sqlite3_bind_text(statement, 2, requests[index].data(), static_cast<int>(requests[index].size()), SQLITE_STATIC);
+        sqlite3_bind_int(statement, 3, static_cast<int>(classifyRequest(requests[index])));
+        return_value = sqlite3_step(statement) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_reset(statement);
+      }
+      sqlite3_finalize(statement);
+
+      if (return_value == SQLITE_OK) {
+        return_value = sqlite3_exec(database, "COMMIT;", nullptr, nullptr, &error_message);
+      } else {
+        error_message = sqlite3_mprintf("%s", sqlite3_errmsg(database));
+        sqlite3_exec(database, "ROLLBACK;", nullptr, nullptr, nullptr);
+      }
+
+      if (return_value != SQLITE_OK) {
+        std::string error(error_message);
+        _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQInsertAtFront error =" + error);
+        sqlite3_free(error_message);
+      } else {
+        for (const std::string &request : requests) {
+          _request_bytes += request.size();
+        }
+      }
+    }
+    sqlite3_close(database);
+#endif
+  } catch (const std::system_error &e) {
+    std::ostringstream log_message;
+    log_message << "RQInsertAtFront, error: " << e.what();
+    _logger->log(LogLevel::FATAL, log_message.str());
+  }
+}
+
 void StorageModuleDB::RQClearAll() {
   try {
     if (!_is_initialized) {
@@ -369,12 +845,16 @@ void StorageModuleDB::RQClearAll() {
     }
     _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQClearAll");
 
+    if (_writer) {
+      _writer->flush();
+    }
+
 #ifdef COUNTLY_USE_SQLITE
     sqlite3 *database;
     int return_value;
     char *error_message;
     // Open database connection
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    return_value = openRequestDatabase(_configuration->databasePath, &database);
     if (return_value == SQLITE_OK) {
       std::ostringstream sql_statement_stream;
       sql_statement_stream << "DELETE FROM " << REQUESTS_TABLE_NAME << ";";
@@ -386,6 +866,8 @@ void StorageModuleDB::RQClearAll() {
         std::string error(error_message);
         _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQRemoveFront error = " + error);
         sqlite3_free(error_message);
+      } else {
+        _request_bytes = 0;
       }
     }
     // Close database connection
@@ -399,59 +881,73 @@ void StorageModuleDB::RQClearAll() {
 }
 
 const std::shared_ptr<DataEntry> StorageModuleDB::RQPeekFront() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQPeekFront: Module is not initialized");
+    return std::make_shared<DataEntry>(-1, "");
+  }
+
+  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQPeekFronts");
+  return peekFront("");
+}
+
+const std::shared_ptr<DataEntry> StorageModuleDB::RQPeekFront(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQPeekFront(class): Module is not initialized");
+    return std::make_shared<DataEntry>(-1, "");
+  }
+
+  return peekFront(classCondition(requestClass));
+}
+
+const std::shared_ptr<DataEntry> StorageModuleDB::peekFront(const std::string &condition) {
   try {
     std::shared_ptr<DataEntry> front = std::make_shared<DataEntry>(-1, ""); // Initialize a shared pointer to a default-constructed DataEntry object
-    if (!_is_initialized) {
-      _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQPeekFront: Module is not initialized");
-      return front;
+    if (_writer) {
+      _writer->flush();
     }
 
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQPeekFronts");
-
 #ifdef COUNTLY_USE_SQLITE
-    sqlite3 *database;
-    int return_value, row_count, column_count;
-    char **table;
-    char *error_message;
+    // The lease owns the connection and the statement, the returned entry views the row through it
+    std::shared_ptr<SqliteRowLease> lease = std::make_shared<SqliteRowLease>();
 
     // Open the SQLite database
-    return_value = sqlite3_open(_configuration->databasePath.c_str(), &database);
+    int return_value = openRequestDatabase(_configuration->databasePath, &lease->database);
     if (return_value == SQLITE_OK) {
+      // Serve page reads from a memory mapping of the database file instead of copying them into the page cache
+      sqlite3_exec(lease->database, ("PRAGMA mmap_size=" + std::to_string(DATABASE_MMAP_SIZE) + ";").c_str(), nullptr, nullptr, nullptr);
+
       // Construct an SQL statement to retrieve the first row of the requests table
       std::ostringstream sql_statement_stream;
-      sql_statement_stream << "SELECT " << REQUESTS_TABLE_REQUEST_ID << ", " << REQUESTS_TABLE_REQUEST_DATA << " FROM " << REQUESTS_TABLE_NAME << " ORDER BY " << REQUESTS_TABLE_REQUEST_ID << " ASC LIMIT 1;";
+      sql_statement_stream << "SELECT " << REQUESTS_TABLE_REQUEST_ID << ", " << REQUESTS_TABLE_REQUEST_DATA << " FROM " << REQUESTS_TABLE_NAME << ' ' << condition << " ORDER BY " << REQUESTS_TABLE_REQUEST_ID << " ASC LIMIT 1;";
       std::string sql_statement = sql_statement_stream.str();
 
-      // Execute the SQL statement
-      return_value = sqlite3_get_table(database, sql_statement.c_str(), &table, &row_count, &column_count, &error_message);
-      bool no_request = (row_count == 0);             // Check if there are any rows in the requests table
-      if (return_value == SQLITE_OK && !no_request) { // If the SQL statement is executed successfully and there is at least one row in the requests table
-        // For each column in the first row of the requests table
-        for (int event_index = 1; event_index < row_count + 1; event_index++) {
-          // Retrieve the request ID and request data from the table
-          std::string requestId = table[event_index * column_count];
-          std::string request = table[(event_index * column_count) + 1];
-          // Create a new DataEntry object and reset the shared pointer to point to it
-          DataEntry *frontEntry = new DataEntry(std::stoll(requestId), request);
-          _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleDB] RQPeekFronts id =" + requestId);
-          front.reset(frontEntry);
+      return_value = sqlite3_prepare_v2(lease->database, sql_statement.c_str(), -1, &lease->statement, nullptr);
+      if (return_value == SQLITE_OK) {
+        return_value = sqlite3_step(lease->statement);
+        if (return_value == SQLITE_ROW) {
+          // Text pointer is owned by the statement and stays valid until the lease is destroyed
+          long long requestId = sqlite3_column_int64(lease->statement, 0);
+          const char *request = reinterpret_cast<const char *>(sqlite3_column_text(lease->statement, 1));
+          size_t request_size = static_cast<size_t>(sqlite3_column_bytes(lease->statement, 1));
+          _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleDB] RQPeekFronts id =" + std::to_string(requestId); });
+          front = std::make_shared<DataEntry>(requestId, BufferView(request, request_size), lease);
+        } else if (return_value != SQLITE_DONE) {
+          _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQPeekFronts error =" + std::string(sqlite3_errmsg(lease->database)));
         }
-      } else if (return_value != SQLITE_OK) {
-        std::string error(error_message);
-        _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQPeekFronts error =" + error);
-        sqlite3_free(error_message); // free the error message pointer
+      } else {
+        _logger->log(LogLevel::ERROR, "[Countly][StorageModuleDB] RQPeekFronts error =" + std::string(sqlite3_errmsg(lease->database)));
       }
-      sqlite3_free_table(table); // Free the table pointer
     }
-    sqlite3_close(database); // Close the SQLite database
 #endif
 
     return front; // Return the shared pointer to the DataEntry object
   } catch (const std::system_error &e) {
     std::ostringstream log_message;
-    log_message << "RQPeekFront, error: " << e.what();
+    log_message << "peekFront, error: " << e.what();
     _logger->log(LogLevel::FATAL, log_message.str());
   }
+
+  return std::make_shared<DataEntry>(-1, "");
 }
 
 }; // namespace cly
\ No newline at end of file
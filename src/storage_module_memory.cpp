@@ -2,8 +2,16 @@
 #include "countly/storage_module_memory.hpp"
 #include "countly/countly_configuration.hpp"
 #include "countly/logger_module.hpp"
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
+// Size of an arena chunk. Requests larger than this get a chunk of their own.
+const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+
+// Count of request headers the ring starts with.
+const size_t INITIAL_RING_CAPACITY = 64;
+
 namespace cly {
 StorageModuleMemory::StorageModuleMemory(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger) : StorageModuleBase(config, logger) {}
 
@@ -17,6 +25,110 @@ void StorageModuleMemory::init() {
   _is_initialized = true;
 }
 
+std::shared_ptr<DataEntry> StorageModuleMemory::peekLane(Lane &lane) {
+  const RequestHeader &header = lane.headerAt(0);
+  const ArenaChunk &chunk = _chunks[header.chunk - _first_chunk];
+  // the entry keeps the chunk alive, so it stays readable after the request is removed
+  DataEntry entry(header.id, BufferView(chunk.data.get() + header.offset, header.size), chunk.data);
+  if (lane.peeked != nullptr && lane.peeked.use_count() == 1) {
+    *lane.peeked = entry;
+  } else {
+    // the previous entry is still held by someone, it stays as it is
+    lane.peeked = std::make_shared<DataEntry>(entry);
+  }
+  return lane.peeked;
+}
+
+StorageModuleMemory::Lane *StorageModuleMemory::oldestLane() {
+  Lane *oldest = nullptr;
+  for (Lane &lane : _lanes) {
+    if (lane.count > 0 && (oldest == nullptr || lane.headerAt(0).id < oldest->headerAt(0).id)) {
+      oldest = &lane;
+    }
+  }
+  return oldest;
+}
+
+char *StorageModuleMemory::allocate(size_t size, unsigned long long &chunk, size_t &offset) {
+  if (!_chunks.empty() && _chunks.back().count == 0 && _chunks.back().used > 0) {
+    // a drained chunk kept while an entry viewed it is written again from the start once nothing does
+    releasePeeked();
+    if (_chunks.back().data.use_count() == 1) {
+      _chunks.back().used = 0;
+    }
+  }
+
+  if (_chunks.empty() || _chunks.back().capacity - _chunks.back().used < size) {
+    releasePeeked();
+    if (size <= ARENA_CHUNK_SIZE && _spare_chunk.data != nullptr && _spare_chunk.data.use_count() == 1) {
+      _chunks.push_back(_spare_chunk);
+      _spare_chunk = ArenaChunk();
+    } else {
+      ArenaChunk new_chunk;
+      new_chunk.capacity = std::max(size, ARENA_CHUNK_SIZE);
+      new_chunk.data = std::shared_ptr<char>(new char[new_chunk.capacity], std::default_delete<char[]>());
+      _chunks.push_back(new_chunk);
+    }
+  }
+
+  ArenaChunk &back = _chunks.back();
+  chunk = _first_chunk + _chunks.size() - 1;
+  offset = back.used;
+  back.used += size;
+  back.count++;
+  return back.data.get() + offset;
+}
+
+void StorageModuleMemory::popFront(Lane &lane) {
+  const RequestHeader &header = lane.headerAt(0);
+  _chunks[header.chunk - _first_chunk].count--;
+  _request_bytes -= header.size;
+  lane.head = (lane.head + 1) % lane.ring.size();
+  lane.count--;
+  _count--;
+  // requests of other lanes may keep the front chunks, they are released once those are removed too
+  releaseChunks();
+}
+
+void StorageModuleMemory::releasePeeked() {
+  for (Lane &lane : _lanes) {
+    if (lane.peeked == nullptr || lane.peeked.use_count() != 1) {
+      continue;
+    }
+
+    if (lane.count == 0 || lane.peeked->getId() != lane.headerAt(0).id) {
+      *lane.peeked = DataEntry(-1, std::string());
+    }
+  }
+}
+
+void StorageModuleMemory::releaseChunks() {
+  releasePeeked();
+  while (!_chunks.empty() && _chunks.front().count == 0) {
+    if (_chunks.size() == 1) {
+      // the last chunk is written again from the start, if it is still viewed that waits for the next request stored in it
+      if (_chunks.front().data.use_count() == 1) {
+        _chunks.front().used = 0;
+      }
+      return;
+    }
+
+    recycleChunk(_chunks.front());
+    _chunks.pop_front();
+    _first_chunk++;
+  }
+}
+
+void StorageModuleMemory::recycleChunk(ArenaChunk &chunk) {
+  // a chunk that is still viewed by a peeked entry, e.g. the one of a request being removed after it was sent, is kept too and
+  // only reused once that entry is gone, a spare that is still viewed gives way to one that is not
+  if (chunk.capacity == ARENA_CHUNK_SIZE && (_spare_chunk.data == nullptr || (_spare_chunk.data.use_count() > 1 && chunk.data.use_count() == 1))) {
+    _spare_chunk = chunk;
+    _spare_chunk.used = 0;
+    _spare_chunk.count = 0;
+  }
+}
+
 void StorageModuleMemory::RQRemoveFront() {
   if (!_is_initialized) {
     _logger->log(LogLevel::ERROR, "[Countly][StorageModuleMemory] RQRemoveFront: Module is not initialized");
@@ -24,8 +136,22 @@ void StorageModuleMemory::RQRemoveFront() {
   }
 
   _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleMemory] RQRemoveFront");
-  if (request_queue.size() > 0) {
-    request_queue.pop_front();
+  Lane *oldest = oldestLane();
+  if (oldest != nullptr) {
+    popFront(*oldest);
+  }
+}
+
+void StorageModuleMemory::RQRemoveFront(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleMemory] RQRemoveFront(class): Module is not initialized");
+    return;
+  }
+
+  _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleMemory] RQRemoveFront class = [" + std::to_string(static_cast<int>(requestClass)) + "]"; });
+  Lane &lane = _lanes[static_cast<int>(requestClass)];
+  if (lane.count > 0) {
+    popFront(lane);
   }
 }
 
@@ -40,9 +166,12 @@ void StorageModuleMemory::RQRemoveFront(std::shared_ptr<DataEntry> request) {
     return;
   }
 
-  if (request_queue.size() > 0 && request->getId() == request_queue.front()->getId()) {
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleMemory] RQRemoveFront request = " + request->getData());
-    request_queue.pop_front();
+  for (Lane &lane : _lanes) {
+    if (lane.count > 0 && request->getId() == lane.headerAt(0).id) {
+      _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleMemory] RQRemoveFront request = " + request->getData(); });
+      popFront(lane);
+      return;
+    }
   }
 }
 
@@ -52,48 +181,97 @@ long long StorageModuleMemory::RQCount() {
     return -1;
   }
 
-  long long size = request_queue.size();
-  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleMemory] RQCount size = [" + std::to_string(size) + "]");
+  long long size = _count;
+  _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleMemory] RQCount size = [" + std::to_string(size) + "]"; });
   return size;
 }
 
-void StorageModuleMemory::RQInsertAtEnd(const std::string &request) {
+long long StorageModuleMemory::RQCount(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleMemory] RQCount(class): Module is not initialized");
+    return -1;
+  }
+
+  return static_cast<long long>(_lanes[static_cast<int>(requestClass)].count);
+}
+
+long long StorageModuleMemory::RQBytes() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleMemory] RQBytes: Module is not initialized");
+    return -1;
+  }
+
+  return _request_bytes;
+}
+
+void StorageModuleMemory::RQInsertAtEnd(const std::string &request) { RQInsertAtEnd(BufferView(request)); }
+
+void StorageModuleMemory::RQInsertAtEnd(const BufferView &request) {
   if (!_is_initialized) {
     _logger->log(LogLevel::ERROR, "[Countly][StorageModuleMemory] RQInsertAtEnd: Module is not initialized");
     return;
   }
 
-  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleMemory] RQInsertAtEnd request = " + request);
-  if (request != "") {
-    if (request_queue.empty()) {
+  _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleMemory] RQInsertAtEnd request = " + request.toString(); });
+  if (!request.empty()) {
+    if (_count == 0) {
       // Since the DB (Sqlite) storage module reset the primary key when all rows get deleted. To sync with the DB storage module, the memory storage module also reset '_lastUsedId' when the request queue is empty.
       _lastUsedId = 1;
     } else {
       _lastUsedId += 1;
     }
 
-    std::shared_ptr<DataEntry> entry = std::make_shared<DataEntry>(_lastUsedId, request);
-    entry.reset(new DataEntry(_lastUsedId, request));
-    request_queue.push_back(entry);
+    Lane &lane = _lanes[static_cast<int>(classifyRequest(request))];
+    if (lane.count == lane.ring.size()) {
+      // unroll the full ring into a bigger one, oldest request first
+      std::vector<RequestHeader> ring;
+      ring.reserve(std::max(INITIAL_RING_CAPACITY, lane.ring.size() * 2));
+      for (size_t index = 0; index < lane.count; index++) {
+        ring.push_back(lane.headerAt(index));
+      }
+      ring.resize(ring.capacity());
+      lane.ring.swap(ring);
+      lane.head = 0;
+    }
+
+    RequestHeader &header = lane.ring[(lane.head + lane.count) % lane.ring.size()];
+    header.id = _lastUsedId;
+    header.size = request.size();
+    std::memcpy(allocate(request.size(), header.chunk, header.offset), request.data(), request.size());
+    lane.count++;
+    _count++;
+    _request_bytes += request.size();
   } else {
     _logger->log(LogLevel::WARNING, "[Countly][StorageModuleMemory] RQInsertAtEnd request is empty");
   }
 }
 
-std::vector<std::shared_ptr<DataEntry>> StorageModuleMemory::RQPeekAll() {
+size_t StorageModuleMemory::RQForEach(const RequestVisitor &visitor, size_t limit) {
   if (!_is_initialized) {
-    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleMemory] RQPeekAll: Module is not initialized");
-    return {};
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleMemory] RQForEach: Module is not initialized");
+    return 0;
   }
 
-  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleMemory] RQPeekAll");
-  int qSize = request_queue.size();
-  std::vector<std::shared_ptr<DataEntry>> v(qSize);
-  for (int i = 0; i < request_queue.size(); ++i) {
-    v[i] = request_queue.at(i);
+  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleMemory] RQForEach");
+  const size_t count = limit > 0 ? std::min(limit, _count) : _count;
+  // every lane is in insertion order, they are merged by id
+  std::array<size_t, REQUEST_CLASS_COUNT> positions = {};
+  for (size_t index = 0; index < count; index++) {
+    int next_lane = -1;
+    for (int lane = 0; lane < REQUEST_CLASS_COUNT; lane++) {
+      if (positions[lane] < _lanes[lane].count && (next_lane < 0 || _lanes[lane].headerAt(positions[lane]).id < _lanes[next_lane].headerAt(positions[next_lane]).id)) {
+        next_lane = lane;
+      }
+    }
+
+    const RequestHeader &header = _lanes[next_lane].headerAt(positions[next_lane]++);
+    const ArenaChunk &chunk = _chunks[header.chunk - _first_chunk];
+    if (!visitor(header.id, BufferView(chunk.data.get() + header.offset, header.size))) {
+      return index + 1;
+    }
   }
 
-  return v;
+  return count;
 }
 
 void StorageModuleMemory::RQClearAll() {
@@ -103,7 +281,18 @@ void StorageModuleMemory::RQClearAll() {
   }
 
   _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleMemory] RQClearAll");
-  request_queue.clear();
+  for (Lane &lane : _lanes) {
+    lane.head = 0;
+    lane.count = 0;
+  }
+  releasePeeked();
+  for (ArenaChunk &chunk : _chunks) {
+    recycleChunk(chunk);
+  }
+  _first_chunk += _chunks.size();
+  _chunks.clear();
+  _count = 0;
+  _request_bytes = 0;
 }
 
 const std::shared_ptr<DataEntry> StorageModuleMemory::RQPeekFront() {
@@ -114,9 +303,10 @@ const std::shared_ptr<DataEntry> StorageModuleMemory::RQPeekFront() {
     return front;
   }
 
-  if (request_queue.size() > 0) {
-    front = request_queue.front();
-    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleMemory] RQPeekFront: request = " + front->getData());
+  Lane *oldest = oldestLane();
+  if (oldest != nullptr) {
+    front = peekLane(*oldest);
+    _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleMemory] RQPeekFront: request = " + front->getData(); });
   } else {
     front.reset(new DataEntry(-1, ""));
     _logger->log(LogLevel::WARNING, "[Countly][StorageModuleMemory] RQPeekFront: Request queue is empty.");
@@ -124,4 +314,18 @@ const std::shared_ptr<DataEntry> StorageModuleMemory::RQPeekFront() {
 
   return front;
 }
+
+const std::shared_ptr<DataEntry> StorageModuleMemory::RQPeekFront(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleMemory] RQPeekFront(class): Module is not initialized");
+    return std::make_shared<DataEntry>(-1, "");
+  }
+
+  Lane &lane = _lanes[static_cast<int>(requestClass)];
+  if (lane.count == 0) {
+    return std::make_shared<DataEntry>(-1, "");
+  }
+
+  return peekLane(lane);
+}
 }; // namespace cly
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "countly/storage_module_tiered.hpp"
+#include "countly/countly_configuration.hpp"
+#include "countly/logger_module.hpp"
+#include <memory>
+
+namespace cly {
+StorageModuleTiered::StorageModuleTiered(std::shared_ptr<CountlyConfiguration> config, std::shared_ptr<LoggerModule> logger, std::shared_ptr<PersistentWriter> writer) : StorageModuleBase(config, logger) {
+  _memory = std::make_shared<StorageModuleMemory>(config, logger);
+  _persistent = std::make_shared<StorageModuleDB>(config, logger, writer);
+}
+
+StorageModuleTiered::~StorageModuleTiered() {
+  _memory.reset();
+  _persistent.reset();
+  _configuration.reset();
+  _logger.reset();
+}
+
+void StorageModuleTiered::init() {
+  _memory->init();
+  _persistent->init();
+
+  // without the persistent tier requests could not survive a restart, so the module is not usable
+  _is_initialized = _memory->isInitialized() && _persistent->isInitialized();
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] init: Persistent tier could not be initialized");
+    return;
+  }
+
+  // requests left from the previous run are only in the database
+  _persistent_count = _persistent->RQCount();
+  _memory_bytes = 0;
+  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleTiered] initialized, persistent requests = [" + std::to_string(_persistent_count) + "]");
+}
+
+void StorageModuleTiered::RQRemoveFront() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQRemoveFront: Module is not initialized");
+    return;
+  }
+
+  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleTiered] RQRemoveFront");
+  if (_memory->RQCount() > 0) {
+    _memory_bytes -= _memory->RQPeekFront()->getView().size();
+    _memory->RQRemoveFront();
+  } else if (_persistent_count > 0) {
+    _persistent->RQRemoveFront();
+    _persistent_count--;
+  }
+}
+
+void StorageModuleTiered::RQRemoveFront(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQRemoveFront(class): Module is not initialized");
+    return;
+  }
+
+  _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleTiered] RQRemoveFront class = [" + std::to_string(static_cast<int>(requestClass)) + "]"; });
+  // requests in memory are older than the ones in the database in every lane too
+  if (_memory->RQCount(requestClass) > 0) {
+    _memory_bytes -= _memory->RQPeekFront(requestClass)->getView().size();
+    _memory->RQRemoveFront(requestClass);
+  } else if (_persistent_count > 0) {
+    _persistent->RQRemoveFront(requestClass);
+    _persistent_count = _persistent->RQCount();
+  }
+}
+
+void StorageModuleTiered::RQRemoveFront(std::shared_ptr<DataEntry> request) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQRemoveFront(request): Module is not initialized");
+    return;
+  }
+
+  if (request == nullptr) {
+    _logger->log(LogLevel::WARNING, "[Countly][StorageModuleTiered] RQRemoveFront request = null");
+    return;
+  }
+
+  // the tiers number their requests independently, so the request is only removed from the tier it was peeked from; an entry
+  // that was not peeked from this module is looked for in the tier its lane is peeked from
+  const RequestClass requestClass = classifyRequest(request->getView());
+  const StorageTier tier = request->getTier() != StorageTier::NONE ? request->getTier() : (_memory->RQCount(requestClass) > 0 ? StorageTier::MEMORY : StorageTier::PERSISTENT);
+  if (tier == StorageTier::MEMORY) {
+    if (_memory->RQCount(requestClass) > 0) {
+      std::shared_ptr<DataEntry> front = _memory->RQPeekFront(requestClass);
+      if (front->getId() == request->getId()) {
+        _memory_bytes -= front->getView().size();
+        _memory->RQRemoveFront(requestClass);
+      }
+    }
+  } else if (_persistent_count > 0) {
+    // the database removes by id, recount to know whether the request was there
+    _persistent->RQRemoveFront(request);
+    _persistent_count = _persistent->RQCount();
+  }
+}
+
+std::shared_ptr<DataEntry> StorageModuleTiered::tagged(std::shared_ptr<DataEntry> entry, StorageTier tier) {
+  if (entry->getId() != -1) {
+    entry->setTier(tier);
+  }
+  return entry;
+}
+
+long long StorageModuleTiered::RQCount() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQCount: Module is not initialized");
+    return -1;
+  }
+
+  return _memory->RQCount() + _persistent_count;
+}
+
+long long StorageModuleTiered::RQCount(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQCount(class): Module is not initialized");
+    return -1;
+  }
+
+  return _memory->RQCount(requestClass) + (_persistent_count > 0 ? _persistent->RQCount(requestClass) : 0);
+}
+
+std::array<long long, REQUEST_CLASS_COUNT> StorageModuleTiered::RQCountByClass() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQCountByClass: Module is not initialized");
+    std::array<long long, REQUEST_CLASS_COUNT> counts;
+    counts.fill(-1);
+    return counts;
+  }
+
+  std::array<long long, REQUEST_CLASS_COUNT> counts = _memory->RQCountByClass();
+  if (_persistent_count > 0) {
+    const std::array<long long, REQUEST_CLASS_COUNT> persistent_counts = _persistent->RQCountByClass();
+    for (int lane = 0; lane < REQUEST_CLASS_COUNT; lane++) {
+      counts[lane] += persistent_counts[lane];
+    }
+  }
+
+  return counts;
+}
+
+long long StorageModuleTiered::RQBytes() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQBytes: Module is not initialized");
+    return -1;
+  }
+
+  return static_cast<long long>(_memory_bytes) + _persistent->RQBytes();
+}
+
+void StorageModuleTiered::RQInsertAtEnd(const std::string &request) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQInsertAtEnd: Module is not initialized");
+    return;
+  }
+
+  if (request == "") {
+    _logger->log(LogLevel::WARNING, "[Countly][StorageModuleTiered] RQInsertAtEnd request is empty");
+    return;
+  }
+
+  // once something is in the database, newer requests have to go after it to keep the order
+  if (_persistent_count > 0 || _memory_bytes + request.size() > _configuration->requestQueueMemoryWatermark) {
+    _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleTiered] RQInsertAtEnd: Spilling request to the persistent tier");
+    _persistent->RQInsertAtEnd(request);
+    _persistent_count++;
+    return;
+  }
+
+  _memory->RQInsertAtEnd(request);
+  _memory_bytes += request.size();
+}
+
+size_t StorageModuleTiered::RQForEach(const RequestVisitor &visitor, size_t limit) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQForEach: Module is not initialized");
+    return 0;
+  }
+
+  bool is_stopped = false;
+  const RequestVisitor tracking_visitor = [&visitor, &is_stopped](long long id, const BufferView &request) {
+    is_stopped = !visitor(id, request);
+    return !is_stopped;
+  };
+
+  size_t visited = _memory->RQForEach(tracking_visitor, limit);
+  if (!is_stopped && _persistent_count > 0 && (limit == 0 || visited < limit)) {
+    visited += _persistent->RQForEach(tracking_visitor, limit == 0 ? 0 : limit - visited);
+  }
+
+  return visited;
+}
+
+void StorageModuleTiered::RQClearAll() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQClearAll: Module is not initialized");
+    return;
+  }
+
+  _logger->log(LogLevel::DEBUG, "[Countly][StorageModuleTiered] RQClearAll");
+  _memory->RQClearAll();
+  _persistent->RQClearAll();
+  _memory_bytes = 0;
+  _persistent_count = 0;
+}
+
+const std::shared_ptr<DataEntry> StorageModuleTiered::RQPeekFront() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQPeekFront: Module is not initialized");
+    return std::make_shared<DataEntry>(-1, "");
+  }
+
+  if (_memory->RQCount() == 0 && _persistent_count > 0) {
+    return tagged(_persistent->RQPeekFront(), StorageTier::PERSISTENT);
+  }
+
+  return tagged(_memory->RQPeekFront(), StorageTier::MEMORY);
+}
+
+const std::shared_ptr<DataEntry> StorageModuleTiered::RQPeekFront(RequestClass requestClass) {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] RQPeekFront(class): Module is not initialized");
+    return std::make_shared<DataEntry>(-1, "");
+  }
+
+  if (_memory->RQCount(requestClass) == 0 && _persistent_count > 0) {
+    return tagged(_persistent->RQPeekFront(requestClass), StorageTier::PERSISTENT);
+  }
+
+  return tagged(_memory->RQPeekFront(requestClass), StorageTier::MEMORY);
+}
+
+void StorageModuleTiered::persist() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] persist: Module is not initialized");
+    return;
+  }
+
+  std::vector<std::string> requests;
+  _memory->RQForEach([&requests](long long id, const BufferView &request) {
+    requests.push_back(request.toString());
+    return true;
+  });
+  _logger->logLazy(LogLevel::DEBUG, [&]() { return "[Countly][StorageModuleTiered] persist: Moving [" + std::to_string(requests.size()) + "] requests to the persistent tier"; });
+  if (requests.empty()) {
+    return;
+  }
+
+  // requests in memory are older than the ones in the database, so they go in front of them
+  _persistent->RQInsertAtFront(requests);
+  _persistent_count = _persistent->RQCount();
+  _memory->RQClearAll();
+  _memory_bytes = 0;
+}
+
+void StorageModuleTiered::compact() {
+  if (!_is_initialized) {
+    _logger->log(LogLevel::ERROR, "[Countly][StorageModuleTiered] compact: Module is not initialized");
+    return;
+  }
+
+  _persistent->compact();
+}
+}; // namespace cly
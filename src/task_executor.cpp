@@ -0,0 +1,109 @@
+#include "countly/task_executor.hpp"
+#include <sstream>
+#include <system_error>
+
+namespace cly {
+TaskExecutor::TaskExecutor(std::shared_ptr<LoggerModule> logger) : _logger(logger) {}
+
+TaskExecutor::~TaskExecutor() {
+  stop();
+  _logger.reset();
+}
+
+std::shared_future<bool> TaskExecutor::submit(const std::string &key, Task task) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto in_flight = _in_flight.find(key);
+  if (in_flight != _in_flight.end()) {
+    _logger->log(LogLevel::DEBUG, "[Countly][TaskExecutor] submit: Joining the task in flight, key = [" + key + "]");
+    return in_flight->second;
+  }
+
+  // a task submitted while stopping is not run
+  std::shared_ptr<std::promise<bool>> promise = std::make_shared<std::promise<bool>>();
+  std::shared_future<bool> future = promise->get_future().share();
+  if (_stop_requested) {
+    promise->set_value(false);
+    return future;
+  }
+
+  if (!_thread) {
+    try {
+      _thread.reset(new std::thread(&TaskExecutor::runLoop, this));
+    } catch (const std::system_error &e) {
+      std::ostringstream log_message;
+      log_message << "[Countly][TaskExecutor] submit: Could not create thread: " << e.what();
+      _logger->log(LogLevel::FATAL, log_message.str());
+      promise->set_value(false);
+      return future;
+    }
+  }
+
+  _queue.push_back({key, std::move(task), promise});
+  _in_flight[key] = future;
+  _condition.notify_one();
+  return future;
+}
+
+void TaskExecutor::runLoop() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    _condition.wait(lock, [this]() { return _stop_requested || !_queue.empty(); });
+    if (_stop_requested) {
+      return;
+    }
+
+    Entry entry = std::move(_queue.front());
+    _queue.pop_front();
+    lock.unlock();
+
+    bool result = false;
+    try {
+      result = entry.task();
+    } catch (const std::exception &e) {
+      std::ostringstream log_message;
+      log_message << "[Countly][TaskExecutor] runLoop: Task [" << entry.key << "] failed: " << e.what();
+      _logger->log(LogLevel::ERROR, log_message.str());
+    }
+
+    lock.lock();
+    // callers that joined meanwhile get this result, later ones start a new task
+    _in_flight.erase(entry.key);
+    entry.promise->set_value(result);
+  }
+}
+
+void TaskExecutor::dropQueued() {
+  for (Entry &entry : _queue) {
+    _in_flight.erase(entry.key);
+    entry.promise->set_value(false);
+  }
+  _queue.clear();
+}
+
+void TaskExecutor::cancelPending() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  dropQueued();
+}
+
+void TaskExecutor::stop() {
+  std::unique_ptr<std::thread> thread;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    dropQueued();
+    _stop_requested = true;
+    thread = std::move(_thread);
+  }
+  _condition.notify_all();
+
+  if (thread && thread->joinable()) {
+    try {
+      thread->join();
+    } catch (const std::system_error &e) {
+      _logger->log(LogLevel::WARNING, "[Countly][TaskExecutor] stop: Could not join thread");
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stop_requested = false;
+}
+} // namespace cly
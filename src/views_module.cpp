@@ -1,6 +1,12 @@
 #include "countly/views_module.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <climits>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
 
 #define CLY_VIEW_KEY "[CLY]_view"
 
@@ -10,103 +16,137 @@ class ViewsModule::ViewModuleImpl {
   public:
     std::string name;
     std::string viewId;
-    std::chrono::seconds startTime;
+    // durations are measured on a monotonic clock, so that changes of the wall clock do not change them
+    std::chrono::steady_clock::time_point startTime;
   };
 
 private:
+  // views are opened and closed from any thread, the lock is not held while the event is recorded
+  std::mutex _mutex;
   bool _isFirstView = true;
-  std::map<std::string, std::shared_ptr<ViewInfo>> _viewsStartTime;
+  // slots of the views, reused through the free list so that opening a view does not allocate one
+  std::vector<ViewInfo> _views;
+  std::vector<size_t> _freeSlots;
+  std::unordered_map<std::string, size_t> _viewsById;
+  // open views of each name, oldest first; entries are kept when empty, as views have a small set of names
+  std::unordered_map<std::string, std::vector<size_t>> _viewsByName;
+
+  std::default_random_engine _generator;
+  std::uniform_int_distribution<int> _distribution{1, INT_MAX};
+  long long _lastTimestamp = 0;
 
   cly::CountlyDelegates *_cly;
 
-  std::shared_ptr<ViewInfo> findViewByName(const std::string &name) {
-    for (auto &x : _viewsStartTime) {
-      if (x.second->name == name) {
-        return x.second;
-      }
+  /**
+   * Generate an id in the format of 'utils::generateEventID'. The timestamp part is made to grow, so that views opened within
+   * the resolution of the clock get different ids. Called with the lock held.
+   */
+  std::string generateViewId() {
+    long long timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+    if (timestamp <= _lastTimestamp) {
+      timestamp = _lastTimestamp + 1;
     }
+    _lastTimestamp = timestamp;
 
-    return nullptr;
+    std::string viewId = std::to_string(_distribution(_generator));
+    viewId += '_';
+    viewId += std::to_string(timestamp);
+    return viewId;
   }
-  void _recordView(std::shared_ptr<ViewInfo> v, const std::map<std::string, std::string> &segmentation, bool isOpenView) {
-    double duration = 0;
-    std::map<std::string, std::string> viewSegments;
-
-    if (isOpenView) {
-      viewSegments["visit"] = "1";
-
-      if (_isFirstView) {
-        viewSegments["start"] = "1";
-      }
-
-      for (auto key_value : segmentation) {
-        auto itr = viewSegments.find(key_value.first);
-        if (itr != viewSegments.end()) {
-          (*itr).second = key_value.second;
-        } else {
-          viewSegments[key_value.first] = key_value.second;
-        }
-      }
-    } else {
 
-      const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-      const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
-      std::chrono::seconds dur = timestamp - v->startTime;
-      duration = dur.count();
-    }
+  /**
+   * Remove the view from the indices and free its slot. Called with the lock held.
+   */
+  void releaseView(size_t slot) {
+    ViewInfo &view = _views[slot];
+    _viewsById.erase(view.viewId);
 
-    viewSegments["_idv"] = v->viewId;
-    viewSegments["name"] = v->name;
+    std::vector<size_t> &named = _viewsByName[view.name];
+    named.erase(std::find(named.begin(), named.end(), slot));
+    _freeSlots.push_back(slot);
+  }
+
+  /**
+   * Record the closing of the view in the given slot and release it.
+   */
+  void closeView(std::unique_lock<std::mutex> &lock, size_t slot) {
+    ViewInfo &view = _views[slot];
+    const double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - view.startTime).count();
+    std::map<std::string, std::string> viewSegments = {{"_idv", view.viewId}, {"name", view.name}};
+    releaseView(slot);
+    lock.unlock();
 
     _cly->RecordEvent(CLY_VIEW_KEY, viewSegments, 1, 0, duration);
-    if (isOpenView) {
-      _isFirstView = false;
-    } else {
-      _viewsStartTime.erase(v->viewId);
-    }
   }
 
 public:
   std::shared_ptr<cly::LoggerModule> _logger;
-  ViewModuleImpl(cly::CountlyDelegates *cly, std::shared_ptr<cly::LoggerModule> logger) : _cly(cly), _logger(logger) {}
+  ViewModuleImpl(cly::CountlyDelegates *cly, std::shared_ptr<cly::LoggerModule> logger) : _generator(std::random_device{}()), _cly(cly), _logger(logger) {}
 
   ~ViewModuleImpl() { _logger.reset(); }
 
   std::string _openView(const std::string &name, const std::map<std::string, std::string> &segmentation) {
-    ViewModuleImpl::ViewInfo *v = new ViewModuleImpl::ViewInfo();
-    v->name = name;
-    v->viewId = cly::utils::generateEventID();
-    v->startTime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch());
+    // the given segmentation overrides 'visit' and 'start', but not the id and the name
+    std::map<std::string, std::string> viewSegments = segmentation;
+    viewSegments.emplace("visit", "1");
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    size_t slot;
+    if (_freeSlots.empty()) {
+      slot = _views.size();
+      _views.emplace_back();
+    } else {
+      slot = _freeSlots.back();
+      _freeSlots.pop_back();
+    }
 
-    std::shared_ptr<ViewModuleImpl::ViewInfo> ptr(v);
+    ViewInfo &view = _views[slot];
+    view.name = name;
+    view.viewId = generateViewId();
+    view.startTime = std::chrono::steady_clock::now();
+    _viewsById.emplace(view.viewId, slot);
+    _viewsByName[name].push_back(slot);
 
-    _viewsStartTime[ptr->viewId] = ptr;
+    if (_isFirstView) {
+      viewSegments.emplace("start", "1");
+      _isFirstView = false;
+    }
+    viewSegments["_idv"] = view.viewId;
+    viewSegments["name"] = name;
+    std::string viewId = view.viewId;
+    lock.unlock();
 
-    _recordView(ptr, segmentation, true);
-    return ptr->viewId;
+    _cly->RecordEvent(CLY_VIEW_KEY, viewSegments, 1, 0, 0);
+    return viewId;
   }
 
   void _closeViewWithName(const std::string &name) {
-    std::shared_ptr<ViewModuleImpl::ViewInfo> v = findViewByName(name);
-    if (v == nullptr) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto named = _viewsByName.find(name);
+    if (named == _viewsByName.end() || named->second.empty()) {
+      lock.unlock();
       _logger->log(cly::LogLevel::WARNING, cly::utils::format_string("[ViewModuleImpl] _closeViewWithName:  Couldn't found "
                                                                      "view with name = %s",
                                                                      name.c_str()));
       return;
     }
-    _recordView(v, {}, false);
+
+    // of several open views with the name, the oldest is closed
+    closeView(lock, named->second.front());
   }
 
   void _closeViewWithID(const std::string &viewId) {
-
-    if (_viewsStartTime.find(viewId) == _viewsStartTime.end()) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto view = _viewsById.find(viewId);
+    if (view == _viewsById.end()) {
+      lock.unlock();
       _logger->log(cly::LogLevel::WARNING, cly::utils::format_string("[ViewModuleImpl] _closeViewWithID:  Couldn't found "
                                                                      "view with viewId = %s",
                                                                      viewId.c_str()));
       return;
     }
 
-    _recordView(_viewsStartTime[viewId], {}, false);
+    closeView(lock, view->second);
   }
 };
 
@@ -120,7 +160,7 @@ ViewsModule::~ViewsModule() { impl.reset(); }
 
 std::string ViewsModule::openView(const std::string &name, const std::map<std::string, std::string> &segmentation) {
 
-  impl->_logger->log(cly::LogLevel::INFO, cly::utils::format_string("[ViewsModule] openView:  name = %s, segmentation = %s", name.c_str(), utils::mapToString(segmentation).c_str()));
+  impl->_logger->logLazy(cly::LogLevel::INFO, [&]() { return cly::utils::format_string("[ViewsModule] openView:  name = %s, segmentation = %s", name.c_str(), utils::mapToString(segmentation).c_str()); });
 
   if (name.empty()) {
     impl->_logger->log(cly::LogLevel::WARNING, "[ViewsModule] openView: view name can not be null or empty!");
@@ -131,7 +171,7 @@ std::string ViewsModule::openView(const std::string &name, const std::map<std::s
 }
 
 void ViewsModule::closeViewWithName(const std::string &name) {
-  impl->_logger->log(cly::LogLevel::INFO, cly::utils::format_string("[ViewsModule] closeViewWithName:  name = %s", name.c_str()));
+  impl->_logger->logLazy(cly::LogLevel::INFO, [&]() { return cly::utils::format_string("[ViewsModule] closeViewWithName:  name = %s", name.c_str()); });
 
   if (name.empty()) {
     impl->_logger->log(cly::LogLevel::WARNING, "[ViewsModule] closeViewWithName: view name can not be null or empty!");
@@ -141,7 +181,7 @@ void ViewsModule::closeViewWithName(const std::string &name) {
 }
 
 void ViewsModule::closeViewWithID(const std::string &viewId) {
-  impl->_logger->log(cly::LogLevel::INFO, cly::utils::format_string("[ViewsModule] closeViewWithID:  viewId = %s", viewId.c_str()));
+  impl->_logger->logLazy(cly::LogLevel::INFO, [&]() { return cly::utils::format_string("[ViewsModule] closeViewWithID:  viewId = %s", viewId.c_str()); });
 
   if (viewId.empty()) {
     impl->_logger->log(cly::LogLevel::WARNING, "[ViewsModule] closeViewWithID: viewId can not be null or empty!");
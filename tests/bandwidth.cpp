@@ -0,0 +1,167 @@
+#include "countly/bandwidth_limiter.hpp"
+#include "countly/storage_module_memory.hpp"
+#include "stub_server.hpp"
+#include "test_utils.hpp"
+
+#include "doctest.h"
+#include <chrono>
+#include <string>
+#include <thread>
+using namespace cly;
+
+// Upload rate of the tests in bytes a second.
+#define TEST_BANDWIDTH 40000
+#define TEST_BURST 1000
+
+TEST_CASE("Test the bandwidth limiter") {
+  BandwidthLimiter limiter;
+
+  SUBCASE("Without a limit nothing waits") {
+    const BandwidthLimiter::Clock::time_point start = BandwidthLimiter::Clock::now();
+    for (int i = 0; i < 100; i++) {
+      CHECK(limiter.acquire(100000));
+    }
+    CHECK(BandwidthLimiter::Clock::now() - start < std::chrono::milliseconds(50));
+  }
+
+  SUBCASE("The burst is sent at once and the rest at the rate") {
+    limiter.setRate(TEST_BANDWIDTH, TEST_BURST);
+    const BandwidthLimiter::Clock::time_point start = BandwidthLimiter::Clock::now();
+    CHECK(limiter.acquire(TEST_BURST));
+    CHECK(BandwidthLimiter::Clock::now() - start < std::chrono::milliseconds(10));
+
+    // a request bigger than the bucket leaves it in debt
+    CHECK(limiter.acquire(TEST_BANDWIDTH / 10));
+    CHECK(limiter.acquire(1));
+    CHECK(BandwidthLimiter::Clock::now() - start >= std::chrono::milliseconds(100));
+  }
+
+  SUBCASE("Paused and closed limiters do not let uploads through") {
+    limiter.setRate(TEST_BANDWIDTH, TEST_BURST);
+    limiter.pause();
+    CHECK(limiter.isPaused());
+    CHECK_FALSE(limiter.acquire(1));
+    limiter.resume();
+    CHECK(limiter.acquire(1));
+
+    // an upload waiting for bandwidth gives up once paused
+    limiter.setRate(1, 1);
+    CHECK(limiter.acquire(1));
+    std::thread pausing([&limiter]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      limiter.pause();
+    });
+    CHECK_FALSE(limiter.acquire(1));
+    pausing.join();
+
+    limiter.resume();
+    limiter.close();
+    CHECK_FALSE(limiter.acquire(1));
+  }
+}
+
+static size_t uploadedBytes = 0;
+static HTTPResponse countingClient(bool use_post, const std::string &url, const std::string &data) {
+  uploadedBytes += data.size();
+  return HTTPResponse{true, nlohmann::json::object()};
+}
+
+/**
+ * Send 'count' requests through the request module and check the achieved rate is within 20% of the limit.
+ * @return the number of bytes of the requests sent
+ */
+static size_t checkUploadRate(std::shared_ptr<StorageModuleMemory> storageModule, std::shared_ptr<RequestModule> requestModule, int count) {
+  requestModule->setUploadBandwidthLimit(TEST_BANDWIDTH, TEST_BURST);
+  for (int i = 0; i < count; i++) {
+    requestModule->addRequestToQueue({{"events", std::string(1000, 'e')}});
+  }
+
+  size_t queuedBytes = static_cast<size_t>(storageModule->RQBytes());
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  requestModule->processQueue(std::make_shared<std::mutex>());
+  const double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  CHECK(storageModule->RQCount() == 0);
+
+  // the first burst is sent at once
+  const double rate = (queuedBytes - TEST_BURST) / elapsedSeconds;
+  CHECK(rate <= TEST_BANDWIDTH * 1.05);
+  CHECK(rate >= TEST_BANDWIDTH * 0.8);
+  return queuedBytes;
+}
+
+TEST_CASE("Test limiting the upload rate of the request queue") {
+  test_utils::clearSDK();
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "http://127.0.0.1");
+
+  SUBCASE("With a custom HTTP client function") {
+    uploadedBytes = 0;
+    configuration->http_client_function = countingClient;
+    std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+    std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+    std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+    storageModule->init();
+
+    CHECK(checkUploadRate(storageModule, requestModule, 20) == uploadedBytes);
+  }
+
+#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
+  SUBCASE("With the built-in HTTP client against a local server") {
+    test_utils::StubServer server("200 OK", "");
+    configuration->port = server.port;
+    std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+    std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+    std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+    storageModule->init();
+
+    const size_t sentBytes = checkUploadRate(storageModule, requestModule, 20);
+    CHECK(server.requestCount == 20);
+    CHECK(server.receivedBytes >= sentBytes);
+  }
+#endif
+
+  SUBCASE("Nothing is uploaded while paused") {
+    uploadedBytes = 0;
+    configuration->http_client_function = countingClient;
+    configuration->uploadsPaused = true;
+    std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+    std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+    std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+    storageModule->init();
+
+    requestModule->addRequestToQueue({{"events", "1"}});
+    requestModule->processQueue(std::make_shared<std::mutex>());
+    CHECK(uploadedBytes == 0);
+    CHECK(storageModule->RQCount() == 1);
+
+    requestModule->resumeUploads();
+    requestModule->processQueue(std::make_shared<std::mutex>());
+    CHECK(uploadedBytes > 0);
+    CHECK(storageModule->RQCount() == 0);
+  }
+}
+
+TEST_CASE("Test stopping the SDK while a request waits for bandwidth") {
+  test_utils::clearSDK();
+  uploadedBytes = 0;
+  Countly &countly = Countly::getInstance();
+  countly.setHTTPClient(countingClient);
+  countly.setDeviceID(COUNTLY_TEST_DEVICE_ID);
+  countly.SetPath(TEST_DATABASE_NAME);
+  countly.setUpdateInterval(10);
+  countly.setEventsToRQThreshold(1);
+  // a request bigger than the burst leaves the bucket in debt, the next one waits for it to be paid for more than a minute
+  countly.setUploadBandwidthLimit(10, 10);
+  countly.start(COUNTLY_TEST_APP_KEY, COUNTLY_TEST_HOST, COUNTLY_TEST_PORT, true);
+  countly.addEvent(cly::Event(std::string(1000, 'e'), 1));
+
+  // the begin session request is sent, the events request waits for bandwidth
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  CHECK(uploadedBytes > 0);
+  CHECK(countly.checkRQSize() > 0);
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  countly.stop();
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+  test_utils::clearSDK();
+}
@@ -48,6 +48,8 @@ TEST_CASE("Validate setting configuration values") {
     CHECK(config.eventQueueThreshold == 100);
     CHECK(config.requestQueueThreshold == 1000);
     CHECK(config.maxProcessingBatchSize == 100);
+    CHECK(config.processingTimeBudget == 0);
+    CHECK(config.minProcessingBatchSize == 1);
     CHECK(config.breadcrumbsThreshold == 100);
     CHECK(config.forcePost == false);
     CHECK(config.port == 443);
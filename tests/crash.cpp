@@ -1,8 +1,12 @@
 #include <cstdlib>
 #include <deque>
 #include <iostream>
+#include <algorithm>
 #include <map>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "countly.hpp"
 #include "doctest.h"
@@ -124,4 +128,91 @@ TEST_CASE("crash unit tests") {
     // validate crash request
     validateCrashParams("Divided By Zero", "stackTrack", true, "first\nsecond\n", crashMetrics, segmentation);
   }
+
+  SUBCASE("only the latest bread crumbs are kept") {
+    countly.clearRequestQueue();
+
+    // the threshold is 100 by default
+    std::string breadCrumbs;
+    for (int breadCrumb = 0; breadCrumb < 150; breadCrumb++) {
+      countly.crash().addBreadcrumb("crumb " + std::to_string(breadCrumb));
+      if (breadCrumb >= 50) {
+        breadCrumbs += "crumb " + std::to_string(breadCrumb) + "\n";
+      }
+    }
+    countly.crash().recordException("Divided By Zero", "stackTrack", true, {});
+    countly.processRQDebug();
+    validateCrashParams("Divided By Zero", "stackTrack", true, breadCrumbs, {}, {});
+  }
+
+  SUBCASE("bread crumbs are added from several threads while crashes are recorded") {
+    countly.clearRequestQueue();
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; thread++) {
+      threads.emplace_back([&countly, thread]() {
+        for (int breadCrumb = 0; breadCrumb < 1000; breadCrumb++) {
+          countly.crash().addBreadcrumb("thread " + std::to_string(thread) + " crumb " + std::to_string(breadCrumb));
+        }
+      });
+    }
+    for (int crash = 0; crash < 10; crash++) {
+      countly.crash().recordException("crash", "stackTrack", false, {});
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    countly.crash().recordException("crash", "stackTrack", false, {});
+    countly.processRQDebug();
+
+    // every snapshot holds whole bread crumbs only
+    REQUIRE(http_call_queue.size() == 11);
+    for (const HTTPCall &http_call : http_call_queue) {
+      std::istringstream logs(nlohmann::json::parse(http_call.data.at("crash"))["_logs"].get<std::string>());
+      std::string line;
+      int lines = 0;
+      while (std::getline(logs, line)) {
+        lines++;
+        CHECK(line.find("thread ") == 0);
+        CHECK(line.find(" crumb ") != std::string::npos);
+      }
+      CHECK(lines <= 100);
+    }
+    const std::string last = nlohmann::json::parse(http_call_queue.back().data.at("crash"))["_logs"].get<std::string>();
+    CHECK(std::count(last.begin(), last.end(), '\n') == 100);
+    http_call_queue.clear();
+  }
+}
+
+static int cut_warnings = 0;
+
+static void cutWarningLogger(LogLevel level, const std::string &message) {
+  if (level == LogLevel::WARNING && message.find("setMaxBreadcrumbBytes") != std::string::npos) {
+    cut_warnings++;
+  }
+}
+
+TEST_CASE("crash bread crumb size") {
+  clearSDK();
+  Countly &countly = Countly::getInstance();
+  cut_warnings = 0;
+
+  countly.setLogger(cutWarningLogger);
+  countly.setHTTPClient(test_utils::fakeSendHTTP);
+  countly.setDeviceID(COUNTLY_TEST_DEVICE_ID);
+  countly.SetPath(TEST_DATABASE_NAME);
+  // 8 bytes for each of the 100 bread crumbs
+  countly.setMaxBreadcrumbBytes(800);
+  countly.start(COUNTLY_TEST_APP_KEY, COUNTLY_TEST_HOST, COUNTLY_TEST_PORT, false);
+  countly.clearRequestQueue();
+  http_call_queue.clear();
+
+  countly.crash().addBreadcrumb("short");
+  countly.crash().addBreadcrumb("much longer than a slot");
+  // the two byte character would be cut in two at the eighth byte
+  countly.crash().addBreadcrumb("1234567\xC3\xA9");
+  // cutting is logged only the first time
+  CHECK(cut_warnings == 1);
+  countly.crash().recordException("null pointer exception", "stackTrack", false, {});
+  countly.processRQDebug();
+  validateCrashParams("null pointer exception", "stackTrack", false, "short\nmuch lon\n1234567\n", {}, {});
 }
@@ -234,4 +234,56 @@ TEST_CASE("Tests that sets 'setEventsToRQThreshold' before and after SDK starts"
     nlohmann::json events = nlohmann::json::parse(oldest_call.data["events"]);
     CHECK(events.size() == 3);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Tests setting 'setEventsToRQByteThreshold' after we start the SDK") {
+  clearSDK();
+  Countly &countly = Countly::getInstance();
+  test_utils::initCountlyWithFakeNetworking(true, countly);
+
+  test_utils::generateEvents(1, countly);
+  const size_t eventBytes = countly.checkEQBytes();
+  CHECK(eventBytes > 0);
+
+  SUBCASE("Reaching the byte threshold should trigger the events to be sent to the RQ") {
+    // two events stay under the threshold, the third one reaches it
+    countly.setEventsToRQByteThreshold(eventBytes * 3 - eventBytes / 2);
+    test_utils::generateEvents(1, countly);
+    CHECK(countly.checkEQSize() == 2);
+
+    test_utils::generateEvents(1, countly);
+    CHECK(countly.checkEQSize() == 0);
+    CHECK(countly.checkEQBytes() == 0);
+    test_utils::checkTopRequestEventSize(3, countly);
+  }
+
+  SUBCASE("Lowering the byte threshold under the queue size should trigger the events to be sent to the RQ") {
+    countly.setEventsToRQByteThreshold(eventBytes);
+    CHECK(countly.checkEQSize() == 0);
+    test_utils::checkTopRequestEventSize(1, countly);
+  }
+}
+
+#ifdef COUNTLY_USE_SQLITE
+TEST_CASE("Tests that write events and requests through the persistent writer") {
+  clearSDK();
+  Countly &countly = Countly::getInstance();
+  countly.enablePersistentWriteBatching(50, 5);
+  test_utils::initCountlyWithFakeNetworking(true, countly);
+
+  SUBCASE("Events waiting in the writer count towards the threshold") {
+    test_utils::generateEvents(120, countly);
+
+    // default threshold is 100 so we should have 20 events in the EQ left
+    CHECK(countly.checkEQSize() == 20);
+    test_utils::checkTopRequestEventSize(100, countly);
+  }
+
+  SUBCASE("Flushing commits the queued events") {
+    test_utils::generateEvents(10, countly);
+    countly.flushPersistentWrites();
+    CHECK(countly.checkEQSize() == 10);
+    CHECK(countly.debugReturnStateOfEQ().size() == 10);
+  }
+}
+#endif
@@ -0,0 +1,145 @@
+#include "countly/logger_module.hpp"
+
+#include "doctest.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace cly;
+
+static int printed_messages = 0;
+
+static void countingLogger(LogLevel level, const std::string &message) { printed_messages++; }
+
+TEST_CASE("Test skipping log messages that are not printed") {
+  LoggerModule logger;
+  int built_messages = 0;
+  auto buildMessage = [&built_messages]() {
+    built_messages++;
+    return std::string("[Countly][Test] message");
+  };
+
+  SUBCASE("Nothing is built without a logger") {
+    CHECK_FALSE(logger.isEnabled(LogLevel::FATAL));
+    logger.logLazy(LogLevel::FATAL, buildMessage);
+    CHECK(built_messages == 0);
+  }
+
+  SUBCASE("Messages below the min level are not built") {
+    printed_messages = 0;
+    logger.setLogger(countingLogger);
+    logger.setMinLevel(LogLevel::WARNING);
+    CHECK_FALSE(logger.isEnabled(LogLevel::INFO));
+    CHECK(logger.isEnabled(LogLevel::WARNING));
+
+    logger.logLazy(LogLevel::DEBUG, buildMessage);
+    logger.log(LogLevel::INFO, "[Countly][Test] literal");
+    CHECK(built_messages == 0);
+    CHECK(printed_messages == 0);
+
+    logger.logLazy(LogLevel::ERROR, buildMessage);
+    logger.log(LogLevel::WARNING, "[Countly][Test] literal");
+    CHECK(built_messages == 1);
+    CHECK(printed_messages == 2);
+  }
+}
+
+static std::atomic<bool> logger_blocked{false};
+static std::vector<std::string> async_messages;
+
+static void blockingLogger(LogLevel level, const std::string &message) {
+  while (logger_blocked) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  async_messages.push_back(message);
+}
+
+TEST_CASE("Test printing log messages from a background thread") {
+  async_messages.clear();
+  LoggerModule logger;
+  logger.setLogger(blockingLogger);
+
+  SUBCASE("Messages are printed in order once flushed") {
+    logger.startAsync(64);
+    for (int i = 0; i < 10; i++) {
+      logger.log(LogLevel::DEBUG, "[Countly][Test] message " + std::to_string(i));
+    }
+    logger.flush();
+    REQUIRE(async_messages.size() == 10);
+    for (int i = 0; i < 10; i++) {
+      CHECK(async_messages.at(i) == "[Countly][Test] message " + std::to_string(i));
+    }
+    CHECK(logger.getDroppedCount() == 0);
+  }
+
+  SUBCASE("A slow logger does not hold up the logging thread and overflowing messages are counted") {
+    logger_blocked = true;
+    logger.startAsync(4);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 20; i++) {
+      logger.log(LogLevel::DEBUG, "[Countly][Test] message");
+    }
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+
+    // the background thread may already hold one message in the blocked logger
+    const unsigned long long dropped = logger.getDroppedCount();
+    CHECK(dropped >= 15);
+    CHECK(dropped <= 16);
+
+    logger_blocked = false;
+    logger.stopAsync();
+    CHECK(async_messages.size() == 20 - dropped);
+
+    // messages are printed synchronously again
+    logger.log(LogLevel::DEBUG, "[Countly][Test] after");
+    CHECK(async_messages.back() == "[Countly][Test] after");
+  }
+
+  SUBCASE("The logger is not replaced under the background thread") {
+    logger.startAsync(64);
+    logger.setLogger(nullptr);
+    CHECK(logger.getLogger() != nullptr);
+    logger.flush();
+    REQUIRE(async_messages.size() == 1);
+    CHECK(async_messages.back().find("can not be changed") != std::string::npos);
+
+    logger.stopAsync();
+    logger.setLogger(nullptr);
+    CHECK(logger.getLogger() == nullptr);
+  }
+}
+
+static std::mutex counted_messages_mutex;
+static int counted_messages = 0;
+
+static void lockingCountingLogger(LogLevel level, const std::string &message) {
+  std::lock_guard<std::mutex> lock(counted_messages_mutex);
+  counted_messages++;
+}
+
+TEST_CASE("Test stopping the background thread while other threads log") {
+  counted_messages = 0;
+  LoggerModule logger;
+  logger.setLogger(lockingCountingLogger);
+  logger.startAsync(4096);
+
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < 4; thread++) {
+    threads.emplace_back([&logger]() {
+      for (int i = 0; i < 500; i++) {
+        logger.log(LogLevel::DEBUG, "[Countly][Test] message");
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  logger.stopAsync();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  // every message is printed, from the background thread before it ends or from the logging thread after
+  std::lock_guard<std::mutex> lock(counted_messages_mutex);
+  CHECK(counted_messages + static_cast<int>(logger.getDroppedCount()) == 2000);
+}
@@ -3,6 +3,7 @@
 #include <deque>
 #include <iostream>
 #include <map>
+#include <new>
 #include <string>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
@@ -18,6 +19,31 @@ using json = nlohmann::json;
 using namespace cly;
 using namespace test_utils;
 
+std::atomic<unsigned long long> test_utils::allocation_count{0};
+std::atomic<unsigned long long> test_utils::large_allocation_count{0};
+
+void *operator new(std::size_t size) {
+  test_utils::allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (size >= test_utils::LARGE_ALLOCATION_SIZE) {
+    test_utils::large_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  void *memory = std::malloc(size > 0 ? size : 1);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete[](void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t size) noexcept { std::free(memory); }
+
+void operator delete[](void *memory, std::size_t size) noexcept { std::free(memory); }
+
 TEST_CASE("urlencoding is correct") {
   CHECK(RequestBuilder::encodeURL("hello world") == "hello%20world");
   CHECK(RequestBuilder::encodeURL("hello.~world") == "hello.~world");
@@ -0,0 +1,104 @@
+#include "countly/metrics_registry.hpp"
+#include "countly/storage_module_memory.hpp"
+#include "test_utils.hpp"
+
+#include "doctest.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+using namespace cly;
+
+TEST_CASE("Test recording durations into histogram buckets") {
+  Histogram histogram;
+  histogram.record(std::chrono::microseconds(5));
+  histogram.record(std::chrono::microseconds(50));
+  histogram.record(std::chrono::milliseconds(5));
+  histogram.record(std::chrono::seconds(20));
+
+  const HistogramSnapshot snapshot = histogram.snapshot();
+  CHECK(snapshot.count == 4);
+  CHECK(snapshot.sum == 5 + 50 + 5000 + 20000000);
+  CHECK(snapshot.max == 20000000);
+  CHECK(snapshot.buckets[0] == 1);
+  CHECK(snapshot.buckets[1] == 1);
+  CHECK(snapshot.buckets[2] == 0);
+  CHECK(snapshot.buckets[3] == 1);
+  CHECK(snapshot.buckets[METRICS_HISTOGRAM_BUCKETS - 1] == 1);
+}
+
+TEST_CASE("Test counting requests dropped from a full queue") {
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("app-key", "https://test.count.ly");
+  configuration->requestQueueThreshold = 2;
+  configuration->requestQueueMaxBytes = 1000;
+  configuration->http_client_function = test_utils::fakeSendHTTP;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+  storageModule->init();
+
+  for (int i = 0; i < 3; i++) {
+    requestModule->addRequestToQueue({{"events", std::to_string(i)}});
+  }
+  requestModule->addRequestToQueue({{"events", std::string(2000, 'a')}});
+
+  MetricsSnapshot snapshot = configuration->metricsRegistry->snapshot();
+  CHECK(snapshot.requests_queued == 3);
+  CHECK(snapshot.requests_evicted == 1);
+  CHECK(snapshot.requests_rejected == 1);
+  CHECK(snapshot.storage_latency.count == 3);
+
+  requestModule->processQueue(std::make_shared<std::mutex>());
+  snapshot = configuration->metricsRegistry->snapshot();
+  CHECK(snapshot.http_attempts == 2);
+  CHECK(snapshot.http_successes == 2);
+  CHECK(snapshot.http_failures == 0);
+  CHECK(snapshot.bytes_sent > 0);
+  CHECK(snapshot.request_latency.count == 2);
+  CHECK(snapshot.lock_wait.count == 2);
+  test_utils::http_call_queue.clear();
+}
+
+TEST_CASE("Test the metrics of recorded events") {
+  test_utils::clearSDK();
+  Countly &countly = Countly::getInstance();
+  test_utils::initCountlyWithFakeNetworking(true, countly);
+  const MetricsSnapshot before = countly.getMetricsSnapshot();
+
+  test_utils::generateEvents(150, countly);
+  MetricsSnapshot snapshot = countly.getMetricsSnapshot();
+  CHECK(snapshot.events_recorded - before.events_recorded == 150);
+  CHECK(snapshot.events_aggregated - before.events_aggregated == 100);
+  CHECK(snapshot.requests_queued - before.requests_queued == 1);
+  CHECK(snapshot.event_queue_bytes > 0);
+  CHECK(snapshot.request_queue_bytes > 0);
+  CHECK(snapshot.lock_wait.count >= 150);
+
+  countly.processRQDebug();
+  snapshot = countly.getMetricsSnapshot();
+  CHECK(snapshot.http_successes - before.http_successes == 1);
+  CHECK(snapshot.request_queue_bytes == 0);
+  test_utils::http_call_queue.clear();
+  test_utils::clearSDK();
+}
+
+static std::atomic<int> metrics_callbacks{0};
+
+TEST_CASE("Test exporting metrics from the update loop") {
+  test_utils::clearSDK();
+  Countly &countly = Countly::getInstance();
+  countly.setHTTPClient(test_utils::fakeSendHTTP);
+  countly.setDeviceID(COUNTLY_TEST_DEVICE_ID);
+  countly.SetPath(TEST_DATABASE_NAME);
+  countly.setUpdateInterval(10);
+  countly.setMetricsCallback([](const MetricsSnapshot &snapshot) { metrics_callbacks++; }, 0);
+  countly.start(COUNTLY_TEST_APP_KEY, COUNTLY_TEST_HOST, COUNTLY_TEST_PORT, true);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  CHECK(metrics_callbacks > 0);
+  test_utils::clearSDK();
+  test_utils::http_call_queue.clear();
+}
@@ -0,0 +1,324 @@
+#include "countly/http_transport.hpp"
+#include "countly/storage_module_memory.hpp"
+#include "mock_server.hpp"
+#include "test_utils.hpp"
+
+#include "doctest.h"
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+using namespace cly;
+
+#if !defined(_WIN32)
+/**
+ * Connection to the mock server that sends raw requests and reads whole responses.
+ */
+class RawClient {
+private:
+  int _socket;
+  std::string _buffer;
+
+public:
+  // headers of the last response
+  std::string headers;
+
+  explicit RawClient(int port) {
+    _socket = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    connect(_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  }
+
+  ~RawClient() { close(_socket); }
+
+  /**
+   * @return the status code and the body of the response, the status code is 0 when the server closed the connection
+   */
+  std::pair<int, std::string> exchange(const std::string &request) {
+    send(_socket, request.data(), request.size(), MSG_NOSIGNAL);
+
+    char chunk[4096];
+    ssize_t received;
+    size_t header_end;
+    while ((header_end = _buffer.find("\r\n\r\n")) == std::string::npos && (received = recv(_socket, chunk, sizeof(chunk), 0)) > 0) {
+      _buffer.append(chunk, static_cast<size_t>(received));
+    }
+    if (header_end == std::string::npos) {
+      return {0, ""};
+    }
+
+    const size_t length_position = _buffer.find("Content-Length: ");
+    const size_t content_length = std::strtoul(_buffer.c_str() + length_position + 16, nullptr, 10);
+    while (_buffer.size() < header_end + 4 + content_length && (received = recv(_socket, chunk, sizeof(chunk), 0)) > 0) {
+      _buffer.append(chunk, static_cast<size_t>(received));
+    }
+
+    const int status_code = std::atoi(_buffer.c_str() + 9);
+    headers = _buffer.substr(0, header_end + 2);
+    const std::string body = _buffer.substr(header_end + 4, content_length);
+    _buffer.erase(0, header_end + 4 + content_length);
+    return {status_code, body};
+  }
+};
+
+static std::string get(const std::string &target) { return "GET " + target + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"; }
+
+static std::string post(const std::string &path, const std::string &body) {
+  return "POST " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+TEST_CASE("Test the endpoints of the mock server") {
+  test_utils::MockServerSettings settings;
+  settings.remote_config = {{"color", "red"}, {"size", 3}};
+  test_utils::MockServer server(settings);
+  RawClient client(server.port);
+
+  SUBCASE("'/i' takes the parameters of the query string and of the body") {
+    CHECK(client.exchange(get("/i?app_key=key&events=%5B%5D")) == std::make_pair(200, std::string("{\"result\":\"Success\"}")));
+    CHECK(client.exchange(post("/i", "app_key=key&begin_session=1")).first == 200);
+
+    const std::vector<test_utils::MockRequest> requests = server.requests();
+    REQUIRE(requests.size() == 2);
+    CHECK(requests[0].method == "GET");
+    CHECK(requests[0].params.at("events") == "[]");
+    CHECK(requests[1].method == "POST");
+    CHECK(requests[1].params.at("begin_session") == "1");
+
+    const test_utils::MockServerStats stats = server.stats();
+    CHECK(stats.requests_i == 2);
+    CHECK(stats.get_requests == 1);
+    CHECK(stats.post_requests == 1);
+    // both requests came over the same connection
+    CHECK(stats.connections == 1);
+  }
+
+  SUBCASE("'/i/bulk' counts the requests it carries") {
+    CHECK(client.exchange(post("/i/bulk", "requests=%5B%7B%7D%2C%7B%7D%2C%7B%7D%5D")).first == 200);
+    CHECK(server.stats().requests_bulk == 1);
+    CHECK(server.stats().bulk_entries == 3);
+  }
+
+  SUBCASE("'/o/sdk' serves the remote config") {
+    std::pair<int, std::string> response = client.exchange(get("/o/sdk?method=fetch_remote_config"));
+    CHECK(response.first == 200);
+    CHECK(nlohmann::json::parse(response.second) == settings.remote_config);
+
+    response = client.exchange(get("/o/sdk?method=fetch_remote_config&keys=%5B%22size%22%5D"));
+    CHECK(nlohmann::json::parse(response.second) == nlohmann::json({{"size", 3}}));
+
+    response = client.exchange(get("/o/sdk?method=fetch_remote_config&omit_keys=%5B%22size%22%5D"));
+    CHECK(nlohmann::json::parse(response.second) == nlohmann::json({{"color", "red"}}));
+    CHECK(server.stats().requests_sdk == 3);
+  }
+
+  SUBCASE("'/o/sdk' answers 304 to a request with the current entity tag") {
+    CHECK(client.exchange(get("/o/sdk?method=fetch_remote_config")).first == 200);
+    const size_t etag_start = client.headers.find("ETag: ") + 6;
+    const std::string etag = client.headers.substr(etag_start, client.headers.find("\r\n", etag_start) - etag_start);
+    const std::string conditional = "GET /o/sdk?method=fetch_remote_config HTTP/1.1\r\nIf-None-Match: " + etag + "\r\n\r\n";
+
+    CHECK(client.exchange(conditional) == std::make_pair(304, std::string()));
+    CHECK(server.requests().back().if_none_match == etag);
+    CHECK(server.stats().not_modified == 1);
+
+    settings.remote_config["color"] = "blue";
+    server.configure(settings);
+    std::pair<int, std::string> response = client.exchange(conditional);
+    CHECK(response.first == 200);
+    CHECK(nlohmann::json::parse(response.second)["color"] == "blue");
+    CHECK(server.stats().not_modified == 1);
+  }
+
+  SUBCASE("Other paths are not found") {
+    CHECK(client.exchange(get("/o/other")).first == 404);
+    CHECK(server.stats().not_found == 1);
+  }
+
+  SUBCASE("The connection is closed when the client asks for it") {
+    CHECK(client.exchange("GET /i HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n").first == 200);
+    CHECK(client.exchange(get("/i")).first == 0);
+  }
+}
+
+TEST_CASE("Test the failures of the mock server") {
+  test_utils::MockServer server;
+  RawClient client(server.port);
+
+  SUBCASE("Errors are answered at the configured rate") {
+    test_utils::MockServerSettings settings;
+    settings.error_rate = 1;
+    server.configure(settings);
+    CHECK(client.exchange(get("/i")).first == 500);
+
+    settings.error_rate = 0.5;
+    server.configure(settings);
+    for (int index = 0; index < 200; index++) {
+      client.exchange(get("/i"));
+    }
+    CHECK(server.stats().errors > 50);
+    CHECK(server.stats().errors < 150);
+  }
+
+  SUBCASE("Requests over the limit are throttled with a Retry-After") {
+    test_utils::MockServerSettings settings;
+    settings.max_requests_per_second = 2;
+    settings.retry_after = 30;
+    server.configure(settings);
+    CHECK(client.exchange(get("/i")).first == 200);
+    CHECK(client.exchange(get("/i")).first == 200);
+    CHECK(client.exchange(get("/i")).first == 429);
+    CHECK(server.stats().throttled == 1);
+    CHECK(server.stats().requests_i == 2);
+  }
+
+  SUBCASE("Answers are delayed by the latency") {
+    test_utils::MockServerSettings settings;
+    settings.latency = std::chrono::milliseconds(50);
+    server.configure(settings);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CHECK(client.exchange(get("/i")).first == 200);
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+  }
+
+  SUBCASE("Stats are reset") {
+    client.exchange(get("/i"));
+    server.reset();
+    CHECK(server.stats().requests == 0);
+    CHECK(server.requests().empty());
+  }
+}
+#endif
+
+#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
+TEST_CASE("Test the request module against the mock server") {
+  test_utils::MockServer server;
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("app-key", server.host());
+  configuration->port = server.port;
+  configuration->retryBaseDelay = 10;
+  configuration->retryMaxDelay = 20;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+  storageModule->init();
+  std::shared_ptr<std::mutex> mutex = std::make_shared<std::mutex>();
+
+  SUBCASE("Queued requests are sent and removed") {
+    requestModule->addRequestToQueue({{"events", "[{\"key\":\"click\"}]"}});
+    requestModule->addRequestToQueue({{"events", "[{\"key\":\"scroll\"}]"}});
+    requestModule->processQueue(mutex);
+
+    CHECK(storageModule->RQCount() == 0);
+    const std::vector<test_utils::MockRequest> requests = server.requests();
+    REQUIRE(requests.size() == 2);
+    CHECK(requests[0].params.at("events") == "[{\"key\":\"click\"}]");
+    CHECK(requests[0].params.at("app_key") == "app-key");
+    CHECK(requests[1].params.at("events") == "[{\"key\":\"scroll\"}]");
+  }
+
+  SUBCASE("Large requests are sent with POST") {
+    requestModule->addRequestToQueue({{"events", std::string(COUNTLY_POST_THRESHOLD, 'a')}});
+    requestModule->processQueue(mutex);
+    CHECK(server.stats().post_requests == 1);
+    CHECK(storageModule->RQCount() == 0);
+  }
+
+  SUBCASE("Failed requests stay in the queue") {
+    test_utils::MockServerSettings settings;
+    settings.error_rate = 1;
+    server.configure(settings);
+    requestModule->addRequestToQueue({{"events", "[]"}});
+    requestModule->processQueue(mutex);
+    CHECK(server.stats().errors == 1);
+    CHECK(storageModule->RQCount() == 1);
+
+    settings.error_rate = 0;
+    server.configure(settings);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    requestModule->processQueue(mutex);
+    CHECK(storageModule->RQCount() == 0);
+  }
+
+  SUBCASE("Throttled requests wait for the Retry-After") {
+    test_utils::MockServerSettings settings;
+    settings.max_requests_per_second = 1;
+    settings.retry_after = 120;
+    server.configure(settings);
+    requestModule->addRequestToQueue({{"events", "1"}});
+    requestModule->addRequestToQueue({{"events", "2"}});
+    requestModule->processQueue(mutex);
+    CHECK(server.stats().throttled == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    requestModule->processQueue(mutex);
+    CHECK(server.stats().requests == 2);
+    CHECK(storageModule->RQCount() == 1);
+  }
+
+  SUBCASE("An unchanged remote config is not downloaded again") {
+    test_utils::MockServerSettings settings;
+    settings.remote_config = {{"color", "red"}};
+    server.configure(settings);
+    HTTPResponse response = requestModule->sendHTTP("/o/sdk", "method=fetch_remote_config&app_key=app-key");
+    CHECK(response.success);
+    REQUIRE_FALSE(response.etag.empty());
+
+    const std::string data = "method=fetch_remote_config&app_key=app-key";
+    HTTPResponse conditional = requestModule->sendHTTP("/o/sdk", BufferView(data), response.etag);
+    CHECK(conditional.status_code == COUNTLY_HTTP_NOT_MODIFIED);
+    CHECK(conditional.body.empty());
+    CHECK(server.stats().not_modified == 1);
+  }
+
+  SUBCASE("The remote config body is parsed") {
+    test_utils::MockServerSettings settings;
+    settings.remote_config = {{"color", "red"}};
+    server.configure(settings);
+    HTTPResponse response = requestModule->sendHTTP("/o/sdk", "method=fetch_remote_config&app_key=app-key");
+    CHECK(response.success);
+    CHECK(response.parseBody());
+    CHECK(response.data["color"] == "red");
+  }
+}
+#endif
+
+#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
+TEST_CASE("Test fetching the cached remote config conditionally") {
+  const char cache_path[] = "test-remote-config-mock.json";
+  remove(cache_path);
+  test_utils::MockServerSettings settings;
+  settings.remote_config = {{"color", "red"}, {"size", 3}};
+  test_utils::MockServer server(settings);
+
+  // starting fetches the remote config, the second start sends the entity tag of the cached one
+  for (int run = 0; run < 2; run++) {
+    test_utils::clearSDK();
+    Countly &countly = Countly::getInstance();
+    countly.setDeviceID(COUNTLY_TEST_DEVICE_ID);
+    countly.SetPath(TEST_DATABASE_NAME);
+    countly.setRemoteConfigCachePath(cache_path);
+    countly.enableRemoteConfig();
+    countly.start(COUNTLY_TEST_APP_KEY, server.host(), server.port, false);
+    if (run == 1) {
+      CHECK(countly.getRemoteConfigString("color", "") == "red");
+    }
+
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (server.stats().requests_sdk < static_cast<unsigned long long>(run + 1) && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // the response is handled right after it is sent
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(server.stats().not_modified == static_cast<unsigned long long>(run));
+    CHECK(countly.getRemoteConfigInt("size", 0) == 3);
+    countly.stop();
+  }
+
+  test_utils::clearSDK();
+  remove(cache_path);
+}
+#endif
@@ -0,0 +1,424 @@
+#ifndef COUNTLY_MOCK_SERVER_HPP_
+#define COUNTLY_MOCK_SERVER_HPP_
+
+#if !defined(_WIN32)
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace test_utils {
+struct MockRequest {
+  std::string method;
+  std::string path;
+  // parameters of the query string or the form body, decoded
+  std::map<std::string, std::string> params;
+  // 'If-None-Match' header, empty if the request had none
+  std::string if_none_match;
+  int status_code = 0;
+};
+
+/**
+ * How the mock server answers, may be changed while it runs.
+ */
+struct MockServerSettings {
+  // time the server takes to answer a request
+  std::chrono::microseconds latency{0};
+  // share of the requests answered with '500 Internal Server Error', from 0 to 1
+  double error_rate = 0;
+  // requests answered in a second before the rest are answered with '429 Too Many Requests', 0 for no limit
+  int max_requests_per_second = 0;
+  // seconds sent in the 'Retry-After' header of the 429 responses, 0 to leave the header out
+  unsigned int retry_after = 1;
+  // remote config served from '/o/sdk'
+  nlohmann::json remote_config = nlohmann::json::object();
+  // keep the parameters of every request, see 'MockServer::requests'
+  bool keep_requests = true;
+  // called on the thread of the connection with every request before it is answered
+  std::function<void(const MockRequest &)> on_request;
+};
+
+struct MockServerStats {
+  unsigned long long connections = 0;
+  unsigned long long requests = 0;
+  // requests to each endpoint, those to '/i/bulk' counted once however many requests they carry
+  unsigned long long requests_i = 0;
+  unsigned long long requests_bulk = 0;
+  unsigned long long requests_sdk = 0;
+  // requests carried by the '/i/bulk' requests
+  unsigned long long bulk_entries = 0;
+  unsigned long long get_requests = 0;
+  unsigned long long post_requests = 0;
+  unsigned long long not_found = 0;
+  unsigned long long errors = 0;
+  unsigned long long throttled = 0;
+  // conditional '/o/sdk' requests answered with '304 Not Modified'
+  unsigned long long not_modified = 0;
+  unsigned long long bytes_received = 0;
+  unsigned long long bytes_sent = 0;
+};
+
+/**
+ * HTTP/1.1 server on a local port that implements the '/i', '/i/bulk' and '/o/sdk' endpoints of a Countly server. It keeps
+ * connections alive, so the reuse of connections by a transport shows in the stats, and serves each connection on its own thread.
+ */
+class MockServer {
+private:
+  int _socket = -1;
+  std::thread _thread;
+  std::atomic<bool> _running{true};
+
+  mutable std::mutex _mutex;
+  MockServerSettings _settings;
+  MockServerStats _stats;
+  std::vector<MockRequest> _requests;
+  std::vector<int> _connections;
+  std::vector<std::thread> _connection_threads;
+  std::minstd_rand _random{42};
+  std::chrono::steady_clock::time_point _window_start = std::chrono::steady_clock::now();
+  int _window_requests = 0;
+
+  static std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char character) { return static_cast<char>(std::tolower(character)); });
+    return text;
+  }
+
+  static std::string decodeURL(const std::string &text) {
+    std::string decoded;
+    decoded.reserve(text.size());
+    for (size_t index = 0; index < text.size(); index++) {
+      if (text[index] == '%' && index + 2 < text.size()) {
+        decoded += static_cast<char>(std::strtol(text.substr(index + 1, 2).c_str(), nullptr, 16));
+        index += 2;
+      } else if (text[index] == '+') {
+        decoded += ' ';
+      } else {
+        decoded += text[index];
+      }
+    }
+    return decoded;
+  }
+
+  static std::map<std::string, std::string> parseParams(const std::string &text) {
+    std::map<std::string, std::string> params;
+    size_t start = 0;
+    while (start < text.size()) {
+      size_t end = text.find('&', start);
+      if (end == std::string::npos) {
+        end = text.size();
+      }
+      const size_t equals = text.find('=', start);
+      if (equals != std::string::npos && equals < end) {
+        params[decodeURL(text.substr(start, equals - start))] = decodeURL(text.substr(equals + 1, end - equals - 1));
+      } else if (end > start) {
+        params[decodeURL(text.substr(start, end - start))] = "";
+      }
+      start = end + 1;
+    }
+    return params;
+  }
+
+  /**
+   * Value of a header, found case-insensitively by its lowercase name in the lowercased copy of the headers.
+   */
+  static std::string header(const std::string &lowercase_headers, const std::string &headers, const std::string &name) {
+    const size_t position = lowercase_headers.find("\r\n" + name + ":");
+    if (position == std::string::npos) {
+      return "";
+    }
+
+    size_t start = position + name.size() + 3;
+    const size_t end = lowercase_headers.find("\r\n", start);
+    while (start < end && headers[start] == ' ') {
+      start++;
+    }
+    return headers.substr(start, end - start);
+  }
+
+  /**
+   * Entity tag of a response body, changes with the body.
+   */
+  static std::string etagOf(const std::string &body) {
+    char etag[24];
+    std::snprintf(etag, sizeof(etag), "\"%zx\"", std::hash<std::string>()(body));
+    return etag;
+  }
+
+  /**
+   * Decide the status and body of the response to a request and record it in the stats.
+   */
+  std::string answer(MockRequest &request, std::chrono::microseconds &latency, std::function<void(const MockRequest &)> &on_request) {
+    std::string body;
+    std::string extra_headers;
+    std::lock_guard<std::mutex> lock(_mutex);
+    latency = _settings.latency;
+    on_request = _settings.on_request;
+    _stats.requests++;
+    (request.method == "POST" ? _stats.post_requests : _stats.get_requests)++;
+
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - _window_start >= std::chrono::seconds(1)) {
+      _window_start = now;
+      _window_requests = 0;
+    }
+    _window_requests++;
+
+    if (request.path != "/i" && request.path != "/i/bulk" && request.path != "/o/sdk") {
+      request.status_code = 404;
+      _stats.not_found++;
+    } else if (_settings.max_requests_per_second > 0 && _window_requests > _settings.max_requests_per_second) {
+      request.status_code = 429;
+      _stats.throttled++;
+      if (_settings.retry_after > 0) {
+        extra_headers = "Retry-After: " + std::to_string(_settings.retry_after) + "\r\n";
+      }
+    } else if (_settings.error_rate > 0 && std::uniform_real_distribution<double>(0, 1)(_random) < _settings.error_rate) {
+      request.status_code = 500;
+      _stats.errors++;
+    } else {
+      request.status_code = 200;
+      if (request.path == "/i") {
+        _stats.requests_i++;
+        body = "{\"result\":\"Success\"}";
+      } else if (request.path == "/i/bulk") {
+        _stats.requests_bulk++;
+        nlohmann::json entries = nlohmann::json::parse(request.params["requests"], nullptr, false);
+        _stats.bulk_entries += entries.is_array() ? entries.size() : 0;
+        body = "{\"result\":\"Success\"}";
+      } else {
+        _stats.requests_sdk++;
+        body = remoteConfig(request.params).dump();
+        const std::string etag = etagOf(body);
+        extra_headers = "ETag: " + etag + "\r\n";
+        if (request.if_none_match == etag) {
+          request.status_code = 304;
+          _stats.not_modified++;
+        }
+      }
+    }
+
+    if (_settings.keep_requests) {
+      _requests.push_back(request);
+    }
+
+    if (request.status_code == 304) {
+      body.clear();
+    } else if (body.empty()) {
+      body = "{\"result\":\"Error\"}";
+    }
+    static const std::map<int, std::string> reasons = {{200, "OK"}, {304, "Not Modified"}, {404, "Not Found"}, {429, "Too Many Requests"}, {500, "Internal Server Error"}};
+    std::string response = "HTTP/1.1 " + std::to_string(request.status_code) + " " + reasons.at(request.status_code) + "\r\n" + extra_headers +
+                           "Content-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    _stats.bytes_sent += response.size();
+    return response;
+  }
+
+  /**
+   * Remote config answered to '/o/sdk', only the values of the 'keys' or without those of 'omit_keys' when either is given.
+   */
+  nlohmann::json remoteConfig(const std::map<std::string, std::string> &params) const {
+    nlohmann::json result = _settings.remote_config;
+    auto keys = params.find("keys");
+    if (keys != params.end()) {
+      nlohmann::json wanted = nlohmann::json::parse(keys->second, nullptr, false);
+      result = nlohmann::json::object();
+      if (wanted.is_array()) {
+        for (const nlohmann::json &key : wanted) {
+          if (key.is_string() && _settings.remote_config.contains(key.get<std::string>())) {
+            result[key.get<std::string>()] = _settings.remote_config[key.get<std::string>()];
+          }
+        }
+      }
+    }
+
+    auto omit_keys = params.find("omit_keys");
+    if (omit_keys != params.end()) {
+      nlohmann::json omitted = nlohmann::json::parse(omit_keys->second, nullptr, false);
+      if (omitted.is_array()) {
+        for (const nlohmann::json &key : omitted) {
+          if (key.is_string()) {
+            result.erase(key.get<std::string>());
+          }
+        }
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Answer the requests of a connection until the client closes it or asks for it to be closed.
+   */
+  void serveConnection(int connection) {
+    std::string buffer;
+    char chunk[16384];
+    while (_running) {
+      size_t header_end;
+      ssize_t received = 0;
+      while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos && (received = recv(connection, chunk, sizeof(chunk), 0)) > 0) {
+        buffer.append(chunk, static_cast<size_t>(received));
+      }
+      if (header_end == std::string::npos) {
+        break;
+      }
+
+      const std::string headers = buffer.substr(0, header_end + 2);
+      const std::string lowercase_headers = lowercase(headers);
+      const size_t content_length = std::strtoul(header(lowercase_headers, headers, "content-length").c_str(), nullptr, 10);
+      const size_t request_size = header_end + 4 + content_length;
+      while (buffer.size() < request_size && (received = recv(connection, chunk, sizeof(chunk), 0)) > 0) {
+        buffer.append(chunk, static_cast<size_t>(received));
+      }
+      if (buffer.size() < request_size) {
+        break;
+      }
+
+      MockRequest request;
+      const size_t method_end = buffer.find(' ');
+      const size_t target_end = buffer.find(' ', method_end + 1);
+      request.method = buffer.substr(0, method_end);
+      const std::string target = buffer.substr(method_end + 1, target_end - method_end - 1);
+      const size_t query_start = target.find('?');
+      request.path = target.substr(0, query_start);
+      request.params = parseParams(query_start == std::string::npos ? "" : target.substr(query_start + 1));
+      if (content_length > 0) {
+        std::map<std::string, std::string> form = parseParams(buffer.substr(header_end + 4, content_length));
+        request.params.insert(form.begin(), form.end());
+      }
+      request.if_none_match = header(lowercase_headers, headers, "if-none-match");
+      const bool close_connection = lowercase(header(lowercase_headers, headers, "connection")) == "close";
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.bytes_received += request_size;
+      }
+      buffer.erase(0, request_size);
+
+      std::chrono::microseconds latency{0};
+      std::function<void(const MockRequest &)> on_request;
+      const std::string response = answer(request, latency, on_request);
+      if (on_request) {
+        on_request(request);
+      }
+      if (latency.count() > 0) {
+        std::this_thread::sleep_for(latency);
+      }
+      if (send(connection, response.data(), response.size(), MSG_NOSIGNAL) < 0 || close_connection) {
+        break;
+      }
+    }
+    shutdown(connection, SHUT_RDWR);
+  }
+
+  void serve() {
+    while (_running) {
+      int connection = accept(_socket, nullptr, nullptr);
+      if (connection < 0) {
+        continue;
+      }
+
+      int no_delay = 1;
+      setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_running) {
+        close(connection);
+        break;
+      }
+      _stats.connections++;
+      _connections.push_back(connection);
+      _connection_threads.emplace_back(&MockServer::serveConnection, this, connection);
+    }
+  }
+
+public:
+  int port = 0;
+
+  explicit MockServer(const MockServerSettings &settings = MockServerSettings()) : _settings(settings) {
+    _socket = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    listen(_socket, 128);
+
+    socklen_t address_size = sizeof(address);
+    getsockname(_socket, reinterpret_cast<sockaddr *>(&address), &address_size);
+    port = ntohs(address.sin_port);
+    _thread = std::thread(&MockServer::serve, this);
+  }
+
+  ~MockServer() {
+    _running = false;
+    shutdown(_socket, SHUT_RDWR);
+    close(_socket);
+    _thread.join();
+
+    // no connection is added once the accepting thread is done
+    for (int connection : _connections) {
+      shutdown(connection, SHUT_RDWR);
+    }
+    for (std::thread &thread : _connection_threads) {
+      thread.join();
+    }
+    for (int connection : _connections) {
+      close(connection);
+    }
+  }
+
+  MockServer(const MockServer &) = delete;
+  MockServer &operator=(const MockServer &) = delete;
+
+  /**
+   * URL to give the SDK as the host, the port is given separately.
+   */
+  std::string host() const { return "http://127.0.0.1"; }
+
+  void configure(const MockServerSettings &settings) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _settings = settings;
+  }
+
+  MockServerSettings settings() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _settings;
+  }
+
+  MockServerStats stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+  /**
+   * @return the requests answered so far, in the order they were answered
+   */
+  std::vector<MockRequest> requests() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _requests;
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats = MockServerStats();
+    _requests.clear();
+  }
+};
+} // namespace test_utils
+#endif
+#endif
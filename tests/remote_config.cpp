@@ -0,0 +1,220 @@
+#include "countly.hpp"
+#include "doctest.h"
+#include "test_utils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace cly;
+using namespace test_utils;
+
+#define TEST_REMOTE_CONFIG_CACHE "test-remote-config.json"
+
+static std::atomic<int> slow_fetches{0};
+
+/**
+ * HTTP client that answers remote config fetches after a delay, for fetches that are still in flight when the test goes on.
+ */
+static HTTPResponse slowSendHTTP(bool use_post, const std::string &url, const std::string &data) {
+  if (url == "/o/sdk") {
+    slow_fetches++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  return fakeSendHTTP(use_post, url, data);
+}
+
+TEST_CASE("Test reading the remote config") {
+  clearSDK();
+  Countly &countly = Countly::getInstance();
+  initCountlyWithFakeNetworking(true, countly);
+  countly.enableRemoteConfig();
+
+  SUBCASE("Missing keys give the defaults and are not added") {
+    CHECK(countly.getRemoteConfigValue("color").is_null());
+    CHECK(countly.getRemoteConfigBool("isChristmas", true));
+    CHECK(countly.getRemoteConfigInt("playerQueueTimeout", 7) == 7);
+    CHECK(countly.getRemoteConfigDouble("playerQueueTimeout", 0.5) == 0.5);
+    CHECK(countly.getRemoteConfigString("color", "blue") == "blue");
+    CHECK(countly.getRemoteConfigSnapshot()->empty());
+  }
+
+  SUBCASE("Fetched values are read with their types") {
+    std::string keys[] = {"color", "playerQueueTimeout", "isChristmas"};
+    REQUIRE(countly.updateRemoteConfigFor(keys, 3).get());
+
+    CHECK(countly.getRemoteConfigValue("color") == "#FF9900");
+    CHECK(countly.getRemoteConfigBool("isChristmas", false));
+    CHECK(countly.getRemoteConfigInt("playerQueueTimeout", 0) == 32);
+    CHECK(countly.getRemoteConfigDouble("playerQueueTimeout", 0) == 32.0);
+    CHECK(countly.getRemoteConfigString("color", "") == "#FF9900");
+
+    // values of another type give the defaults
+    CHECK(countly.getRemoteConfigInt("color", -1) == -1);
+    CHECK(countly.getRemoteConfigString("isChristmas", "no") == "no");
+    CHECK_FALSE(countly.getRemoteConfigBool("playerQueueTimeout", false));
+  }
+
+  SUBCASE("A snapshot is not changed by later fetches") {
+    std::string first_keys[] = {"color"};
+    REQUIRE(countly.updateRemoteConfigFor(first_keys, 1).get());
+    const std::shared_ptr<const nlohmann::json> snapshot = countly.getRemoteConfigSnapshot();
+
+    std::string second_keys[] = {"isChristmas"};
+    REQUIRE(countly.updateRemoteConfigFor(second_keys, 1).get());
+
+    CHECK(snapshot->size() == 1);
+    CHECK(countly.getRemoteConfigSnapshot()->size() == 2);
+    CHECK(countly.getRemoteConfigSnapshot()->at("color") == "#FF9900");
+    CHECK(countly.getRemoteConfigSnapshot()->at("isChristmas") == true);
+  }
+
+  SUBCASE("Values are read while they are fetched") {
+    std::atomic<bool> running{true};
+    std::atomic<long long> unexpected{0};
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 4; reader++) {
+      readers.emplace_back([&countly, &running, &unexpected]() {
+        while (running) {
+          const long long value = countly.getRemoteConfigInt("playerQueueTimeout", 0);
+          if (value != 0 && value != 32) {
+            unexpected++;
+          }
+        }
+      });
+    }
+
+    std::string keys[] = {"playerQueueTimeout"};
+    for (int fetch = 0; fetch < 20; fetch++) {
+      CHECK(countly.updateRemoteConfigFor(keys, 1).get());
+    }
+    running = false;
+    for (std::thread &reader : readers) {
+      reader.join();
+    }
+    CHECK(unexpected == 0);
+    CHECK(countly.getRemoteConfigInt("playerQueueTimeout", 0) == 32);
+  }
+
+  countly.stop();
+}
+
+TEST_CASE("Test running remote config fetches") {
+  clearSDK();
+  Countly &countly = Countly::getInstance();
+  countly.setHTTPClient(slowSendHTTP);
+  countly.setDeviceID(COUNTLY_TEST_DEVICE_ID);
+  countly.SetPath(TEST_DATABASE_NAME);
+  countly.start(COUNTLY_TEST_APP_KEY, COUNTLY_TEST_HOST, COUNTLY_TEST_PORT, false);
+  countly.enableRemoteConfig();
+  slow_fetches = 0;
+  std::string keys[] = {"color"};
+  std::string other_keys[] = {"isChristmas"};
+
+  SUBCASE("Fetches of the same keys are coalesced while in flight") {
+    std::vector<std::shared_future<bool>> fetches;
+    for (int fetch = 0; fetch < 10; fetch++) {
+      fetches.push_back(countly.updateRemoteConfigFor(keys, 1));
+    }
+    std::shared_future<bool> other = countly.updateRemoteConfigFor(other_keys, 1);
+    for (std::shared_future<bool> &fetch : fetches) {
+      CHECK(fetch.get());
+    }
+    CHECK(other.get());
+    CHECK(slow_fetches == 2);
+    CHECK(countly.getRemoteConfigString("color", "") == "#FF9900");
+    CHECK(countly.getRemoteConfigBool("isChristmas", false));
+  }
+
+  SUBCASE("Pending fetches are dropped on stop") {
+    std::shared_future<bool> running = countly.updateRemoteConfigFor(keys, 1);
+    std::shared_future<bool> pending = countly.updateRemoteConfigFor(other_keys, 1);
+    countly.stop();
+
+    // nothing is left running after 'stop'
+    CHECK(running.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    CHECK(pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    CHECK_FALSE(pending.get());
+    CHECK(slow_fetches <= 1);
+    CHECK_FALSE(countly.getRemoteConfigBool("isChristmas", false));
+  }
+
+  countly.stop();
+}
+
+TEST_CASE("Test the remote config cache file") {
+  remove(TEST_REMOTE_CONFIG_CACHE);
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("app-key", COUNTLY_TEST_HOST);
+  configuration->remoteConfigCachePath = TEST_REMOTE_CONFIG_CACHE;
+  RemoteConfigCache cache(configuration, logger);
+  nlohmann::json values;
+  std::string etag;
+
+  SUBCASE("Nothing is loaded without a file") { CHECK_FALSE(cache.load("device", values, etag)); }
+
+  SUBCASE("The values and the entity tag are loaded for the same device") {
+    REQUIRE(cache.save({{"color", "red"}}, "\"v1\"", "device"));
+    CHECK(cache.load("device", values, etag));
+    CHECK(values == nlohmann::json({{"color", "red"}}));
+    CHECK(etag == "\"v1\"");
+  }
+
+  SUBCASE("The cache of another device is not loaded") {
+    REQUIRE(cache.save({{"color", "red"}}, "\"v1\"", "device"));
+    CHECK_FALSE(cache.load("other-device", values, etag));
+    CHECK(values.is_null());
+    CHECK(etag.empty());
+  }
+
+  SUBCASE("An invalid file is not loaded") {
+    std::ofstream file(TEST_REMOTE_CONFIG_CACHE);
+    file << "{\"version\": 1, \"values\": [";
+    file.close();
+    CHECK_FALSE(cache.load("device", values, etag));
+  }
+
+  remove(TEST_REMOTE_CONFIG_CACHE);
+}
+
+TEST_CASE("Test reading the cached remote config on start") {
+  remove(TEST_REMOTE_CONFIG_CACHE);
+  clearSDK();
+  {
+    Countly &countly = Countly::getInstance();
+    countly.setRemoteConfigCachePath(TEST_REMOTE_CONFIG_CACHE);
+    initCountlyWithFakeNetworking(true, countly);
+    countly.enableRemoteConfig();
+    std::string keys[] = {"color", "isChristmas"};
+    REQUIRE(countly.updateRemoteConfigFor(keys, 2).get());
+    countly.stop();
+  }
+
+  SUBCASE("The values are there before any fetch") {
+    clearSDK();
+    Countly &countly = Countly::getInstance();
+    countly.setRemoteConfigCachePath(TEST_REMOTE_CONFIG_CACHE);
+    initCountlyWithFakeNetworking(true, countly);
+    CHECK(countly.getRemoteConfigString("color", "") == "#FF9900");
+    CHECK(countly.getRemoteConfigBool("isChristmas", false));
+    countly.stop();
+  }
+
+  SUBCASE("Another device starts without them") {
+    clearSDK();
+    Countly &countly = Countly::getInstance();
+    countly.setRemoteConfigCachePath(TEST_REMOTE_CONFIG_CACHE);
+    countly.setHTTPClient(fakeSendHTTP);
+    countly.setDeviceID("another-device");
+    countly.SetPath(TEST_DATABASE_NAME);
+    countly.start(COUNTLY_TEST_APP_KEY, COUNTLY_TEST_HOST, COUNTLY_TEST_PORT, false);
+    CHECK(countly.getRemoteConfigSnapshot()->empty());
+    countly.stop();
+  }
+
+  clearSDK();
+  remove(TEST_REMOTE_CONFIG_CACHE);
+}
@@ -1,11 +1,13 @@
 #include "countly/storage_module_base.hpp"
 #include "countly/storage_module_db.hpp"
 #include "countly/storage_module_memory.hpp"
+#include "countly/storage_module_tiered.hpp"
 #include "test_utils.hpp"
 
 #include "doctest.h"
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 using namespace cly;
 using namespace std;
@@ -45,6 +47,272 @@ void ValidateRequestSizeOnReachingThresholdLimit(std::shared_ptr<StorageModuleBa
   CHECK(frontRequest->getData().substr(0, 33) == "app_key=&device_id=&param2=value2");
 }
 
+/**
+ * Validate request queue byte limit.
+ * Result: The oldest requests are dropped to keep the queue under the limit, requests bigger than the limit are not added.
+ * @param *storageModule: a pointer to the storage module.
+ * @param *requestModule: a pointer to the request module.
+ * @param *configuration: configuration shared with the request module.
+ */
+void ValidateRequestBytesOnReachingByteLimit(std::shared_ptr<StorageModuleBase> storageModule, std::shared_ptr<RequestModule> requestModule, std::shared_ptr<CountlyConfiguration> configuration) {
+  configuration->requestQueueThreshold = 100;
+
+  std::map<std::string, std::string> data = {{"param1", "value1"}};
+  requestModule->addRequestToQueue(data);
+  const long long requestBytes = requestModule->RQBytes();
+  CHECK(requestBytes > 0);
+
+  // room for two requests of this size
+  configuration->requestQueueMaxBytes = static_cast<size_t>(requestBytes * 2 + requestBytes / 2);
+
+  data = {{"param2", "value2"}};
+  requestModule->addRequestToQueue(data);
+  CHECK(storageModule->RQCount() == 2);
+
+  data = {{"param3", "value3"}};
+  requestModule->addRequestToQueue(data);
+  CHECK(storageModule->RQCount() == 2);
+  CHECK(requestModule->RQBytes() <= static_cast<long long>(configuration->requestQueueMaxBytes));
+  CHECK(storageModule->RQPeekFront()->getData().substr(0, 33) == "app_key=&device_id=&param2=value2");
+
+  // a request that can never fit is dropped instead of the queued ones
+  data = {{"param4", std::string(configuration->requestQueueMaxBytes, 'x')}};
+  requestModule->addRequestToQueue(data);
+  CHECK(storageModule->RQCount() == 2);
+  CHECK(storageModule->RQPeekFront()->getData().substr(0, 33) == "app_key=&device_id=&param2=value2");
+}
+
+/**
+ * Validate dropping requests by class when the request queue is full.
+ * Result: The oldest requests of the least important class are dropped first, requests are never dropped for less important ones.
+ * @param *storageModule: a pointer to the storage module.
+ * @param *requestModule: a pointer to the request module.
+ */
+void ValidateEvictionByRequestClass(std::shared_ptr<StorageModuleBase> storageModule, std::shared_ptr<RequestModule> requestModule) {
+  requestModule->addRequestToQueue({{"begin_session", "1"}});
+  requestModule->addRequestToQueue({{"events", "1"}});
+  requestModule->addRequestToQueue({{"events", "2"}});
+
+  // the oldest event makes room for a crash
+  requestModule->addRequestToQueue({{"crash", "1"}});
+  CHECK(storageModule->RQCount() == 3);
+  CHECK(storageModule->RQCount(RequestClass::CRASH) == 1);
+  CHECK(storageModule->RQCount(RequestClass::EVENTS) == 1);
+  CHECK(storageModule->RQPeekFront(RequestClass::EVENTS)->getData().find("events=2") != std::string::npos);
+
+  requestModule->addRequestToQueue({{"end_session", "1"}});
+  CHECK(storageModule->RQCount(RequestClass::SESSION) == 2);
+  CHECK(storageModule->RQCount(RequestClass::EVENTS) == 0);
+
+  // nothing is dropped for an event while only more important requests are queued
+  requestModule->addRequestToQueue({{"events", "3"}});
+  CHECK(storageModule->RQCount() == 3);
+  CHECK(storageModule->RQCount(RequestClass::EVENTS) == 0);
+
+  // a crash is dropped for a session request, then sessions are dropped oldest first
+  requestModule->addRequestToQueue({{"session_duration", "60"}});
+  CHECK(storageModule->RQCount(RequestClass::SESSION) == 3);
+  CHECK(storageModule->RQCount(RequestClass::CRASH) == 0);
+  requestModule->addRequestToQueue({{"begin_session", "1"}, {"timestamp", "2"}});
+  CHECK(storageModule->RQCount(RequestClass::SESSION) == 3);
+  CHECK(storageModule->RQPeekFront(RequestClass::SESSION)->getData().find("end_session=1") != std::string::npos);
+}
+
+static std::vector<std::string> sentRequests;
+static HTTPResponse queueingClient(bool use_post, const std::string &url, const std::string &data) {
+  sentRequests.push_back(data);
+  return HTTPResponse{true, nlohmann::json::object()};
+}
+
+TEST_CASE("Test classifying requests") {
+  CHECK(classifyRequest(std::string("app_key=a&begin_session=1")) == RequestClass::SESSION);
+  CHECK(classifyRequest(std::string("end_session=1&user_details=%7B%7D")) == RequestClass::SESSION);
+  CHECK(classifyRequest(std::string("app_key=a&crash=%7B%7D&device_id=b")) == RequestClass::CRASH);
+  CHECK(classifyRequest(std::string("app_key=a&city=Tallinn&device_id=b")) == RequestClass::USER_DETAILS);
+  CHECK(classifyRequest(std::string("app_key=a&old_device_id=c")) == RequestClass::EVENTS);
+  // keys have to match as a whole, values are not looked at
+  CHECK(classifyRequest(std::string("app_key=a&crash_count=1&events=crash")) == RequestClass::EVENTS);
+  CHECK(classifyRequest(std::string("crash")) == RequestClass::CRASH);
+  CHECK(classifyRequest(std::string("")) == RequestClass::EVENTS);
+}
+
+TEST_CASE("Test sending requests by class") {
+  test_utils::clearSDK();
+  sentRequests.clear();
+  shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->http_client_function = queueingClient;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+  storageModule->init();
+
+  for (int i = 0; i < 20; i++) {
+    requestModule->addRequestToQueue({{"events", std::to_string(i)}});
+  }
+  requestModule->addRequestToQueue({{"crash", "1"}});
+  requestModule->addRequestToQueue({{"begin_session", "1"}});
+  requestModule->addRequestToQueue({{"user_details", "1"}});
+
+  requestModule->processQueue(std::make_shared<std::mutex>());
+  REQUIRE(sentRequests.size() == 23);
+  CHECK(sentRequests.at(0).find("begin_session=1") != std::string::npos);
+  CHECK(sentRequests.at(1).find("crash=1") != std::string::npos);
+  CHECK(sentRequests.at(2).find("user_details=1") != std::string::npos);
+
+  // events keep their order behind the more important requests
+  for (int i = 0; i < 20; i++) {
+    CHECK(sentRequests.at(3 + i).find("events=" + std::to_string(i)) != std::string::npos);
+  }
+
+  SUBCASE("A backlog of events does not starve and is interleaved with new session requests") {
+    sentRequests.clear();
+    for (int i = 0; i < 20; i++) {
+      requestModule->addRequestToQueue({{"events", std::to_string(i)}});
+      requestModule->addRequestToQueue({{"session_duration", std::to_string(i)}});
+    }
+
+    requestModule->processQueue(std::make_shared<std::mutex>());
+    REQUIRE(sentRequests.size() == 40);
+    // every round sends up to eight session requests and one event
+    CHECK(sentRequests.at(0).find("session_duration=") != std::string::npos);
+    CHECK(sentRequests.at(8).find("events=0") != std::string::npos);
+    CHECK(sentRequests.at(17).find("events=1") != std::string::npos);
+    CHECK(sentRequests.back().find("events=19") != std::string::npos);
+  }
+}
+
+static HTTPResponse successClient(bool use_post, const std::string &url, const std::string &data) { return HTTPResponse{true, nlohmann::json::object()}; }
+
+TEST_CASE("Test that sending requests in a steady loop does not allocate arena chunks") {
+  test_utils::clearSDK();
+  shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->http_client_function = successClient;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+  storageModule->init();
+  std::shared_ptr<std::mutex> mutex = std::make_shared<std::mutex>();
+
+  requestModule->addRequestToQueue({{"events", "0"}});
+  requestModule->processQueue(mutex);
+
+  const unsigned long long large_allocations = test_utils::large_allocation_count.load();
+  for (int i = 1; i <= 1000; i++) {
+    requestModule->addRequestToQueue({{"events", std::to_string(i)}});
+    requestModule->processQueue(mutex);
+  }
+  CHECK(storageModule->RQCount() == 0);
+  CHECK(test_utils::large_allocation_count.load() - large_allocations == 0);
+}
+
+static std::chrono::milliseconds clientLatency(0);
+static int slowClientCalls = 0;
+static HTTPResponse slowClient(bool use_post, const std::string &url, const std::string &data) {
+  slowClientCalls++;
+  std::this_thread::sleep_for(clientLatency);
+  return HTTPResponse{true, nlohmann::json::object()};
+}
+
+TEST_CASE("Test sizing the processing batch to a time budget") {
+  test_utils::clearSDK();
+  slowClientCalls = 0;
+  clientLatency = std::chrono::milliseconds(0);
+  shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->http_client_function = slowClient;
+  configuration->maxProcessingBatchSize = 50;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+  storageModule->init();
+  for (int i = 0; i < 200; i++) {
+    requestModule->addRequestToQueue({{"events", std::to_string(i)}});
+  }
+
+  SUBCASE("Without a time budget the max batch size is sent") {
+    CHECK(requestModule->getProcessingBatchSize() == 50);
+    requestModule->processQueue(std::make_shared<std::mutex>());
+    CHECK(slowClientCalls == 50);
+    CHECK(requestModule->getAverageLatency() > 0);
+  }
+
+  SUBCASE("The min batch size is sent until the latency is known") {
+    configuration->processingTimeBudget = 100;
+    configuration->minProcessingBatchSize = 2;
+    CHECK(requestModule->getProcessingBatchSize() == 2);
+    requestModule->processQueue(std::make_shared<std::mutex>());
+    CHECK(slowClientCalls == 2);
+  }
+
+  SUBCASE("A fast connection sends up to the max batch size") {
+    configuration->processingTimeBudget = 1000;
+    configuration->minProcessingBatchSize = 2;
+    requestModule->sendHTTP("/i", "data");
+    CHECK(requestModule->getProcessingBatchSize() == 50);
+  }
+
+  SUBCASE("A slow connection sends fewer requests, but not fewer than the min batch size") {
+    configuration->processingTimeBudget = 100;
+    configuration->minProcessingBatchSize = 2;
+    clientLatency = std::chrono::milliseconds(20);
+    requestModule->sendHTTP("/i", "data");
+    const long long averageLatency = requestModule->getAverageLatency();
+    CHECK(averageLatency >= 20000);
+    CHECK(requestModule->getProcessingBatchSize() == std::max(2LL, 100000 / averageLatency));
+
+    slowClientCalls = 0;
+    requestModule->processQueue(std::make_shared<std::mutex>());
+    CHECK(slowClientCalls <= 5);
+    CHECK(slowClientCalls >= 2);
+
+    // the average follows a slower connection
+    clientLatency = std::chrono::milliseconds(200);
+    requestModule->sendHTTP("/i", "data");
+    CHECK(requestModule->getProcessingBatchSize() == 2);
+  }
+}
+
+static std::string lastSentData;
+static HTTPResponse recordingClient(bool use_post, const std::string &url, const std::string &data) {
+  lastSentData = data;
+  return HTTPResponse{true, nlohmann::json::object()};
+}
+
+TEST_CASE("Test sending a request from a buffer view") {
+  test_utils::clearSDK();
+  shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->http_client_function = recordingClient;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+
+  SUBCASE("Data is sent as it is without a salt") {
+    std::string data = "hello world";
+    CHECK(requestModule->sendHTTP("/i", BufferView(data)).success);
+    CHECK(lastSentData == "hello world");
+  }
+
+  SUBCASE("Checksum is appended the same way for views and strings") {
+    configuration->salt = "test-salt";
+    std::string data = "hello world";
+    requestModule->sendHTTP("/i", BufferView(data));
+    std::string sentFromView = lastSentData;
+    requestModule->sendHTTP("/i", data);
+    CHECK(sentFromView == lastSentData);
+    CHECK(data == "hello world");
+#ifndef COUNTLY_USE_CUSTOM_SHA256
+    CHECK(sentFromView == "hello world&checksum256=aaf992c81357b0ed1bb404826e01825568126ebeb004c3bc690d3d8e0766a3cc");
+#endif
+  }
+}
+
 TEST_CASE("Test Request Module with Memory Storage") {
   test_utils::clearSDK();
   shared_ptr<cly::LoggerModule> logger;
@@ -63,6 +331,8 @@ TEST_CASE("Test Request Module with Memory Storage") {
   storageModule->init();
 
   SUBCASE("Validate request queue threshold") { ValidateRequestSizeOnReachingThresholdLimit(storageModule, requestModule); }
+  SUBCASE("Validate request queue byte limit") { ValidateRequestBytesOnReachingByteLimit(storageModule, requestModule, configuration); }
+  SUBCASE("Validate dropping requests by class") { ValidateEvictionByRequestClass(storageModule, requestModule); }
 }
 
 #ifdef COUNTLY_USE_SQLITE
@@ -82,5 +352,39 @@ TEST_CASE("Test Request Module with SQLite Storage") {
   storageModule->init();
 
   SUBCASE("Validate request queue threshold") { ValidateRequestSizeOnReachingThresholdLimit(storageModule, requestModule); }
+  SUBCASE("Validate request queue byte limit") { ValidateRequestBytesOnReachingByteLimit(storageModule, requestModule, configuration); }
+  SUBCASE("Validate dropping requests by class") { ValidateEvictionByRequestClass(storageModule, requestModule); }
+}
+
+TEST_CASE("Test sending requests persisted in front of spilled ones after a restart") {
+  test_utils::clearSDK();
+  sentRequests.clear();
+  shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->databasePath = TEST_DATABASE_NAME;
+  configuration->http_client_function = queueingClient;
+  // fits two of the 8 byte requests below, the others are spilled to the database
+  configuration->requestQueueMemoryWatermark = 20;
+
+  {
+    std::shared_ptr<StorageModuleTiered> storageModule = std::make_shared<StorageModuleTiered>(configuration, logger);
+    storageModule->init();
+    for (int i = 1; i <= 5; i++) {
+      storageModule->RQInsertAtEnd("events=" + std::to_string(i));
+    }
+    storageModule->persist();
+  }
+
+  std::shared_ptr<StorageModuleTiered> storageModule = std::make_shared<StorageModuleTiered>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+  storageModule->init();
+  requestModule->processQueue(std::make_shared<std::mutex>());
+
+  CHECK(storageModule->RQCount() == 0);
+  REQUIRE(sentRequests.size() == 5);
+  for (int i = 1; i <= 5; i++) {
+    CHECK(sentRequests.at(i - 1).find("events=" + std::to_string(i)) != std::string::npos);
+  }
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "countly/retry_policy.hpp"
+#include "countly/storage_module_memory.hpp"
+#include "stub_server.hpp"
+#include "test_utils.hpp"
+
+#include "doctest.h"
+#include <chrono>
+#include <string>
+#include <thread>
+using namespace cly;
+
+static HTTPResponse failedResponse(int statusCode, unsigned int retryAfter) {
+  HTTPResponse response{false, nlohmann::json::object()};
+  response.status_code = statusCode;
+  response.retry_after = retryAfter;
+  return response;
+}
+
+TEST_CASE("Test the retry policy") {
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->retryBaseDelay = 1000;
+  configuration->retryMaxDelay = 60000;
+  configuration->circuitBreakerThreshold = 3;
+
+  RetryPolicy policy(configuration, logger);
+  const RetryPolicy::Clock::time_point start = RetryPolicy::Clock::now();
+  CHECK(policy.canSend(start));
+  CHECK(policy.getState() == CircuitState::CLOSED);
+
+  SUBCASE("Delays grow with jitter between the base and the max delay") {
+    std::chrono::milliseconds previousDelay(configuration->retryBaseDelay);
+    for (int i = 0; i < 2; i++) {
+      policy.onFailure(failedResponse(500, 0), start);
+      const std::chrono::milliseconds delay = std::chrono::duration_cast<std::chrono::milliseconds>(policy.getNextAttempt() - start);
+      CHECK(delay.count() >= 1000);
+      CHECK(delay.count() <= previousDelay.count() * 3);
+      previousDelay = delay;
+    }
+
+    configuration->circuitBreakerThreshold = 0;
+    for (int i = 0; i < 50; i++) {
+      policy.onFailure(failedResponse(500, 0), start);
+      CHECK(policy.getNextAttempt() - start <= std::chrono::milliseconds(60000));
+    }
+
+    policy.onSuccess();
+    CHECK(policy.getConsecutiveFailures() == 0);
+    policy.onFailure(failedResponse(500, 0), start);
+    CHECK(policy.getNextAttempt() - start <= std::chrono::milliseconds(3000));
+  }
+
+  SUBCASE("Nothing is sent before the next attempt") {
+    policy.onFailure(failedResponse(0, 0), start);
+    CHECK_FALSE(policy.canSend(start));
+    CHECK_FALSE(policy.canSend(policy.getNextAttempt() - std::chrono::milliseconds(1)));
+    CHECK(policy.canSend(policy.getNextAttempt()));
+    CHECK(policy.getState() == CircuitState::CLOSED);
+  }
+
+  SUBCASE("The circuit opens after failures in a row and closes once a probe gets through") {
+    for (int i = 0; i < 3; i++) {
+      policy.onFailure(failedResponse(0, 0), start);
+    }
+    CHECK(policy.getState() == CircuitState::OPEN);
+    CHECK_FALSE(policy.canSend(start));
+
+    CHECK(policy.canSend(policy.getNextAttempt()));
+    CHECK(policy.getState() == CircuitState::HALF_OPEN);
+
+    // a failed probe opens the circuit again
+    const RetryPolicy::Clock::time_point probeTime = policy.getNextAttempt();
+    policy.onFailure(failedResponse(0, 0), probeTime);
+    CHECK(policy.getState() == CircuitState::OPEN);
+    CHECK_FALSE(policy.canSend(probeTime));
+
+    CHECK(policy.canSend(policy.getNextAttempt()));
+    policy.onSuccess();
+    CHECK(policy.getState() == CircuitState::CLOSED);
+    CHECK(policy.canSend(start));
+  }
+
+  SUBCASE("Retry-After is honored for 429 and 503 responses") {
+    policy.onFailure(failedResponse(503, 120), start);
+    CHECK(policy.getNextAttempt() - start == std::chrono::seconds(120));
+
+    policy.onFailure(failedResponse(429, 90), start);
+    CHECK(policy.getNextAttempt() - start == std::chrono::seconds(90));
+
+    // other responses back off as usual
+    policy.onSuccess();
+    policy.onFailure(failedResponse(500, 120), start);
+    CHECK(policy.getNextAttempt() - start <= std::chrono::milliseconds(3000));
+  }
+}
+
+#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
+TEST_CASE("Test backing off from a server that is down") {
+  test_utils::clearSDK();
+  test_utils::StubServer server("503 Service Unavailable", "Retry-After: 120\r\n");
+
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("app-key", "http://127.0.0.1");
+  configuration->port = server.port;
+  configuration->retryBaseDelay = 10;
+  configuration->retryMaxDelay = 20;
+  configuration->circuitBreakerThreshold = 1;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+  storageModule->init();
+
+  SUBCASE("Status and Retry-After are read from the response") {
+    HTTPResponse response = requestModule->sendHTTP("/i", "app_key=app-key");
+    CHECK_FALSE(response.success);
+    CHECK(response.status_code == 503);
+    CHECK(response.retry_after == 120);
+  }
+
+  SUBCASE("Retry-After given as a date is read as seconds from now") {
+    server.response = "HTTP/1.1 429 Too Many Requests\r\nRetry-After: Fri, 31 Dec 2100 23:59:59 GMT\r\nContent-Length: 2\r\nConnection: close\r\n\r\n{}";
+    HTTPResponse response = requestModule->sendHTTP("/i", "app_key=app-key");
+    CHECK(response.status_code == 429);
+    CHECK(response.retry_after > 3600);
+  }
+
+  SUBCASE("The queue is not sent again before the server allows it") {
+    requestModule->addRequestToQueue({{"events", "1"}});
+    std::shared_ptr<std::mutex> mutex = std::make_shared<std::mutex>();
+    requestModule->processQueue(mutex);
+    CHECK(server.requestCount == 1);
+    CHECK(requestModule->getCircuitState() == CircuitState::OPEN);
+
+    // the backoff alone would have passed, the Retry-After has not
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    requestModule->processQueue(mutex);
+    requestModule->processQueue(mutex);
+    CHECK(server.requestCount == 1);
+    CHECK(storageModule->RQCount() == 1);
+  }
+}
+#endif
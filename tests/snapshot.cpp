@@ -0,0 +1,106 @@
+#include "countly/queue_snapshot.hpp"
+#include "countly/storage_module_memory.hpp"
+#include "test_utils.hpp"
+
+#include "doctest.h"
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace cly;
+using namespace test_utils;
+
+#ifndef COUNTLY_USE_SQLITE
+#define TEST_SNAPSHOT_NAME "test-countly.snapshot"
+
+TEST_CASE("Test saving and restoring a queue snapshot") {
+  clearSDK();
+  remove(TEST_SNAPSHOT_NAME);
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->queueSnapshotPath = TEST_SNAPSHOT_NAME;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  storageModule->init();
+  storageModule->RQInsertAtEnd("request 1");
+  storageModule->RQInsertAtEnd(std::string(100000, 'r'));
+  const std::deque<std::string> events = {"{\"key\":\"event 1\"}", "{\"key\":\"event 2\"}"};
+
+  QueueSnapshot snapshot(configuration, logger);
+  REQUIRE(snapshot.save(events, *storageModule));
+
+  std::vector<std::string> restoredEvents;
+  std::shared_ptr<StorageModuleMemory> restoredStorage = std::make_shared<StorageModuleMemory>(configuration, logger);
+  restoredStorage->init();
+  const QueueSnapshot::RecordVisitor restoreEvent = [&restoredEvents](const BufferView &event) { restoredEvents.push_back(event.toString()); };
+  const QueueSnapshot::RecordVisitor restoreRequest = [&restoredStorage](const BufferView &request) { restoredStorage->RQInsertAtEnd(request); };
+
+  SUBCASE("Queues are restored in order and the snapshot is removed") {
+    CHECK(snapshot.load(restoreEvent, restoreRequest));
+    CHECK(restoredEvents == std::vector<std::string>(events.begin(), events.end()));
+
+    std::vector<std::shared_ptr<DataEntry>> requests = restoredStorage->RQPeekAll();
+    REQUIRE(requests.size() == 2);
+    CHECK(requests.at(0)->getData() == "request 1");
+    CHECK(requests.at(1)->getData() == std::string(100000, 'r'));
+
+    // the same queues are not restored a second time
+    CHECK_FALSE(snapshot.load(restoreEvent, restoreRequest));
+    CHECK(restoredStorage->RQCount() == 2);
+  }
+
+  SUBCASE("Only complete records are restored from a truncated snapshot") {
+    std::ifstream input(TEST_SNAPSHOT_NAME, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    input.close();
+    std::ofstream output(TEST_SNAPSHOT_NAME, std::ios::binary | std::ios::trunc);
+    output.write(content.data(), content.size() - 10);
+    output.close();
+
+    CHECK_FALSE(snapshot.load(restoreEvent, restoreRequest));
+    CHECK(restoredEvents.size() == 2);
+    CHECK(restoredStorage->RQCount() == 1);
+  }
+
+  SUBCASE("Files that are not snapshots are ignored") {
+    std::ofstream output(TEST_SNAPSHOT_NAME, std::ios::binary | std::ios::trunc);
+    output << "not a snapshot";
+    output.close();
+
+    CHECK_FALSE(snapshot.load(restoreEvent, restoreRequest));
+    CHECK(restoredEvents.empty());
+    CHECK(restoredStorage->RQCount() == 0);
+  }
+
+  remove(TEST_SNAPSHOT_NAME);
+}
+
+TEST_CASE("Test the SDK keeping its queues across a restart with a snapshot") {
+  clearSDK();
+  remove(TEST_SNAPSHOT_NAME);
+  Countly &countly = Countly::getInstance();
+  countly.setQueueSnapshotPath(TEST_SNAPSHOT_NAME);
+  initCountlyWithFakeNetworking(true, countly);
+
+  generateEvents(5, countly);
+  countly.stop();
+
+  // the end session request is queued while stopping, so it is in the snapshot too
+  clearSDK();
+  Countly &restarted = Countly::getInstance();
+  restarted.setQueueSnapshotPath(TEST_SNAPSHOT_NAME);
+  restarted.setHTTPClient(fakeSendHTTP);
+  restarted.setDeviceID(COUNTLY_TEST_DEVICE_ID);
+  restarted.start(COUNTLY_TEST_APP_KEY, COUNTLY_TEST_HOST, COUNTLY_TEST_PORT, false);
+  CHECK(restarted.checkEQSize() == 5);
+
+  restarted.processRQDebug();
+  REQUIRE(!http_call_queue.empty());
+  CHECK(http_call_queue.front().data["end_session"] == "1");
+  http_call_queue.clear();
+
+  clearSDK();
+  remove(TEST_SNAPSHOT_NAME);
+}
+#endif
@@ -1,9 +1,11 @@
 #include "countly/storage_module_base.hpp"
 #include "countly/storage_module_db.hpp"
 #include "countly/storage_module_memory.hpp"
+#include "countly/storage_module_tiered.hpp"
 #include "test_utils.hpp"
 
 #include "doctest.h"
+#include <array>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -23,6 +25,7 @@ void validateSizes(std::shared_ptr<StorageModuleBase> storageModule, long long s
  */
 void validateDataEntry(std::shared_ptr<DataEntry> testedEntry, long long id, const std::string data) {
   CHECK(testedEntry->getId() == id);
+  CHECK(testedEntry->getView().toString() == data);
   CHECK(testedEntry->getData() == data);
 }
 
@@ -474,6 +477,112 @@ void RQClearAll_WithNonEmptyQueue(std::shared_ptr<StorageModuleBase> storageModu
   CHECK(storageModule->RQPeekAll().size() == 0);
 }
 
+/**
+ * Validate method 'RQBytes' while inserting and removing requests.
+ * Result: The size is the sum of the sizes of the requests in the queue.
+ * @param *storageModule: a pointer to the storage module.
+ */
+void RQBytes_WithChangingQueue(std::shared_ptr<StorageModuleBase> storageModule) {
+  CHECK(storageModule->RQBytes() == 0);
+
+  storageModule->RQInsertAtEnd("request");
+  storageModule->RQInsertAtEnd("request 1");
+  storageModule->RQInsertAtEnd("request 22");
+  CHECK(storageModule->RQBytes() == 26);
+
+  storageModule->RQRemoveFront();
+  CHECK(storageModule->RQBytes() == 19);
+
+  // a request that is not in the queue does not change the size
+  std::shared_ptr<DataEntry> front = storageModule->RQPeekFront();
+  storageModule->RQRemoveFront(std::make_shared<DataEntry>(front->getId() + 100, "request 22"));
+  CHECK(storageModule->RQBytes() == 19);
+
+  storageModule->RQRemoveFront(front);
+  CHECK(storageModule->RQBytes() == 10);
+
+  storageModule->RQClearAll();
+  CHECK(storageModule->RQBytes() == 0);
+}
+
+/**
+ * Validate method 'RQForEach' with a limit and with a visitor that stops early.
+ * Result: Requests are visited in order and only as many as allowed.
+ * @param *storageModule: a pointer to the storage module.
+ */
+void RQForEach_WithLimitAndStop(std::shared_ptr<StorageModuleBase> storageModule) {
+  std::vector<std::string> visited;
+  const RequestVisitor collect = [&visited](long long id, const BufferView &request) {
+    visited.push_back(request.toString());
+    return true;
+  };
+
+  CHECK(storageModule->RQForEach(collect) == 0);
+  CHECK(visited.empty());
+
+  storageModule->RQInsertAtEnd("request 1");
+  storageModule->RQInsertAtEnd("request 2");
+  storageModule->RQInsertAtEnd("request 3");
+
+  CHECK(storageModule->RQForEach(collect) == 3);
+  CHECK(visited == std::vector<std::string>({"request 1", "request 2", "request 3"}));
+
+  visited.clear();
+  CHECK(storageModule->RQForEach(collect, 2) == 2);
+  CHECK(visited == std::vector<std::string>({"request 1", "request 2"}));
+
+  long long lastId = 0;
+  CHECK(storageModule->RQForEach([&lastId](long long id, const BufferView &request) {
+    lastId = id;
+    return false;
+  }) == 1);
+  CHECK(lastId == storageModule->RQPeekFront()->getId());
+  CHECK(storageModule->RQCount() == 3);
+}
+
+/**
+ * Validate the lanes of the request classes with requests of different classes.
+ * Result: Every lane keeps its requests in order, while the queue as a whole keeps the order they were inserted in.
+ * @param *storageModule: a pointer to the storage module.
+ */
+void RQLanes_WithMixedClasses(std::shared_ptr<StorageModuleBase> storageModule) {
+  storageModule->RQInsertAtEnd("app_key=a&events=1");
+  storageModule->RQInsertAtEnd("app_key=a&crash=1");
+  storageModule->RQInsertAtEnd("app_key=a&begin_session=1");
+  storageModule->RQInsertAtEnd("app_key=a&events=2");
+  storageModule->RQInsertAtEnd("app_key=a&user_details=1");
+
+  validateSizes(storageModule, 5);
+  CHECK(storageModule->RQCount(RequestClass::SESSION) == 1);
+  CHECK(storageModule->RQCount(RequestClass::CRASH) == 1);
+  CHECK(storageModule->RQCount(RequestClass::USER_DETAILS) == 1);
+  CHECK(storageModule->RQCount(RequestClass::EVENTS) == 2);
+  CHECK(storageModule->RQCountByClass() == std::array<long long, REQUEST_CLASS_COUNT>{{1, 1, 1, 2}});
+
+  std::vector<std::shared_ptr<DataEntry>> requests = storageModule->RQPeekAll();
+  validateRequestIds(requests, 1);
+  validateDataEntry(storageModule->RQPeekFront(), 1, "app_key=a&events=1");
+  validateDataEntry(storageModule->RQPeekFront(RequestClass::SESSION), 3, "app_key=a&begin_session=1");
+  validateDataEntry(storageModule->RQPeekFront(RequestClass::EVENTS), 1, "app_key=a&events=1");
+
+  // removing the front of a lane leaves the other lanes as they are
+  storageModule->RQRemoveFront(RequestClass::EVENTS);
+  validateDataEntry(storageModule->RQPeekFront(RequestClass::EVENTS), 4, "app_key=a&events=2");
+  validateDataEntry(storageModule->RQPeekFront(), 2, "app_key=a&crash=1");
+
+  storageModule->RQRemoveFront(storageModule->RQPeekFront(RequestClass::SESSION));
+  CHECK(storageModule->RQCount(RequestClass::SESSION) == 0);
+  validateDataEntry(storageModule->RQPeekFront(RequestClass::SESSION), -1, "");
+  storageModule->RQRemoveFront(RequestClass::SESSION);
+  validateSizes(storageModule, 3);
+  CHECK(storageModule->RQCountByClass() == std::array<long long, REQUEST_CLASS_COUNT>{{0, 1, 1, 1}});
+  CHECK(storageModule->RQBytes() == 17 + 18 + 24);
+
+  storageModule->RQClearAll();
+  CHECK(storageModule->RQCount(RequestClass::EVENTS) == 0);
+  validateDataEntry(storageModule->RQPeekFront(RequestClass::CRASH), -1, "");
+}
+
 TEST_CASE("Test Memory Storage Module") {
   test_utils::clearSDK();
   shared_ptr<cly::LoggerModule> logger;
@@ -509,6 +618,10 @@ TEST_CASE("Test Memory Storage Module") {
 
   SUBCASE("Validate method 'RQClearAll' when the request queue is empty.") { RQClearAll_WithEmptyQueue(storageModule); }
   SUBCASE("Validate method 'RQClearAll' when the request queue is not empty.") { RQClearAll_WithNonEmptyQueue(storageModule); }
+
+  SUBCASE("Validate method 'RQBytes' while the request queue changes.") { RQBytes_WithChangingQueue(storageModule); }
+  SUBCASE("Validate method 'RQForEach' with a limit and an early stop.") { RQForEach_WithLimitAndStop(storageModule); }
+  SUBCASE("Validate the lanes of the request classes.") { RQLanes_WithMixedClasses(storageModule); }
 }
 
 TEST_CASE("Test Memory Storage Module without calling 'init'") {
@@ -522,6 +635,81 @@ TEST_CASE("Test Memory Storage Module without calling 'init'") {
   test_utils::storageModuleNotInitialized(storageModule);
 }
 
+TEST_CASE("Test Memory Storage Module ring and arena") {
+  test_utils::clearSDK();
+  shared_ptr<cly::LoggerModule> logger(new cly::LoggerModule());
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  storageModule->init();
+
+  SUBCASE("Requests keep their order while the ring wraps around and grows") {
+    for (int i = 0; i < 100; i++) {
+      storageModule->RQInsertAtEnd("request " + std::to_string(i));
+    }
+    for (int i = 0; i < 60; i++) {
+      storageModule->RQRemoveFront();
+    }
+    for (int i = 100; i < 300; i++) {
+      storageModule->RQInsertAtEnd("request " + std::to_string(i));
+    }
+
+    std::vector<std::shared_ptr<DataEntry>> requests = storageModule->RQPeekAll();
+    REQUIRE(requests.size() == 240);
+    for (size_t i = 0; i < requests.size(); i++) {
+      CHECK(requests[i]->getData() == "request " + std::to_string(i + 60));
+      CHECK(requests[i]->getId() == static_cast<long long>(i + 61));
+    }
+  }
+
+  SUBCASE("Peeked requests stay readable after they are removed and their chunk is reused") {
+    const std::string content(30000, 'a');
+    storageModule->RQInsertAtEnd(content);
+    std::shared_ptr<DataEntry> front = storageModule->RQPeekFront();
+    storageModule->RQRemoveFront(front);
+    CHECK(storageModule->RQCount() == 0);
+
+    for (int i = 0; i < 20; i++) {
+      storageModule->RQInsertAtEnd(std::string(30000, 'b'));
+      storageModule->RQRemoveFront();
+    }
+    CHECK(front->getView().toString() == content);
+  }
+
+  SUBCASE("Inserting, peeking and removing requests in a steady loop does not allocate") {
+    const std::string request = "app_key=a&events=" + std::string(1000, 'e');
+    // the entry is held while it is removed, as it is when a sent request is removed
+    for (int i = 0; i < 10; i++) {
+      storageModule->RQInsertAtEnd(request);
+      std::shared_ptr<DataEntry> front = storageModule->RQPeekFront(RequestClass::EVENTS);
+      storageModule->RQRemoveFront(front);
+    }
+
+    const unsigned long long allocations = test_utils::allocation_count.load();
+    for (int i = 0; i < 1000; i++) {
+      storageModule->RQInsertAtEnd(request);
+      std::shared_ptr<DataEntry> front = storageModule->RQPeekFront(RequestClass::EVENTS);
+      CHECK(front->getView().size() == request.size());
+      storageModule->RQRemoveFront(front);
+    }
+    CHECK(test_utils::allocation_count.load() - allocations == 0);
+    CHECK(storageModule->RQCount() == 0);
+  }
+
+  SUBCASE("Requests larger than a chunk are stored whole") {
+    const std::string content(200000, 'c');
+    storageModule->RQInsertAtEnd("request");
+    storageModule->RQInsertAtEnd(content);
+    storageModule->RQInsertAtEnd("request 2");
+    CHECK(storageModule->RQBytes() == static_cast<long long>(content.size() + 16));
+
+    storageModule->RQRemoveFront();
+    CHECK(storageModule->RQPeekFront()->getData() == content);
+    storageModule->RQRemoveFront();
+    CHECK(storageModule->RQPeekFront()->getData() == "request 2");
+  }
+}
+
 #ifdef COUNTLY_USE_SQLITE
 TEST_CASE("Test Sqlite Storage Module") {
   test_utils::clearSDK();
@@ -559,6 +747,142 @@ TEST_CASE("Test Sqlite Storage Module") {
 
   SUBCASE("Validate method 'RQClearAll' when the request queue is empty.") { RQClearAll_WithEmptyQueue(storageModule); }
   SUBCASE("Validate method 'RQClearAll' when the request queue is not empty.") { RQClearAll_WithNonEmptyQueue(storageModule); }
+
+  SUBCASE("Validate method 'RQBytes' while the request queue changes.") { RQBytes_WithChangingQueue(storageModule); }
+  SUBCASE("Validate method 'RQForEach' with a limit and an early stop.") { RQForEach_WithLimitAndStop(storageModule); }
+  SUBCASE("Validate the lanes of the request classes.") { RQLanes_WithMixedClasses(storageModule); }
+}
+
+TEST_CASE("Test Tiered Storage Module") {
+  test_utils::clearSDK();
+  shared_ptr<cly::LoggerModule> logger;
+  logger.reset(new cly::LoggerModule());
+
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->databasePath = TEST_DATABASE_NAME;
+  configuration->requestQueueMemoryWatermark = 1024;
+
+  std::shared_ptr<StorageModuleTiered> storageModule = std::make_shared<StorageModuleTiered>(configuration, logger);
+  storageModule->init();
+
+  SUBCASE("Validate method 'RQInsertAtEnd' with invalid request") { RQInsertAtEndWithInvalidRequest(storageModule); }
+  SUBCASE("Validate method 'RQInsertAtEnd' with Valid requests") { RQInsertAtEndWithRequest(storageModule); }
+
+  SUBCASE("Validate method 'RQPeekFront' with empty queue") { RQPeekFrontWithEmpthQueue(storageModule); }
+  SUBCASE("Validate method 'RQPeekFront' after inserting multiple requests.") { RQPeekFront(storageModule); }
+
+  SUBCASE("Validate method 'RQRemoveFront' when the request queue is empty.") { RQRemoveFront_WithEmptyQueue(storageModule); }
+  SUBCASE("Validate method 'RQRemoveFront' by providing a wrong request") { RQRemoveFront_WithInvalidRequest(storageModule); }
+  SUBCASE("Validate method 'RQRemoveFront' by providing a request with a different id than the front request") { RQRemoveFront_WithRequestNotOnFront(storageModule); }
+  SUBCASE("Validate method 'RQRemoveFront' by providing a request with a different id than the front request") { RQRemoveFrontWithSameId_WithRequestNotOnFront(storageModule); }
+  SUBCASE("Validate method 'RQRemoveFront(request)' when the request queue is empty.") { RQRemoveFront2_WithEmptyQueue(storageModule); }
+  SUBCASE("Validate method 'RQRemoveFront' by providing a valid request.") { RQRemoveFront_WithRequestOnFront(storageModule); }
+  SUBCASE("Validate method 'RQRemoveFront' with an invalid request when the request queue is empty.") { RQRemoveFrontOnEmptyQueue_WithInvalidRequest(storageModule); }
+  SUBCASE("Validate method 'RQRemoveFront' by removing the same request twice.") { RQRemove_WithSameRequestTwice(storageModule); }
+  SUBCASE("Validate method 'RQRemoveFront().") { RQRemoveFrontWithoutRequestParam(storageModule); }
+
+  SUBCASE("Validate method 'RQPeekAll' with an empty queue.") { RQPeakAll_WithEmptyQueue(storageModule); }
+  SUBCASE("Validate method 'RQPeekAll' after removing the front request.") { RQPeakAll_WithRemovingFrontRequest(storageModule); }
+  SUBCASE("Validate method 'RQPeekAll' with queue front request") { RQPeakAll_WithFrontRequest(storageModule); }
+  SUBCASE("Validate method 'RQPeekAll' after calling 'RQClearAll'.") { RQPeakAll_OnNonEmptyQueueAfterClearAll(storageModule); }
+  SUBCASE("Validate method 'RQPeekAll' after clearing calling 'RQClearAll' on an empty queue.") { RQPeakAll_WithEmptyQueueAndClearAll(storageModule); }
+  SUBCASE("Validate method 'RQPeekAll' while inserting multiple requests.") { RQPeakAll_WithMultipleRequests(storageModule); }
+
+  SUBCASE("Validate method 'RQClearAll' when the request queue is empty.") { RQClearAll_WithEmptyQueue(storageModule); }
+  SUBCASE("Validate method 'RQClearAll' when the request queue is not empty.") { RQClearAll_WithNonEmptyQueue(storageModule); }
+
+  SUBCASE("Validate method 'RQBytes' while the request queue changes.") { RQBytes_WithChangingQueue(storageModule); }
+  SUBCASE("Validate method 'RQForEach' with a limit and an early stop.") { RQForEach_WithLimitAndStop(storageModule); }
+  SUBCASE("Validate the lanes of the request classes.") { RQLanes_WithMixedClasses(storageModule); }
+}
+
+TEST_CASE("Test Tiered Storage Module spilling") {
+  test_utils::clearSDK();
+  shared_ptr<cly::LoggerModule> logger;
+  logger.reset(new cly::LoggerModule());
+
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->databasePath = TEST_DATABASE_NAME;
+  // fits two of the 9 byte requests below
+  configuration->requestQueueMemoryWatermark = 20;
+
+  std::shared_ptr<StorageModuleTiered> storageModule = std::make_shared<StorageModuleTiered>(configuration, logger);
+  storageModule->init();
+
+  storageModule->RQInsertAtEnd("request 1");
+  storageModule->RQInsertAtEnd("request 2");
+  CHECK(storageModule->memoryBytes() == 18);
+  CHECK(storageModule->persistentCount() == 0);
+
+  SUBCASE("Requests over the watermark are written to the database and sent after the ones in memory") {
+    storageModule->RQInsertAtEnd("request 3");
+    storageModule->RQInsertAtEnd("request 4");
+    CHECK(storageModule->memoryBytes() == 18);
+    CHECK(storageModule->persistentCount() == 2);
+    validateSizes(storageModule, 4);
+
+    std::vector<std::shared_ptr<DataEntry>> requests = storageModule->RQPeekAll();
+    CHECK(requests.at(0)->getData() == "request 1");
+    CHECK(requests.at(1)->getData() == "request 2");
+    CHECK(requests.at(2)->getData() == "request 3");
+    CHECK(requests.at(3)->getData() == "request 4");
+
+    // the limit is shared by both tiers
+    std::vector<std::string> visited;
+    CHECK(storageModule->RQForEach([&visited](long long id, const BufferView &request) {
+      visited.push_back(request.toString());
+      return true;
+    }, 3) == 3);
+    CHECK(visited == std::vector<std::string>({"request 1", "request 2", "request 3"}));
+
+    storageModule->RQRemoveFront(storageModule->RQPeekFront());
+    storageModule->RQRemoveFront(storageModule->RQPeekFront());
+    CHECK(storageModule->memoryBytes() == 0);
+    CHECK(storageModule->RQPeekFront()->getData() == "request 3");
+
+    // while the database is not empty new requests go after the ones in it
+    storageModule->RQInsertAtEnd("request 5");
+    CHECK(storageModule->persistentCount() == 3);
+
+    storageModule->RQRemoveFront(storageModule->RQPeekFront());
+    CHECK(storageModule->RQPeekFront()->getData() == "request 4");
+    validateSizes(storageModule, 2);
+  }
+
+  SUBCASE("Requests in memory are persisted in front of the database and survive a restart") {
+    // takes the first id in the database, so the stored request moves up to make room in front of it
+    storageModule->RQInsertAtEnd("request 3");
+    storageModule->persist();
+    CHECK(storageModule->memoryBytes() == 0);
+    CHECK(storageModule->persistentCount() == 3);
+
+    std::shared_ptr<StorageModuleTiered> restartedModule = std::make_shared<StorageModuleTiered>(configuration, logger);
+    restartedModule->init();
+    validateSizes(restartedModule, 3);
+
+    std::vector<std::shared_ptr<DataEntry>> requests = restartedModule->RQPeekAll();
+    CHECK(requests.at(0)->getData() == "request 1");
+    CHECK(requests.at(1)->getData() == "request 2");
+    CHECK(requests.at(2)->getData() == "request 3");
+    // ids stay positive, '-1' means there is no request
+    validateRequestIds(requests, 1);
+  }
+
+  SUBCASE("A request peeked from memory is not removed from the database after its lane was emptied") {
+    storageModule->RQInsertAtEnd("request 3");
+    // the request in the database has the id of the one in memory
+    std::shared_ptr<DataEntry> front = storageModule->RQPeekFront(RequestClass::EVENTS);
+    CHECK(front->getId() == 1);
+    CHECK(front->getTier() == StorageTier::MEMORY);
+
+    // e.g. evicted while the request was sent
+    storageModule->RQRemoveFront(RequestClass::EVENTS);
+    storageModule->RQRemoveFront(RequestClass::EVENTS);
+    storageModule->RQRemoveFront(front);
+    validateSizes(storageModule, 1);
+    CHECK(storageModule->RQPeekFront()->getData() == "request 3");
+    CHECK(storageModule->RQPeekFront()->getTier() == StorageTier::PERSISTENT);
+  }
 }
 
 TEST_CASE("Test SQlite Storage Module without calling 'init'") {
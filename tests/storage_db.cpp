@@ -3,8 +3,14 @@
 #include "test_utils.hpp"
 
 #include "doctest.h"
+#ifdef COUNTLY_USE_SQLITE
+#include "sqlite3.h"
+#endif
+#include <chrono>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 using namespace cly;
 using namespace std;
@@ -47,4 +53,213 @@ TEST_CASE("Test Sqlite Storage Module Specific tests") {
     test_utils::storageModuleNotInitialized(storageModule);
   }
 }
-#endif
\ No newline at end of file
+
+TEST_CASE("Test Sqlite Storage Module with the persistent writer") {
+  test_utils::clearSDK();
+  shared_ptr<cly::LoggerModule> logger(new cly::LoggerModule());
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->databasePath = TEST_DATABASE_NAME;
+  configuration->persistentWriteBatchSize = 100;
+  configuration->persistentWriteMaxLatency = 5;
+
+  std::shared_ptr<PersistentWriter> writer = std::make_shared<PersistentWriter>(configuration, logger);
+  std::shared_ptr<StorageModuleDB> storageModule = std::make_shared<StorageModuleDB>(configuration, logger, writer);
+  storageModule->init();
+  writer->start();
+
+  // reads the database directly, without the writer
+  std::shared_ptr<StorageModuleDB> committedStorage = std::make_shared<StorageModuleDB>(configuration, logger);
+  committedStorage->init();
+
+  SUBCASE("Queued requests are counted and read in order") {
+    for (int i = 0; i < 10; i++) {
+      storageModule->RQInsertAtEnd("request " + std::to_string(i));
+    }
+    CHECK(storageModule->RQCount() == 10);
+
+    std::vector<std::shared_ptr<DataEntry>> requests = storageModule->RQPeekAll();
+    CHECK(requests.size() == 10);
+    CHECK(requests.at(0)->getData() == "request 0");
+    CHECK(requests.at(9)->getData() == "request 9");
+    CHECK(committedStorage->RQCount() == 10);
+
+    storageModule->RQRemoveFront(storageModule->RQPeekFront());
+    CHECK(storageModule->RQPeekFront()->getData() == "request 1");
+  }
+
+  SUBCASE("A single request is committed after the max latency") {
+    storageModule->RQInsertAtEnd("request");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CHECK(committedStorage->RQCount() == 1);
+  }
+
+  SUBCASE("Flush waits until everything is committed") {
+    storageModule->RQInsertAtEnd("request 1");
+    storageModule->RQInsertAtEnd("request 2");
+    writer->flush();
+    CHECK(writer->pendingCount("INSERT INTO Requests (RequestData, RequestClass) VALUES(?, 3);") == 0);
+    CHECK(committedStorage->RQCount() == 2);
+  }
+
+  SUBCASE("A batch that could not be committed is tried again and not counted as committed") {
+    std::vector<std::string> warnings;
+    std::mutex warnings_mutex;
+    logger->setLogger([&warnings, &warnings_mutex](LogLevel level, const std::string &message) {
+      if (level == LogLevel::WARNING) {
+        std::lock_guard<std::mutex> lock(warnings_mutex);
+        warnings.push_back(message);
+      }
+    });
+
+    // another connection keeps the database locked for longer than the writer waits for it
+    sqlite3 *database;
+    REQUIRE(sqlite3_open(TEST_DATABASE_NAME, &database) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(database, "BEGIN EXCLUSIVE;", nullptr, nullptr, nullptr) == SQLITE_OK);
+    storageModule->RQInsertAtEnd("request 1");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    CHECK(writer->pendingCount("INSERT INTO Requests (RequestData, RequestClass) VALUES(?, 3);") == 1);
+    sqlite3_exec(database, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(database);
+
+    writer->flush();
+    CHECK(writer->pendingCount("INSERT INTO Requests (RequestData, RequestClass) VALUES(?, 3);") == 0);
+    CHECK(committedStorage->RQCount() == 1);
+    CHECK(committedStorage->RQPeekFront()->getData() == "request 1");
+
+    std::lock_guard<std::mutex> lock(warnings_mutex);
+    CHECK(!warnings.empty());
+    logger->setLogger(nullptr);
+  }
+
+  SUBCASE("A batch that keeps failing is dropped so flush does not wait forever") {
+    const std::string statement = "INSERT INTO MissingTable (Data) VALUES(?);";
+    writer->write(statement, "record");
+    writer->flush();
+    CHECK(writer->pendingCount(statement) == 0);
+    CHECK(writer->droppedCount() == 1);
+
+    // records queued after the dropped batch are still committed
+    storageModule->RQInsertAtEnd("request 1");
+    writer->flush();
+    CHECK(writer->droppedCount() == 1);
+    CHECK(committedStorage->RQCount() == 1);
+  }
+
+  SUBCASE("Stopping the writer commits what is left and later writes are synchronous") {
+    storageModule->RQInsertAtEnd("request 1");
+    writer->stop();
+    CHECK(committedStorage->RQCount() == 1);
+
+    storageModule->RQInsertAtEnd("request 2");
+    CHECK(committedStorage->RQCount() == 2);
+  }
+
+  writer->stop();
+}
+
+/**
+ * Reads a pragma of the test database that returns a single number.
+ */
+static long long readDatabasePragma(const std::string &pragma) {
+  long long value = -1;
+  sqlite3 *database;
+  sqlite3_stmt *statement = nullptr;
+  if (sqlite3_open(TEST_DATABASE_NAME, &database) == SQLITE_OK && sqlite3_prepare_v2(database, ("PRAGMA " + pragma + ";").c_str(), -1, &statement, nullptr) == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW) {
+    value = sqlite3_column_int64(statement, 0);
+  }
+  sqlite3_finalize(statement);
+  sqlite3_close(database);
+  return value;
+}
+
+TEST_CASE("Test Sqlite Storage Module database vacuum") {
+  test_utils::clearSDK();
+  shared_ptr<cly::LoggerModule> logger(new cly::LoggerModule());
+  shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("", "");
+  configuration->databasePath = TEST_DATABASE_NAME;
+
+  SUBCASE("New databases free pages incrementally") {
+    std::shared_ptr<StorageModuleDB> storageModule = std::make_shared<StorageModuleDB>(configuration, logger);
+    storageModule->init();
+    CHECK(readDatabasePragma("auto_vacuum") == 2);
+  }
+
+  SUBCASE("Databases of older versions are switched to incremental vacuum") {
+    sqlite3 *database;
+    REQUIRE(sqlite3_open(TEST_DATABASE_NAME, &database) == SQLITE_OK);
+    sqlite3_exec(database, "CREATE TABLE IF NOT EXISTS Requests (RequestID INTEGER PRIMARY KEY, RequestData TEXT); INSERT INTO Requests (RequestData) VALUES('request');", nullptr, nullptr, nullptr);
+    sqlite3_close(database);
+    CHECK(readDatabasePragma("auto_vacuum") == 0);
+
+    std::shared_ptr<StorageModuleDB> storageModule = std::make_shared<StorageModuleDB>(configuration, logger);
+    storageModule->init();
+    CHECK(readDatabasePragma("auto_vacuum") == 2);
+    CHECK(storageModule->RQCount() == 1);
+    CHECK(storageModule->RQBytes() == 7);
+  }
+
+  SUBCASE("Requests of older versions are sorted into the lanes of their classes") {
+    sqlite3 *database;
+    REQUIRE(sqlite3_open(TEST_DATABASE_NAME, &database) == SQLITE_OK);
+    sqlite3_exec(database,
+                 "CREATE TABLE IF NOT EXISTS Requests (RequestID INTEGER PRIMARY KEY, RequestData TEXT); INSERT INTO Requests (RequestData) VALUES('app_key=a&events=1'); INSERT INTO Requests (RequestData) "
+                 "VALUES('app_key=a&end_session=1'); INSERT INTO Requests (RequestData) VALUES('app_key=a&crash=1');",
+                 nullptr, nullptr, nullptr);
+    sqlite3_close(database);
+
+    std::shared_ptr<StorageModuleDB> storageModule = std::make_shared<StorageModuleDB>(configuration, logger);
+    storageModule->init();
+    CHECK(storageModule->isInitialized());
+    CHECK(storageModule->RQCount() == 3);
+    CHECK(storageModule->RQCount(RequestClass::SESSION) == 1);
+    CHECK(storageModule->RQCount(RequestClass::CRASH) == 1);
+    CHECK(storageModule->RQCount(RequestClass::EVENTS) == 1);
+    CHECK(storageModule->RQPeekFront(RequestClass::SESSION)->getId() == 2);
+
+    // the column is only added once
+    std::shared_ptr<StorageModuleDB> restartedModule = std::make_shared<StorageModuleDB>(configuration, logger);
+    restartedModule->init();
+    CHECK(restartedModule->isInitialized());
+    CHECK(restartedModule->RQCount(RequestClass::SESSION) == 1);
+  }
+
+  SUBCASE("Compacting reclaims the configured number of pages") {
+    configuration->incrementalVacuumPages = 4;
+    std::shared_ptr<StorageModuleDB> storageModule = std::make_shared<StorageModuleDB>(configuration, logger);
+    storageModule->init();
+    for (int i = 0; i < 50; i++) {
+      storageModule->RQInsertAtEnd(std::string(4096, 'a'));
+    }
+    storageModule->RQClearAll();
+
+    const long long freePages = readDatabasePragma("freelist_count");
+    CHECK(freePages > 8);
+
+    storageModule->compact();
+    CHECK(readDatabasePragma("freelist_count") == freePages - 4);
+
+    configuration->incrementalVacuumPages = 0;
+    storageModule->compact();
+    CHECK(readDatabasePragma("freelist_count") == freePages - 4);
+  }
+
+  SUBCASE("Free space over the threshold is reclaimed at start") {
+    std::shared_ptr<StorageModuleDB> storageModule = std::make_shared<StorageModuleDB>(configuration, logger);
+    storageModule->init();
+    for (int i = 0; i < 50; i++) {
+      storageModule->RQInsertAtEnd(std::string(4096, 'a'));
+    }
+    storageModule->RQClearAll();
+    CHECK(readDatabasePragma("freelist_count") > 0);
+
+    // under the threshold nothing is reclaimed
+    configuration->startupVacuumThreshold = 1024 * 1024 * 1024;
+    std::make_shared<StorageModuleDB>(configuration, logger)->init();
+    CHECK(readDatabasePragma("freelist_count") > 0);
+
+    configuration->startupVacuumThreshold = 1;
+    std::make_shared<StorageModuleDB>(configuration, logger)->init();
+    CHECK(readDatabasePragma("freelist_count") == 0);
+  }
+}
+#endif
@@ -0,0 +1,103 @@
+#ifndef COUNTLY_STUB_SERVER_HPP_
+#define COUNTLY_STUB_SERVER_HPP_
+
+#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace test_utils {
+/**
+ * HTTP server on a local port that answers every request with the same response.
+ */
+class StubServer {
+private:
+  int _socket = -1;
+  std::thread _thread;
+  std::atomic<bool> _running{true};
+
+  /**
+   * Read a request up to the end of its body.
+   * @return the number of bytes received
+   */
+  static size_t receive(int connection) {
+    std::string request;
+    char buffer[4096];
+    ssize_t received;
+    size_t header_end;
+    while ((header_end = request.find("\r\n\r\n")) == std::string::npos && (received = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+      request.append(buffer, received);
+    }
+    if (header_end == std::string::npos) {
+      return request.size();
+    }
+
+    size_t content_length = 0;
+    const size_t length_position = request.find("Content-Length: ");
+    if (length_position != std::string::npos && length_position < header_end) {
+      content_length = std::strtoul(request.c_str() + length_position + 16, nullptr, 10);
+    }
+
+    const size_t request_size = header_end + 4 + content_length;
+    while (request.size() < request_size && (received = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+      request.append(buffer, received);
+    }
+    return request.size();
+  }
+
+  void serve() {
+    while (_running) {
+      int connection = accept(_socket, nullptr, nullptr);
+      if (connection < 0) {
+        continue;
+      }
+
+      receivedBytes += receive(connection);
+      requestCount++;
+      std::this_thread::sleep_for(delay);
+      send(connection, response.data(), response.size(), 0);
+      close(connection);
+    }
+  }
+
+public:
+  std::string response;
+  std::atomic<int> requestCount{0};
+  std::atomic<size_t> receivedBytes{0};
+  // time the server takes to respond
+  std::chrono::milliseconds delay{0};
+  int port = 0;
+
+  StubServer(const std::string &statusLine, const std::string &headers) {
+    response = "HTTP/1.1 " + statusLine + "\r\n" + headers + "Content-Length: 2\r\nConnection: close\r\n\r\n{}";
+
+    _socket = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    listen(_socket, 16);
+
+    socklen_t address_size = sizeof(address);
+    getsockname(_socket, reinterpret_cast<sockaddr *>(&address), &address_size);
+    port = ntohs(address.sin_port);
+    _thread = std::thread(&StubServer::serve, this);
+  }
+
+  ~StubServer() {
+    _running = false;
+    shutdown(_socket, SHUT_RDWR);
+    close(_socket);
+    _thread.join();
+  }
+};
+} // namespace test_utils
+#endif
+#endif
@@ -0,0 +1,90 @@
+#include "countly/task_executor.hpp"
+
+#include "doctest.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+using namespace cly;
+
+/**
+ * Wait until the flag is set, so that a test knows a task is running.
+ */
+static bool waitFor(const std::atomic<bool> &flag) {
+  const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!flag && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return flag;
+}
+
+TEST_CASE("Test the task executor") {
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  TaskExecutor executor(logger);
+  std::atomic<int> runs{0};
+  std::atomic<bool> started{false};
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  // runs until the test releases it
+  TaskExecutor::Task blocking = [&runs, &started, released]() {
+    runs++;
+    started = true;
+    released.wait();
+    return true;
+  };
+
+  SUBCASE("The future gives the result of the task") {
+    CHECK(executor.submit("succeeds", []() { return true; }).get());
+    CHECK_FALSE(executor.submit("fails", []() { return false; }).get());
+    CHECK_FALSE(executor.submit("throws", []() -> bool { throw std::runtime_error("failure"); }).get());
+  }
+
+  SUBCASE("Tasks with the same key are coalesced while in flight") {
+    std::shared_future<bool> running = executor.submit("fetch", blocking);
+    REQUIRE(waitFor(started));
+    std::shared_future<bool> joined = executor.submit("fetch", blocking);
+    std::shared_future<bool> other = executor.submit("other", []() { return false; });
+    release.set_value();
+
+    CHECK(running.get());
+    CHECK(joined.get());
+    CHECK_FALSE(other.get());
+    CHECK(runs == 1);
+
+    // a task submitted after the first is done is run again
+    CHECK(executor.submit("fetch", blocking).get());
+    CHECK(runs == 2);
+  }
+
+  SUBCASE("Queued tasks are cancelled and the running one is waited for") {
+    std::shared_future<bool> running = executor.submit("fetch", blocking);
+    REQUIRE(waitFor(started));
+    std::atomic<bool> queued_ran{false};
+    std::shared_future<bool> queued = executor.submit("queued", [&queued_ran]() {
+      queued_ran = true;
+      return true;
+    });
+
+    std::thread stopper([&executor]() { executor.stop(); });
+    CHECK_FALSE(queued.get());
+    release.set_value();
+    stopper.join();
+
+    CHECK(running.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    CHECK(running.get());
+    CHECK_FALSE(queued_ran);
+
+    // the executor starts again for later tasks
+    CHECK(executor.submit("queued", []() { return true; }).get());
+  }
+
+  SUBCASE("Pending tasks are dropped without stopping") {
+    std::shared_future<bool> running = executor.submit("fetch", blocking);
+    REQUIRE(waitFor(started));
+    std::shared_future<bool> queued = executor.submit("queued", []() { return true; });
+    executor.cancelPending();
+    CHECK_FALSE(queued.get());
+    release.set_value();
+    CHECK(running.get());
+  }
+}
@@ -4,6 +4,7 @@
 #include "countly.hpp"
 #include "doctest.h"
 #include "nlohmann/json.hpp"
+#include <atomic>
 #include <cstdio>
 
 using namespace cly;
@@ -23,6 +24,14 @@ struct HTTPCall {
 
 static std::deque<HTTPCall> http_call_queue;
 
+/**
+ * Count of allocations made through the global 'operator new', and of those of at least 'LARGE_ALLOCATION_SIZE' bytes, counted by
+ * the hooks in main.cpp. Allocations of the SDK library are counted too.
+ */
+extern std::atomic<unsigned long long> allocation_count;
+extern std::atomic<unsigned long long> large_allocation_count;
+const size_t LARGE_ALLOCATION_SIZE = 64 * 1024;
+
 static void clearSDK() {
   cly::Countly::halt();
   remove(TEST_DATABASE_NAME);
@@ -60,6 +69,7 @@ static void checkTopRequestEventSize(int size, cly::Countly &countly) {
 
 static void storageModuleNotInitialized(std::shared_ptr<StorageModuleBase> storageModule) {
   CHECK(storageModule->RQCount() == -1);
+  CHECK(storageModule->RQBytes() == -1);
   CHECK(storageModule->RQPeekAll().size() == 0);
 
   storageModule->RQInsertAtEnd("request");
@@ -0,0 +1,214 @@
+#include "countly/http_transport.hpp"
+#include "countly/storage_module_memory.hpp"
+#include "stub_server.hpp"
+#include "test_utils.hpp"
+
+#include "doctest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace cly;
+
+/**
+ * Transport that completes every request later on a thread of its own, like an asynchronous HTTP stack.
+ */
+class AsyncTransport : public Transport {
+private:
+  std::mutex _mutex;
+  std::vector<std::thread> _threads;
+
+public:
+  unsigned int maxInFlight = 2;
+  std::atomic<int> inFlight{0};
+  std::atomic<int> mostInFlight{0};
+  std::vector<std::string> sentData;
+
+  ~AsyncTransport() {
+    for (std::thread &thread : _threads) {
+      thread.join();
+    }
+  }
+
+  TransportCapabilities getCapabilities() const override {
+    TransportCapabilities capabilities;
+    capabilities.max_in_flight = maxInFlight;
+    return capabilities;
+  }
+
+  TransportHandle submit(const TransportRequest &request, TransportCompletion completion) override {
+    const int current = ++inFlight;
+    mostInFlight = std::max(mostInFlight.load(), current);
+    std::lock_guard<std::mutex> lock(_mutex);
+    sentData.push_back(request.path.toString() + "?" + request.data.toString());
+    _threads.emplace_back([this, completion]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      inFlight--;
+      completion(HTTPResponse{true, nlohmann::json::object()});
+    });
+    return _threads.size();
+  }
+
+  void cancel(TransportHandle handle) override {}
+
+  void cancelAll() override {}
+};
+
+TEST_CASE("Test sending requests with a transport") {
+  test_utils::clearSDK();
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("app-key", "https://test.count.ly");
+  std::shared_ptr<AsyncTransport> transport = std::make_shared<AsyncTransport>();
+  configuration->transport = transport;
+
+  std::shared_ptr<StorageModuleMemory> storageModule = std::make_shared<StorageModuleMemory>(configuration, logger);
+  std::shared_ptr<RequestBuilder> requestBuilder = std::make_shared<RequestBuilder>(configuration, logger);
+  std::shared_ptr<RequestModule> requestModule = std::make_shared<RequestModule>(configuration, logger, requestBuilder, storageModule);
+  storageModule->init();
+
+  SUBCASE("The queue waits for each completion and keeps its order") {
+    for (int i = 0; i < 5; i++) {
+      requestModule->addRequestToQueue({{"events", std::to_string(i)}});
+    }
+    requestModule->processQueue(std::make_shared<std::mutex>());
+    CHECK(storageModule->RQCount() == 0);
+    REQUIRE(transport->sentData.size() == 5);
+    for (int i = 0; i < 5; i++) {
+      CHECK(transport->sentData.at(i).find("/i?app_key=app%2Dkey") == 0);
+      CHECK(transport->sentData.at(i).find("events=" + std::to_string(i)) != std::string::npos);
+    }
+  }
+
+  SUBCASE("Requests from several threads stay within the requests the transport takes at a time") {
+    std::vector<std::thread> senders;
+    for (int i = 0; i < 6; i++) {
+      senders.emplace_back([&requestModule]() { CHECK(requestModule->sendHTTP("/o/sdk", "method=rc").success); });
+    }
+    for (std::thread &sender : senders) {
+      sender.join();
+    }
+    CHECK(transport->sentData.size() == 6);
+    CHECK(transport->mostInFlight <= 2);
+  }
+
+  SUBCASE("Requests are not handed to the transport after they were cancelled") {
+    requestModule->cancelRequests();
+    CHECK_FALSE(requestModule->sendHTTP("/o/sdk", "method=rc").success);
+
+    requestModule->addRequestToQueue({{"events", "1"}});
+    requestModule->processQueue(std::make_shared<std::mutex>());
+    CHECK(storageModule->RQCount() == 1);
+    CHECK(transport->sentData.empty());
+  }
+}
+
+TEST_CASE("Test the HTTP client function transport") {
+  std::string sentPath;
+  std::string sentData;
+  FunctionTransport transport([&sentPath, &sentData](bool use_post, const std::string &path, const std::string &data) {
+    sentPath = path;
+    sentData = data;
+    return HTTPResponse{true, nlohmann::json::object()};
+  });
+
+  const std::string path = "/i";
+  const std::string data = "app_key=app-key";
+  TransportRequest request;
+  request.path = BufferView(path);
+  request.data = BufferView(data);
+  bool completed = false;
+  transport.submit(request, [&completed](const HTTPResponse &response) { completed = response.success; });
+  CHECK(completed);
+  CHECK(sentPath == "/i");
+  CHECK(sentData == "app_key=app-key");
+  CHECK(transport.getCapabilities().max_in_flight == 0);
+}
+
+TEST_CASE("Test parsing the body of a response lazily") {
+  HTTPResponse response{true, nullptr};
+
+  SUBCASE("A valid body is parsed into the data") {
+    response.body = "{\"color\":\"red\"}";
+    CHECK(response.data.is_null());
+    CHECK(response.parseBody());
+    CHECK(response.data["color"] == "red");
+  }
+
+  SUBCASE("An invalid body leaves the data empty") {
+    response.body = "<html>";
+    CHECK_FALSE(response.parseBody());
+    CHECK(response.data.is_null());
+  }
+
+  SUBCASE("Data set by an HTTP client function is kept") {
+    response.data = {{"color", "blue"}};
+    response.body = "{\"color\":\"red\"}";
+    CHECK(response.parseBody());
+    CHECK(response.data["color"] == "blue");
+  }
+}
+
+#if !defined(_WIN32) && !defined(COUNTLY_USE_CUSTOM_HTTP)
+TEST_CASE("Test the built-in HTTP transport keeps the raw body") {
+  test_utils::StubServer server("200 OK", "");
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("app-key", "http://127.0.0.1");
+  configuration->port = server.port;
+  HTTPTransport transport(configuration, logger);
+
+  const std::string path = "/i";
+  const std::string data = "app_key=app-key";
+  TransportRequest request;
+  request.path = BufferView(path);
+  request.data = BufferView(data);
+
+  HTTPResponse response{false, nullptr};
+  transport.submit(request, [&response](const HTTPResponse &result) { response = result; });
+  CHECK(response.success);
+  CHECK(response.body == "{}");
+  CHECK(response.data.is_null());
+}
+
+TEST_CASE("Test cancelling a request of the built-in HTTP transport") {
+  test_utils::StubServer server("200 OK", "");
+  server.delay = std::chrono::milliseconds(3000);
+  std::shared_ptr<cly::LoggerModule> logger = std::make_shared<cly::LoggerModule>();
+  std::shared_ptr<cly::CountlyConfiguration> configuration = std::make_shared<CountlyConfiguration>("app-key", "http://127.0.0.1");
+  configuration->port = server.port;
+  HTTPTransport transport(configuration, logger);
+  CHECK(transport.getCapabilities().compression);
+
+  const std::string path = "/i";
+  const std::string data = "app_key=app-key";
+  TransportRequest request;
+  request.path = BufferView(path);
+  request.data = BufferView(data);
+
+  std::thread cancelling([&transport]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    transport.cancelAll();
+  });
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool success = true;
+  transport.submit(request, [&success](const HTTPResponse &response) { success = response.success; });
+  cancelling.join();
+
+  CHECK_FALSE(success);
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(2500));
+  CHECK(server.requestCount == 1);
+
+  // requests submitted after cancelling, e.g. by a fetch that started while stopping, are not sent
+  success = true;
+  bool completed = false;
+  transport.submit(request, [&success, &completed](const HTTPResponse &response) {
+    success = response.success;
+    completed = true;
+  });
+  CHECK(completed);
+  CHECK_FALSE(success);
+  CHECK(server.requestCount == 1);
+}
+#endif
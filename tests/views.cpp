@@ -3,7 +3,9 @@
 #include "test_utils.hpp"
 
 #include <chrono>
+#include <set>
 #include <thread>
+#include <vector>
 
 using namespace cly;
 using namespace std::literals::chrono_literals;
@@ -212,4 +214,67 @@ TEST_CASE("recording views") {
       CHECK(ct.debugReturnStateOfEQ().size() == eventSize);
     }
   }
+
+  /*
+   * It validates views of the same name and views opened from several threads.
+   */
+  SUBCASE("many views") {
+    /*
+     * Of several open views with the same name, closing by name closes the oldest.
+     */
+    SUBCASE("with the same name") {
+      std::string first = ct.views().openView("list");
+      std::string second = ct.views().openView("list");
+      CHECK(first != second);
+
+      ct.views().closeViewWithName("list");
+      std::vector<std::string> events = ct.debugReturnStateOfEQ();
+      nlohmann::json e = nlohmann::json::parse(events.back());
+      validateViewSegmentation(e, "list", first, 0, false, false);
+
+      ct.views().closeViewWithName("list");
+      events = ct.debugReturnStateOfEQ();
+      e = nlohmann::json::parse(events.back());
+      validateViewSegmentation(e, "list", second, 0, false, false);
+
+      // both are closed
+      const size_t eventSize = events.size();
+      ct.views().closeViewWithID(first);
+      ct.views().closeViewWithName("list");
+      CHECK(ct.debugReturnStateOfEQ().size() == eventSize);
+    }
+
+    /*
+     * Views opened and closed from several threads get different ids and are all recorded.
+     */
+    SUBCASE("from several threads") {
+      ct.setEventsToRQThreshold(10000);
+      const size_t eventSize = ct.debugReturnStateOfEQ().size();
+      std::vector<std::thread> threads;
+      std::vector<std::vector<std::string>> ids(4);
+      for (size_t thread = 0; thread < ids.size(); thread++) {
+        threads.emplace_back([&ct, &ids, thread]() {
+          for (int view = 0; view < 200; view++) {
+            const std::string name = "screen " + std::to_string(view % 10);
+            ids[thread].push_back(ct.views().openView(name));
+            if (view % 2 == 0) {
+              ct.views().closeViewWithID(ids[thread].back());
+            } else {
+              ct.views().closeViewWithName(name);
+            }
+          }
+        });
+      }
+      for (std::thread &thread : threads) {
+        thread.join();
+      }
+
+      std::set<std::string> unique;
+      for (const std::vector<std::string> &thread_ids : ids) {
+        unique.insert(thread_ids.begin(), thread_ids.end());
+      }
+      CHECK(unique.size() == 800);
+      CHECK(ct.debugReturnStateOfEQ().size() == eventSize + 1600);
+    }
+  }
 }